@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "AheadBehindCache.h"
+
+#include <cstring>
+
+size_t AheadBehindCache::CommitPairHash::operator()(const CommitPair& commitPair) const
+{
+	// Object ids are uniformly distributed, so their leading bytes make a good hash.
+	size_t localHash;
+	size_t upstreamHash;
+	std::memcpy(&localHash, commitPair.Local.id, sizeof(localHash));
+	std::memcpy(&upstreamHash, commitPair.Upstream.id, sizeof(upstreamHash));
+	return localHash ^ (upstreamHash * 31);
+}
+
+bool AheadBehindCache::CommitPairEqual::operator()(const CommitPair& lhs, const CommitPair& rhs) const
+{
+	return git_oid_equal(&lhs.Local, &rhs.Local) && git_oid_equal(&lhs.Upstream, &rhs.Upstream);
+}
+
+AheadBehindCache::AheadBehindCache(size_t capacity)
+	: m_capacity(capacity)
+{
+}
+
+std::tuple<bool, AheadBehindCache::Counts> AheadBehindCache::Find(const CommitPair& commitPair)
+{
+	LockGuard lock(m_mutex);
+	auto entry = m_entriesByCommitPair.find(commitPair);
+	if (entry == m_entriesByCommitPair.end())
+		return { false, Counts() };
+
+	m_entries.splice(m_entries.begin(), m_entries, entry->second);
+	return { true, entry->second->second };
+}
+
+std::tuple<bool, AheadBehindCache::CommitPair, AheadBehindCache::Counts> AheadBehindCache::FindLast(const std::string& branchKey)
+{
+	LockGuard lock(m_mutex);
+	auto lastCommitPair = m_lastCommitPairs.find(branchKey);
+	if (lastCommitPair == m_lastCommitPairs.end())
+		return { false, CommitPair(), Counts() };
+
+	auto entry = m_entriesByCommitPair.find(lastCommitPair->second);
+	if (entry == m_entriesByCommitPair.end())
+		return { false, CommitPair(), Counts() };
+
+	return { true, entry->first, entry->second->second };
+}
+
+void AheadBehindCache::Insert(const std::string& branchKey, const CommitPair& commitPair, const Counts& counts)
+{
+	if (m_capacity == 0)
+		return;
+
+	LockGuard lock(m_mutex);
+	auto entry = m_entriesByCommitPair.find(commitPair);
+	if (entry != m_entriesByCommitPair.end())
+	{
+		entry->second->second = counts;
+		m_entries.splice(m_entries.begin(), m_entries, entry->second);
+	}
+	else
+	{
+		if (m_entries.size() >= m_capacity)
+		{
+			m_entriesByCommitPair.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+
+		m_entries.emplace_front(commitPair, counts);
+		m_entriesByCommitPair.emplace(commitPair, m_entries.begin());
+	}
+
+	// Branches whose counts were evicted have nothing to update incrementally from.
+	if (m_lastCommitPairs.size() >= m_capacity && m_lastCommitPairs.find(branchKey) == m_lastCommitPairs.end())
+	{
+		for (auto lastCommitPair = m_lastCommitPairs.begin(); lastCommitPair != m_lastCommitPairs.end();)
+		{
+			if (m_entriesByCommitPair.find(lastCommitPair->second) == m_entriesByCommitPair.end())
+				lastCommitPair = m_lastCommitPairs.erase(lastCommitPair);
+			else
+				++lastCommitPair;
+		}
+
+		if (m_lastCommitPairs.size() >= m_capacity)
+			m_lastCommitPairs.erase(m_lastCommitPairs.begin());
+	}
+
+	m_lastCommitPairs[branchKey] = commitPair;
+}
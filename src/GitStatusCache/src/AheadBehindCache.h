@@ -0,0 +1,72 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+* Bounded cache of ahead/behind counts keyed by local and upstream commit. Commit
+* graphs are immutable, so counts are shared across repositories. Also remembers
+* the most recent commit pair for each branch, so that counts can be updated
+* incrementally when either side fast-forwards. This class is thread-safe.
+*/
+class AheadBehindCache
+{
+public:
+	struct CommitPair
+	{
+		git_oid Local;
+		git_oid Upstream;
+	};
+
+	struct Counts
+	{
+		size_t AheadBy = 0;
+		size_t BehindBy = 0;
+	};
+
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+
+	struct CommitPairHash
+	{
+		size_t operator()(const CommitPair& commitPair) const;
+	};
+
+	struct CommitPairEqual
+	{
+		bool operator()(const CommitPair& lhs, const CommitPair& rhs) const;
+	};
+
+	using Entry = std::pair<CommitPair, Counts>;
+
+	size_t m_capacity;
+
+	// Ordered from most to least recently used.
+	std::list<Entry> m_entries;
+	std::unordered_map<CommitPair, std::list<Entry>::iterator, CommitPairHash, CommitPairEqual> m_entriesByCommitPair;
+	std::unordered_map<std::string, CommitPair> m_lastCommitPairs;
+	std::mutex m_mutex;
+
+public:
+	AheadBehindCache(size_t capacity);
+	AheadBehindCache(const AheadBehindCache&) = delete;
+
+	/**
+	* Retrieves counts for provided commit pair.
+	*/
+	std::tuple<bool, Counts> Find(const CommitPair& commitPair);
+
+	/**
+	* Retrieves the most recently stored commit pair for provided branch and its counts,
+	* if they're still cached.
+	*/
+	std::tuple<bool, CommitPair, Counts> FindLast(const std::string& branchKey);
+
+	/**
+	* Stores counts for provided commit pair and records it as the most recent pair for
+	* provided branch. The least recently used counts are discarded if the cache is full.
+	*/
+	void Insert(const std::string& branchKey, const CommitPair& commitPair, const Counts& counts);
+};
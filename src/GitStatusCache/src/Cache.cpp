@@ -1,99 +1,526 @@
-#include "stdafx.h"
-#include "Cache.h"
-
-std::tuple<bool, Git::Status> Cache::GetStatus(const std::string& repositoryPath)
-{
-	{
-		LockGuard lock(m_cacheMutex);
-		auto cacheEntry = m_cache.find(repositoryPath);
-		if (cacheEntry != m_cache.end())
-		{
-			++m_cacheHits;
-			//Log("Cache.GetStatus.CacheHit", Severity::Info)
-			//	<< R"(Found git status in cache. { "repositoryPath": ")" << repositoryPath << R"(" })";
-			return cacheEntry->second;
-		}
-	}
-
-	++m_cacheMisses;
-	//Log("Cache.GetStatus.CacheMiss", Severity::Warning)
-	//	<< R"(Failed to find git status in cache. { "repositoryPath": ")" << repositoryPath << R"(" })";
-
-	auto status = m_git.GetStatus(repositoryPath);
-	{
-		LockGuard lock(m_cacheMutex);
-		m_cache[repositoryPath] = status;
-	}
-
-	return status;
-}
-
-void Cache::PrimeCacheEntry(const std::string& repositoryPath)
-{
-	++m_cacheTotalPrimeRequests;
-	{
-		LockGuard lock(m_cacheMutex);
-		auto cacheEntry = m_cache.find(repositoryPath);
-		if (cacheEntry != m_cache.end())
-			return;
-	}
-
-	++m_cacheEffectivePrimeRequests;
-	//Log("Cache.PrimeCacheEntry", Severity::Info)
-	//	<< R"(Priming cache entry. { "repositoryPath": ")" << repositoryPath << R"(" })";
-
-	auto status = m_git.GetStatus(repositoryPath);
-
-	{
-		LockGuard lock(m_cacheMutex);
-		m_cache[repositoryPath] = status;
-	}
-}
-
-bool Cache::InvalidateCacheEntry(const std::string& repositoryPath)
-{
-	++m_cacheTotalInvalidationRequests;
-	bool invalidatedCacheEntry = false;
-	{
-		LockGuard lock(m_cacheMutex);
-		auto cacheEntry = m_cache.find(repositoryPath);
-		if (cacheEntry != m_cache.end())
-		{
-			cacheEntry = m_cache.find(repositoryPath);
-			if (cacheEntry != m_cache.end())
-			{
-				m_cache.erase(cacheEntry);
-				invalidatedCacheEntry = true;
-			}
-		}
-	}
-
-	if (invalidatedCacheEntry)
-		++m_cacheEffectiveInvalidationRequests;
-	return invalidatedCacheEntry;
-}
-
-void Cache::InvalidateAllCacheEntries()
-{
-	++m_cacheInvalidateAllRequests;
-	{
-		LockGuard lock(m_cacheMutex);
-		m_cache.clear();
-	}
-
-	//Log("Cache.InvalidateAllCacheEntries.", Severity::Warning)
-	//	<< R"(Invalidated all git status information in cache.)";
-}
-
-CacheStatistics Cache::GetCacheStatistics()
-{
-	CacheStatistics statistics;
-	statistics.CacheHits = m_cacheHits;
-	statistics.CacheMisses = m_cacheMisses;
-	statistics.CacheEffectivePrimeRequests = m_cacheEffectivePrimeRequests;
-	statistics.CacheTotalPrimeRequests = m_cacheTotalPrimeRequests;
-	statistics.CacheEffectiveInvalidationRequests = m_cacheEffectiveInvalidationRequests;
-	statistics.CacheTotalInvalidationRequests = m_cacheTotalInvalidationRequests;
-	statistics.CacheInvalidateAllRequests = m_cacheInvalidateAllRequests;
-	return statistics;
-}
+#include "stdafx.h"
+#include "Cache.h"
+
+Cache::Cache(const Options& options)
+	: m_git(options.ScanThreads)
+	, m_allowStaleStatus(options.AllowStaleStatus)
+	, m_frontCodePaths(options.FrontCodePaths)
+	, m_memoryBudgetBytes(options.MemoryBudgetBytes)
+{
+}
+
+void Cache::SetOnEvictedCallback(const OnEvictedCallback& onEvictedCallback)
+{
+	m_onEvictedCallback = onEvictedCallback;
+}
+
+Cache::Shard& Cache::GetShard(const std::string& repositoryPath)
+{
+	return m_shards[std::hash<std::string>{}(repositoryPath) % ShardCount];
+}
+
+bool Cache::CanServeCachedStatus(const CachedStatus& cachedStatus) const
+{
+	return !cachedStatus.IsStale || m_allowStaleStatus;
+}
+
+/*static*/ bool Cache::HasParts(const CachedStatus& cachedStatus, uint32_t parts, size_t maxPaths)
+{
+	if (!cachedStatus.Success)
+		return true;
+
+	const auto& status = *cachedStatus.Status;
+	if ((status.ComputedParts & parts) != parts)
+		return false;
+
+	return (parts & (Git::StatusParts::Index | Git::StatusParts::WorkingTree)) == 0
+		|| status.MaxPaths >= maxPaths
+		|| !Git::IsFileStatusTruncated(status);
+}
+
+uint64_t Cache::GetGeneration(Shard& shard, const std::string& repositoryPath)
+{
+	auto generation = shard.Generations.find(repositoryPath);
+	if (generation != shard.Generations.end())
+		return generation->second;
+
+	return shard.Generations[repositoryPath] = ++m_lastGeneration;
+}
+
+/*static*/ void Cache::RecordChange(Shard& shard, const std::string& repositoryPath, uint32_t parts, const std::string& changedPath)
+{
+	auto& changes = shard.Changes[repositoryPath];
+	changes.Parts |= parts;
+	if ((parts & Git::StatusParts::WorkingTree) == 0 || changes.ScanAllPaths)
+		return;
+
+	if (changedPath.empty() || changes.Paths.size() >= MaxChangedPaths)
+	{
+		changes.ScanAllPaths = true;
+		changes.Paths.clear();
+		return;
+	}
+
+	changes.Paths.insert(changedPath);
+}
+
+Cache::Recomputation Cache::BeginRecomputation(Shard& shard, const std::string& repositoryPath, uint32_t requestedParts, size_t maxPaths)
+{
+	Recomputation recomputation;
+	recomputation.Generation = GetGeneration(shard, repositoryPath);
+	recomputation.RequestedParts = requestedParts;
+	recomputation.MaxPaths = maxPaths;
+
+	std::shared_ptr<const Git::Status> previousStatus;
+	auto cacheEntry = shard.Cache.find(repositoryPath);
+	if (cacheEntry != shard.Cache.end() && cacheEntry->second.Status.Success)
+	{
+		previousStatus = cacheEntry->second.Status.Status;
+		recomputation.RequestedParts |= previousStatus->ComputedParts;
+		recomputation.MaxPaths = (std::max)(recomputation.MaxPaths, previousStatus->MaxPaths);
+	}
+
+	auto missingParts = previousStatus != nullptr ? requestedParts & ~previousStatus->ComputedParts : requestedParts;
+	auto changes = shard.Changes.find(repositoryPath);
+	if (changes == shard.Changes.end())
+	{
+		// Nothing changed, so only parts the entry lacks need computing.
+		if (previousStatus != nullptr)
+		{
+			recomputation.PreviousStatus = previousStatus;
+			recomputation.Parts = missingParts;
+		}
+		return recomputation;
+	}
+
+	if (changes->second.Parts != Git::StatusParts::All && previousStatus != nullptr)
+	{
+		recomputation.PreviousStatus = previousStatus;
+		recomputation.Parts = (changes->second.Parts & previousStatus->ComputedParts) | missingParts;
+		if (!changes->second.ScanAllPaths)
+			recomputation.ChangedPaths.assign(changes->second.Paths.begin(), changes->second.Paths.end());
+	}
+
+	shard.Changes.erase(changes);
+	return recomputation;
+}
+
+/*static*/ void Cache::Touch(CacheEntry& cacheEntry)
+{
+	cacheEntry.LastAccess.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+/*static*/ uint64_t Cache::EstimateSize(const Git::Status& status)
+{
+	uint64_t size = sizeof(Git::Status);
+	auto addString = [&size](const std::string& value)
+	{
+		size += value.capacity();
+	};
+
+	addString(status.RepositoryPath);
+	addString(status.WorkingDirectory);
+	addString(status.State);
+	addString(status.Branch);
+	addString(status.Upstream);
+
+	size += status.Paths.GetResidentBytes();
+
+	size += status.Stashes.capacity() * sizeof(Git::Stash);
+	for (const auto& stash : status.Stashes)
+	{
+		addString(stash.Sha1Id);
+		addString(stash.Message);
+	}
+
+	return size;
+}
+
+CachedStatus Cache::ComputeStatus(
+	Shard& shard,
+	const std::string& repositoryPath,
+	const Recomputation& recomputation,
+	std::promise<CachedStatus>& pendingStatus)
+{
+	auto generation = recomputation.Generation;
+	CachedStatus status;
+	try
+	{
+		std::tuple<bool, Git::Status> computedStatus;
+		if (recomputation.PreviousStatus != nullptr)
+		{
+			++m_cacheIncrementalRecomputations;
+			//Log("Cache.ComputeStatus.Incremental", Severity::Verbose)
+			//	<< R"(Recomputing changed parts of status. { "repositoryPath": ")" << repositoryPath
+			//	<< R"(", "parts": )" << recomputation.Parts
+			//	<< R"(, "changedPaths": )" << recomputation.ChangedPaths.size() << " }";
+			computedStatus = m_git.UpdateStatus(
+				*recomputation.PreviousStatus,
+				recomputation.Parts,
+				recomputation.ChangedPaths,
+				recomputation.MaxPaths);
+		}
+		else
+		{
+			computedStatus = m_git.GetStatus(repositoryPath, recomputation.RequestedParts, recomputation.MaxPaths);
+		}
+
+		status.Success = std::get<0>(computedStatus);
+		if (m_frontCodePaths)
+			std::get<1>(computedStatus).Paths = std::get<1>(computedStatus).Paths.FrontCode();
+		status.Status = std::make_shared<const Git::Status>(std::move(std::get<1>(computedStatus)));
+		status.Generation = generation;
+		status.ComputedAt = std::chrono::steady_clock::now();
+
+		auto bytes = EstimateSize(*status.Status);
+		auto savedBytes = status.Status->Paths.GetFrontCodingSavedBytes();
+		{
+			WriteLock writeLock(shard.Mutex);
+			if (GetGeneration(shard, repositoryPath) != generation)
+			{
+				//Log("Cache.ComputeStatus.InvalidatedDuringComputation", Severity::Info)
+				//	<< R"(Repository changed while computing status. { "repositoryPath": ")" << repositoryPath << R"(" })";
+				status.IsStale = true;
+			}
+
+			auto& cacheEntry = shard.Cache[repositoryPath];
+			m_cacheResidentBytes += bytes;
+			m_cacheResidentBytes -= cacheEntry.Bytes;
+			m_cacheFrontCodingSavedBytes += savedBytes;
+			m_cacheFrontCodingSavedBytes -= cacheEntry.FrontCodingSavedBytes;
+			cacheEntry.Status = status;
+			cacheEntry.Bytes = bytes;
+			cacheEntry.FrontCodingSavedBytes = savedBytes;
+			Touch(cacheEntry);
+			shard.PendingStatuses.erase(repositoryPath);
+		}
+	}
+	catch (...)
+	{
+		{
+			// Changes taken for this computation are lost, so the next one must scan everything.
+			WriteLock writeLock(shard.Mutex);
+			shard.PendingStatuses.erase(repositoryPath);
+			RecordChange(shard, repositoryPath, Git::StatusParts::All, std::string());
+		}
+
+		pendingStatus.set_exception(std::current_exception());
+		throw;
+	}
+
+	pendingStatus.set_value(status);
+
+	if (m_memoryBudgetBytes != 0 && m_cacheResidentBytes > m_memoryBudgetBytes)
+		EvictLeastRecentlyUsed(repositoryPath);
+
+	return status;
+}
+
+void Cache::EvictLeastRecentlyUsed(const std::string& repositoryPathToKeep)
+{
+	std::unique_lock<std::mutex> evictionLock(m_evictionMutex, std::try_to_lock);
+	if (!evictionLock.owns_lock())
+		return;
+
+	std::vector<std::tuple<int64_t, std::string>> candidates;
+	for (auto& shard : m_shards)
+	{
+		ReadLock readLock(shard.Mutex);
+		for (const auto& cacheEntry : shard.Cache)
+		{
+			if (cacheEntry.first != repositoryPathToKeep)
+				candidates.emplace_back(cacheEntry.second.LastAccess.load(std::memory_order_relaxed), cacheEntry.first);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	std::vector<std::string> evictedRepositories;
+	for (const auto& candidate : candidates)
+	{
+		if (m_cacheResidentBytes <= m_memoryBudgetBytes)
+			break;
+
+		const auto& repositoryPath = std::get<1>(candidate);
+		auto& shard = GetShard(repositoryPath);
+		WriteLock writeLock(shard.Mutex);
+		auto cacheEntry = shard.Cache.find(repositoryPath);
+		if (cacheEntry == shard.Cache.end() || cacheEntry->second.LastAccess != std::get<0>(candidate))
+			continue;
+
+		m_cacheResidentBytes -= cacheEntry->second.Bytes;
+		m_cacheFrontCodingSavedBytes -= cacheEntry->second.FrontCodingSavedBytes;
+		shard.Cache.erase(cacheEntry);
+		shard.Generations.erase(repositoryPath);
+		shard.Changes.erase(repositoryPath);
+		++m_cacheEvictions;
+		evictedRepositories.push_back(repositoryPath);
+	}
+
+	//Log("Cache.EvictLeastRecentlyUsed", Severity::Info)
+	//	<< R"(Evicted git status to stay within memory budget. { "evictedRepositories": )" << evictedRepositories.size() << R"( })";
+
+	for (const auto& repositoryPath : evictedRepositories)
+		m_git.ReleaseRepository(repositoryPath);
+
+	if (m_onEvictedCallback != nullptr)
+	{
+		for (const auto& repositoryPath : evictedRepositories)
+			m_onEvictedCallback(repositoryPath);
+	}
+}
+
+CachedStatus Cache::GetStatus(const std::string& repositoryPath, uint32_t parts, size_t maxPaths)
+{
+	auto& shard = GetShard(repositoryPath);
+	{
+		ReadLock readLock(shard.Mutex);
+		auto cacheEntry = shard.Cache.find(repositoryPath);
+		if (cacheEntry != shard.Cache.end() && CanServeCachedStatus(cacheEntry->second.Status) && HasParts(cacheEntry->second.Status, parts, maxPaths))
+		{
+			if (cacheEntry->second.Status.IsStale)
+				++m_cacheStaleHits;
+			else
+				++shard.Hits;
+			Touch(cacheEntry->second);
+			//Log("Cache.GetStatus.CacheHit", Severity::Info)
+			//	<< R"(Found git status in cache. { "repositoryPath": ")" << repositoryPath << R"(" })";
+			return cacheEntry->second.Status;
+		}
+	}
+
+	// An in-flight computation may lack requested parts, in which case its result is completed.
+	for (;;)
+	{
+		std::promise<CachedStatus> pendingStatus;
+		std::shared_future<CachedStatus> pendingStatusToAwait;
+		Recomputation recomputation;
+		{
+			WriteLock writeLock(shard.Mutex);
+			auto cacheEntry = shard.Cache.find(repositoryPath);
+			if (cacheEntry != shard.Cache.end() && CanServeCachedStatus(cacheEntry->second.Status) && HasParts(cacheEntry->second.Status, parts, maxPaths))
+			{
+				if (cacheEntry->second.Status.IsStale)
+					++m_cacheStaleHits;
+				else
+					++shard.Hits;
+				Touch(cacheEntry->second);
+				return cacheEntry->second.Status;
+			}
+
+			auto pendingEntry = shard.PendingStatuses.find(repositoryPath);
+			if (pendingEntry != shard.PendingStatuses.end())
+			{
+				pendingStatusToAwait = pendingEntry->second;
+			}
+			else
+			{
+				shard.PendingStatuses[repositoryPath] = pendingStatus.get_future().share();
+				recomputation = BeginRecomputation(shard, repositoryPath, parts, maxPaths);
+			}
+		}
+
+		if (pendingStatusToAwait.valid())
+		{
+			++m_cacheCoalescedRequests;
+			//Log("Cache.GetStatus.CoalescedCacheMiss", Severity::Info)
+			//	<< R"(Waiting for in-flight git status computation. { "repositoryPath": ")" << repositoryPath << R"(" })";
+			// Computations that began before an invalidation finish with a stale status, which waiters
+			// that arrived afterwards must not receive unless stale results are allowed.
+			auto status = pendingStatusToAwait.get();
+			if (CanServeCachedStatus(status) && HasParts(status, parts, maxPaths))
+				return status;
+			continue;
+		}
+
+		++m_cacheMisses;
+		//Log("Cache.GetStatus.CacheMiss", Severity::Warning)
+		//	<< R"(Failed to find git status in cache. { "repositoryPath": ")" << repositoryPath << R"(" })";
+
+		return ComputeStatus(shard, repositoryPath, recomputation, pendingStatus);
+	}
+}
+
+void Cache::PrimeCacheEntry(const std::string& repositoryPath)
+{
+	++m_cacheTotalPrimeRequests;
+	auto& shard = GetShard(repositoryPath);
+	std::promise<CachedStatus> pendingStatus;
+	Recomputation recomputation;
+	{
+		WriteLock writeLock(shard.Mutex);
+		auto cacheEntry = shard.Cache.find(repositoryPath);
+		if (cacheEntry == shard.Cache.end())
+			return;
+
+		// Valid entries are only primed if changes are pending, as for entries restored from a snapshot.
+		if (!cacheEntry->second.Status.IsStale && shard.Changes.find(repositoryPath) == shard.Changes.end())
+			return;
+
+		auto pendingEntry = shard.PendingStatuses.find(repositoryPath);
+		if (pendingEntry != shard.PendingStatuses.end())
+			return;
+
+		shard.PendingStatuses[repositoryPath] = pendingStatus.get_future().share();
+		// Primed entries keep the parts and paths they held. Failures are retried in full.
+		auto isSuccess = cacheEntry->second.Status.Success;
+		auto parts = isSuccess ? Git::StatusParts::None : Git::StatusParts::All;
+		auto maxPaths = isSuccess ? 0 : Git::UnlimitedPaths;
+		recomputation = BeginRecomputation(shard, repositoryPath, parts, maxPaths);
+	}
+
+	++m_cacheEffectivePrimeRequests;
+	//Log("Cache.PrimeCacheEntry", Severity::Info)
+	//	<< R"(Priming cache entry. { "repositoryPath": ")" << repositoryPath << R"(" })";
+
+	ComputeStatus(shard, repositoryPath, recomputation, pendingStatus);
+}
+
+void Cache::RestoreCacheEntry(const std::shared_ptr<const Git::Status>& restoredStatus, bool isStale)
+{
+	auto status = restoredStatus;
+	if (m_frontCodePaths && !status->Paths.IsFrontCoded())
+	{
+		auto frontCodedStatus = std::make_shared<Git::Status>(*status);
+		frontCodedStatus->Paths = frontCodedStatus->Paths.FrontCode();
+		status = frontCodedStatus;
+	}
+
+	const auto& repositoryPath = status->RepositoryPath;
+	auto& shard = GetShard(repositoryPath);
+	auto bytes = EstimateSize(*status);
+	auto savedBytes = status->Paths.GetFrontCodingSavedBytes();
+	{
+		WriteLock writeLock(shard.Mutex);
+		if (shard.Cache.find(repositoryPath) != shard.Cache.end())
+			return;
+
+		auto& cacheEntry = shard.Cache[repositoryPath];
+		cacheEntry.Status.Success = true;
+		cacheEntry.Status.Status = status;
+		cacheEntry.Status.IsStale = isStale;
+		cacheEntry.Status.Generation = GetGeneration(shard, repositoryPath);
+		// The repository may have changed while the service wasn't running, so even valid
+		// entries are rescanned in full when next primed.
+		RecordChange(shard, repositoryPath, Git::StatusParts::All, std::string());
+		cacheEntry.Status.ComputedAt = std::chrono::steady_clock::now();
+		cacheEntry.Bytes = bytes;
+		cacheEntry.FrontCodingSavedBytes = savedBytes;
+		Touch(cacheEntry);
+		m_cacheResidentBytes += bytes;
+		m_cacheFrontCodingSavedBytes += savedBytes;
+	}
+
+	if (m_memoryBudgetBytes != 0 && m_cacheResidentBytes > m_memoryBudgetBytes)
+		EvictLeastRecentlyUsed(repositoryPath);
+}
+
+std::vector<CachedStatus> Cache::GetCachedStatuses()
+{
+	std::vector<CachedStatus> statuses;
+	for (auto& shard : m_shards)
+	{
+		ReadLock readLock(shard.Mutex);
+		for (const auto& cacheEntry : shard.Cache)
+		{
+			if (cacheEntry.second.Status.Success)
+				statuses.push_back(cacheEntry.second.Status);
+		}
+	}
+	return statuses;
+}
+
+bool Cache::InvalidateCacheEntry(const std::string& repositoryPath, uint32_t parts, const std::string& changedPath)
+{
+	return InvalidateCacheEntry(repositoryPath, { std::make_tuple(parts, changedPath) });
+}
+
+bool Cache::InvalidateCacheEntry(const std::string& repositoryPath, const std::vector<std::tuple<uint32_t, std::string>>& changes)
+{
+	if (changes.empty())
+		return false;
+
+	m_cacheTotalInvalidationRequests += changes.size();
+	auto& shard = GetShard(repositoryPath);
+	bool invalidatedCacheEntry = false;
+	{
+		WriteLock writeLock(shard.Mutex);
+		auto generation = shard.Generations.find(repositoryPath);
+		if (generation != shard.Generations.end())
+		{
+			generation->second = ++m_lastGeneration;
+			for (const auto& change : changes)
+				RecordChange(shard, repositoryPath, std::get<0>(change), std::get<1>(change));
+		}
+
+		auto cacheEntry = shard.Cache.find(repositoryPath);
+		if (cacheEntry != shard.Cache.end() && !cacheEntry->second.Status.IsStale)
+		{
+			cacheEntry->second.Status.IsStale = true;
+			invalidatedCacheEntry = true;
+		}
+	}
+
+	if (invalidatedCacheEntry)
+		++m_cacheEffectiveInvalidationRequests;
+	return invalidatedCacheEntry;
+}
+
+void Cache::InvalidateAllCacheEntries()
+{
+	++m_cacheInvalidateAllRequests;
+	for (auto& shard : m_shards)
+	{
+		WriteLock writeLock(shard.Mutex);
+		for (auto& generation : shard.Generations)
+		{
+			generation.second = ++m_lastGeneration;
+			RecordChange(shard, generation.first, Git::StatusParts::All, std::string());
+		}
+		for (auto& cacheEntry : shard.Cache)
+			cacheEntry.second.Status.IsStale = true;
+	}
+
+	//Log("Cache.InvalidateAllCacheEntries.", Severity::Warning)
+	//	<< R"(Invalidated all git status information in cache.)";
+}
+
+std::tuple<bool, Git::IgnoreSettings> Cache::GetIgnoreSettings(const std::string& repositoryPath)
+{
+	return m_git.GetIgnoreSettings(repositoryPath);
+}
+
+std::tuple<bool, std::unordered_set<std::string>> Cache::FindTrackedPaths(const std::string& repositoryPath, const std::vector<std::string>& paths)
+{
+	return m_git.FindTrackedPaths(repositoryPath, paths);
+}
+
+void Cache::ReleaseRepository(const std::string& repositoryPath)
+{
+	m_git.ReleaseRepository(repositoryPath);
+}
+
+void Cache::ReleaseIdleRepositories()
+{
+	m_git.ReleaseIdleRepositories();
+}
+
+CacheStatistics Cache::GetCacheStatistics()
+{
+	CacheStatistics statistics;
+	for (const auto& shard : m_shards)
+		statistics.CacheHits += shard.Hits;
+	statistics.CacheStaleHits = m_cacheStaleHits;
+	statistics.CacheMisses = m_cacheMisses;
+	statistics.CacheIncrementalRecomputations = m_cacheIncrementalRecomputations;
+	statistics.CacheCoalescedRequests = m_cacheCoalescedRequests;
+	statistics.CacheEffectivePrimeRequests = m_cacheEffectivePrimeRequests;
+	statistics.CacheTotalPrimeRequests = m_cacheTotalPrimeRequests;
+	statistics.CacheEffectiveInvalidationRequests = m_cacheEffectiveInvalidationRequests;
+	statistics.CacheTotalInvalidationRequests = m_cacheTotalInvalidationRequests;
+	statistics.CacheInvalidateAllRequests = m_cacheInvalidateAllRequests;
+	statistics.CacheResidentBytes = m_cacheResidentBytes;
+	statistics.CacheFrontCodingSavedBytes = m_cacheFrontCodingSavedBytes;
+	statistics.CacheEvictions = m_cacheEvictions;
+	return statistics;
+}
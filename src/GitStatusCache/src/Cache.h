@@ -1,58 +1,269 @@
-#pragma once
-#include "Git.h"
-#include "CacheStatistics.h"
-
-#include <mutex>
-
-/**
-* Simple cache that retrieves and stores git status information.
-* This class is thread-safe.
-*/
-class Cache
-{
-private:
-	using LockGuard = std::lock_guard<std::mutex>;
-
-	Git m_git;
-	std::unordered_map<std::string, std::tuple<bool, Git::Status>> m_cache;
-	std::mutex m_cacheMutex;
-
-	std::atomic<uint64_t> m_cacheHits = 0;
-	std::atomic<uint64_t> m_cacheMisses = 0;
-	std::atomic<uint64_t> m_cacheEffectivePrimeRequests = 0;
-	std::atomic<uint64_t> m_cacheTotalPrimeRequests = 0;
-	std::atomic<uint64_t> m_cacheEffectiveInvalidationRequests = 0;
-	std::atomic<uint64_t> m_cacheTotalInvalidationRequests = 0;
-	std::atomic<uint64_t> m_cacheInvalidateAllRequests = 0;
-
-public:
-	Cache() = default;
-	Cache(const Cache&) = delete;
-	Cache(Cache&&) = default;
-
-	/**
-	* Retrieves current git status for repository at provided path.
-	* Returns from cache if present, otherwise queries git and adds to cache.
-	*/
-	std::tuple<bool, Git::Status> GetStatus(const std::string& repositoryPath);
-
-	/**
-	* Computes status and loads cache entry if it's not already present.
-	*/
-	void PrimeCacheEntry(const std::string& repositoryPath);
-
-	/**
-	* Invalidates cached git status for repository at provided path.
-	*/
-	bool InvalidateCacheEntry(const std::string& repositoryPath);
-
-	/**
-	* Invalidates all cached git status information.
-	*/
-	void InvalidateAllCacheEntries();
-
-	/**
-	 * Returns information about cache's performance.
-	 */
-	CacheStatistics GetCacheStatistics();
+#pragma once
+#include "Git.h"
+#include "CachedStatus.h"
+#include "CacheStatistics.h"
+#include "Options.h"
+
+#include <array>
+#include <functional>
+#include <future>
+#include <shared_mutex>
+
+/**
+* Simple cache that retrieves and stores git status information.
+* Statuses are stored as immutable snapshots shared with callers.
+* This class is thread-safe.
+*/
+class Cache
+{
+public:
+	/**
+	* Callback for eviction notifications. Provides path of evicted repository.
+	*/
+	using OnEvictedCallback = std::function<void(const std::string&)>;
+
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+	using ReadLock = std::shared_lock<std::shared_mutex>;
+	using WriteLock = std::unique_lock<std::shared_mutex>;
+
+	/**
+	* Cached status with bookkeeping for memory accounting and eviction.
+	*/
+	struct CacheEntry
+	{
+		CachedStatus Status;
+		uint64_t Bytes = 0;
+		uint64_t FrontCodingSavedBytes = 0;
+		std::atomic<int64_t> LastAccess = 0;
+	};
+
+	/**
+	* Changes accumulated for a repository since its status was last computed.
+	*/
+	struct PendingChanges
+	{
+		/**
+		* Parts of the status affected by the changes. See Git::StatusParts.
+		*/
+		uint32_t Parts = Git::StatusParts::None;
+
+		/**
+		* Changed working tree paths. Only meaningful if the working tree part is affected
+		* and all paths don't need to be rescanned.
+		*/
+		bool ScanAllPaths = false;
+		std::unordered_set<std::string> Paths;
+	};
+
+	/**
+	* Work needed to bring a repository's status up to date. Requested parts are computed in
+	* full unless a previous status is available, in which case only parts that changed since
+	* or that the previous status lacks are recomputed. Empty changed paths with the working
+	* tree part require the whole working tree to be rescanned.
+	*/
+	struct Recomputation
+	{
+		uint64_t Generation = 0;
+		uint32_t RequestedParts = Git::StatusParts::All;
+		size_t MaxPaths = Git::UnlimitedPaths;
+		std::shared_ptr<const Git::Status> PreviousStatus;
+		uint32_t Parts = Git::StatusParts::All;
+		std::vector<std::string> ChangedPaths;
+	};
+
+	/**
+	* Partition of the cache. Repositories are assigned to shards by path hash so that
+	* requests for different repositories rarely contend on the same lock. Aligned to
+	* keep each shard's lock and hit counter on its own cache line.
+	*/
+	struct alignas(64) Shard
+	{
+		std::unordered_map<std::string, CacheEntry> Cache;
+		std::unordered_map<std::string, std::shared_future<CachedStatus>> PendingStatuses;
+		std::unordered_map<std::string, uint64_t> Generations;
+		std::unordered_map<std::string, PendingChanges> Changes;
+		std::shared_mutex Mutex;
+		std::atomic<uint64_t> Hits = 0;
+	};
+
+	static constexpr size_t ShardCount = 32;
+	static constexpr size_t MaxChangedPaths = 1024;
+
+	Git m_git;
+	std::array<Shard, ShardCount> m_shards;
+	bool m_allowStaleStatus = false;
+	bool m_frontCodePaths = false;
+	uint64_t m_memoryBudgetBytes = 0;
+
+	OnEvictedCallback m_onEvictedCallback;
+	std::mutex m_evictionMutex;
+
+	std::atomic<uint64_t> m_lastGeneration = 0;
+
+	std::atomic<uint64_t> m_cacheStaleHits = 0;
+	std::atomic<uint64_t> m_cacheMisses = 0;
+	std::atomic<uint64_t> m_cacheIncrementalRecomputations = 0;
+	std::atomic<uint64_t> m_cacheCoalescedRequests = 0;
+	std::atomic<uint64_t> m_cacheEffectivePrimeRequests = 0;
+	std::atomic<uint64_t> m_cacheTotalPrimeRequests = 0;
+	std::atomic<uint64_t> m_cacheEffectiveInvalidationRequests = 0;
+	std::atomic<uint64_t> m_cacheTotalInvalidationRequests = 0;
+	std::atomic<uint64_t> m_cacheInvalidateAllRequests = 0;
+	std::atomic<uint64_t> m_cacheResidentBytes = 0;
+	std::atomic<uint64_t> m_cacheFrontCodingSavedBytes = 0;
+	std::atomic<uint64_t> m_cacheEvictions = 0;
+
+	/**
+	* Returns the shard responsible for the repository at provided path.
+	*/
+	Shard& GetShard(const std::string& repositoryPath);
+
+	/**
+	* Checks if a cache entry may be returned to callers without recomputing it.
+	*/
+	bool CanServeCachedStatus(const CachedStatus& cachedStatus) const;
+
+	/**
+	* Checks if a cache entry holds provided parts of the status, with at least provided number
+	* of paths in each path list. Failures hold every part, so that they're returned to callers
+	* rather than retried.
+	*/
+	static bool HasParts(const CachedStatus& cachedStatus, uint32_t parts, size_t maxPaths);
+
+	/**
+	* Marks cache entry as recently used. Safe to call under a shard's read lock.
+	*/
+	static void Touch(CacheEntry& cacheEntry);
+
+	/**
+	* Approximates the memory held by a status snapshot.
+	*/
+	static uint64_t EstimateSize(const Git::Status& status);
+
+	/**
+	* Returns current generation of repository, assigning one if the repository has none.
+	* Caller must hold the shard's write lock.
+	*/
+	uint64_t GetGeneration(Shard& shard, const std::string& repositoryPath);
+
+	/**
+	* Records a change to the repository for its next recomputation. Changed path limits
+	* working tree rescans to that path; an empty path rescans the whole working tree.
+	* Caller must hold the shard's write lock.
+	*/
+	static void RecordChange(Shard& shard, const std::string& repositoryPath, uint32_t parts, const std::string& changedPath);
+
+	/**
+	* Captures repository's generation and takes the changes accumulated since its status
+	* was last computed. Parts and paths already held by the cache entry are kept in addition
+	* to those requested. Caller must hold the shard's write lock.
+	*/
+	Recomputation BeginRecomputation(Shard& shard, const std::string& repositoryPath, uint32_t requestedParts, size_t maxPaths);
+
+	/**
+	* Computes status for repository, stores it in the cache and fulfills the promise
+	* other callers for the same repository are waiting on. Caller must have registered
+	* the promise's future in the shard's pending statuses and begun the recomputation at
+	* the same time. If the repository was invalidated while status was being computed,
+	* the result is stored flagged as stale.
+	*/
+	CachedStatus ComputeStatus(
+		Shard& shard,
+		const std::string& repositoryPath,
+		const Recomputation& recomputation,
+		std::promise<CachedStatus>& pendingStatus);
+
+	/**
+	* Evicts least recently used entries until resident bytes fit the memory budget.
+	* The most recently stored repository is never evicted.
+	*/
+	void EvictLeastRecentlyUsed(const std::string& repositoryPathToKeep);
+
+public:
+	Cache(const Options& options);
+	Cache(const Cache&) = delete;
+
+	/**
+	* Registers callback invoked after a repository is evicted to stay within the memory budget.
+	* Must be called before the cache is used.
+	*/
+	void SetOnEvictedCallback(const OnEvictedCallback& onEvictedCallback);
+
+	/**
+	* Retrieves current git status for repository at provided path.
+	* Returns from cache if present, otherwise queries git and adds to cache.
+	* Concurrent misses for the same repository share a single git query.
+	* Invalidated entries are returned flagged as stale if stale statuses are allowed.
+	* Only provided parts of the status are guaranteed to be computed. Entries missing
+	* some of them are completed rather than recomputed. Path lists are only guaranteed
+	* to hold up to provided number of paths, which bounds the memory held by the entry.
+	*/
+	CachedStatus GetStatus(
+		const std::string& repositoryPath,
+		uint32_t parts = Git::StatusParts::All,
+		size_t maxPaths = Git::UnlimitedPaths);
+
+	/**
+	* Recomputes status for a cache entry that is stale, or valid with changes pending, and not
+	* already being computed by another caller. Evicted repositories are not primed.
+	*/
+	void PrimeCacheEntry(const std::string& repositoryPath);
+
+	/**
+	* Adds status loaded from a snapshot to the cache. Existing entries are left untouched.
+	* Restored entries are served as is, but are recomputed in full when next primed.
+	*/
+	void RestoreCacheEntry(const std::shared_ptr<const Git::Status>& status, bool isStale);
+
+	/**
+	* Returns all successfully computed statuses in the cache, including stale ones.
+	*/
+	std::vector<CachedStatus> GetCachedStatuses();
+
+	/**
+	* Invalidates cached git status for repository at provided path.
+	* The entry is kept, flagged as stale, until it is recomputed.
+	* Only the provided parts of the status are recomputed. See Git::StatusParts.
+	* Changed path is relative to the working directory and limits working tree
+	* rescans to that path. An empty changed path rescans the whole working tree.
+	*/
+	bool InvalidateCacheEntry(const std::string& repositoryPath, uint32_t parts, const std::string& changedPath);
+
+	/**
+	* Invalidates cached git status for repository at provided path for a batch of changes,
+	* each with the parts it affects and its changed path as for InvalidateCacheEntry.
+	* Takes the repository's lock once for the whole batch.
+	*/
+	bool InvalidateCacheEntry(const std::string& repositoryPath, const std::vector<std::tuple<uint32_t, std::string>>& changes);
+
+	/**
+	* Invalidates all cached git status information.
+	*/
+	void InvalidateAllCacheEntries();
+
+	/**
+	* Retrieves the ignore configuration of repository at provided path. See Git::GetIgnoreSettings.
+	*/
+	std::tuple<bool, Git::IgnoreSettings> GetIgnoreSettings(const std::string& repositoryPath);
+
+	/**
+	* Retrieves which of provided paths are tracked by repository at provided path. See Git::FindTrackedPaths.
+	*/
+	std::tuple<bool, std::unordered_set<std::string>> FindTrackedPaths(const std::string& repositoryPath, const std::vector<std::string>& paths);
+
+	/**
+	* Closes open handles to repository at provided path kept for reuse between computations.
+	*/
+	void ReleaseRepository(const std::string& repositoryPath);
+
+	/**
+	* Closes open repository handles that haven't been used recently.
+	*/
+	void ReleaseIdleRepositories();
+
+	/**
+	 * Returns information about cache's performance.
+	 */
+	CacheStatistics GetCacheStatistics();
 };
\ No newline at end of file
@@ -1,80 +1,406 @@
-#include "stdafx.h"
-#include "CacheInvalidator.h"
-#include "StringConverters.h"
-
-CacheInvalidator::CacheInvalidator(const std::shared_ptr<Cache>& cache)
-	: m_cache(cache)
-	, m_cachePrimer(cache)
-{
-	m_directoryMonitor = std::make_unique<DirectoryMonitor>(
-		[this](DirectoryMonitor::Token token, const std::filesystem::path& path, DirectoryMonitor::FileAction action)
-		{
-			this->OnFileChanged(token, path, action);
-		},
-		[this] { m_cache->InvalidateAllCacheEntries(); });
-}
-
-void CacheInvalidator::MonitorRepositoryDirectories(const Git::Status& status)
-{
-	auto workingDirectory = status.WorkingDirectory;
-	if (!workingDirectory.empty())
-	{
-		auto token = m_directoryMonitor->AddDirectory(ConvertToUnicode(workingDirectory));
-		LockGuard lock(m_tokensToRepositoriesMutex);
-		m_tokensToRepositories[token] = status.RepositoryPath;
-	}
-
-	auto repositoryPath = status.RepositoryPath;
-	if (!repositoryPath.empty())
-	{
-		if (workingDirectory.empty() || repositoryPath.find(workingDirectory) != 0)
-		{
-			auto token = m_directoryMonitor->AddDirectory(ConvertToUnicode(repositoryPath));
-			LockGuard lock(m_tokensToRepositoriesMutex);
-			m_tokensToRepositories[token] = status.RepositoryPath;
-		}
-	}
-}
-
-void CacheInvalidator::OnFileChanged(DirectoryMonitor::Token token, const std::filesystem::path& path, DirectoryMonitor::FileAction action)
-{
-	if (CacheInvalidator::ShouldIgnoreFileChange(path))
-	{
-		//Log("CacheInvalidator.OnFileChanged.IgnoringFileChange", Severity::Spam)
-		//	<< R"(Ignoring file change. { "filePath": ")" << path.c_str() << R"(" })";
-		return;
-	}
-
-	std::string repositoryPath;
-	{
-		LockGuard lock(m_tokensToRepositoriesMutex);
-		auto iterator = m_tokensToRepositories.find(token);
-		if (iterator == m_tokensToRepositories.end())
-		{
-			//Log("CacheInvalidator.OnFileChanged.FailedToFindToken", Severity::Error)
-			//	<< R"(Failed to find token to repository mapping. { "token": )" << token << R"(" })";
-			throw std::logic_error("Failed to find token to repository mapping.");
-		}
-		repositoryPath = iterator->second;
-	}
-
-	auto invalidatedEntry = m_cache->InvalidateCacheEntry(repositoryPath);
-	if (invalidatedEntry)
-	{
-		//Log("CacheInvalidator.OnFileChanged.InvalidatedCacheEntry", Severity::Info)
-		//	<< R"(Invalidated git status in cache for file change. { "token": )" << token
-		//	<< R"(, "repositoryPath": ")" << repositoryPath
-		//	<< R"(", "filePath": ")" << path.c_str() << R"(" })";
-	}
-
-	m_cachePrimer.SchedulePrimingForRepositoryPath(repositoryPath);
-}
-
-/*static*/ bool CacheInvalidator::ShouldIgnoreFileChange(const std::filesystem::path& path)
-{
-	if (!path.has_filename())
-		return false;
-
-	auto filename = path.filename();
-	return filename.wstring() == L"index.lock" || filename.wstring() == L".git";
+#include "stdafx.h"
+#include "CacheInvalidator.h"
+#include "StringConverters.h"
+
+CacheInvalidator::CacheInvalidator(const std::shared_ptr<Cache>& cache)
+	: m_cache(cache)
+	, m_cachePrimer(cache)
+{
+	m_directoryMonitor = std::make_unique<DirectoryMonitor>(
+		[this](const std::vector<DirectoryMonitor::DirectoryChanges>& directoryChanges)
+		{
+			this->OnFilesChanged(directoryChanges);
+		},
+		[this]
+		{
+			// Lost changes were recovered and delivered as file changes, so only the mapping of
+			// paths to repositories needs refreshing.
+			if (m_onRepositoriesChangedCallback != nullptr)
+				m_onRepositoriesChangedCallback();
+		});
+
+	m_cache->SetOnEvictedCallback(
+		[this](const std::string& repositoryPath)
+		{
+			m_cachePrimer.CancelPrimingForRepositoryPath(repositoryPath);
+		});
+}
+
+void CacheInvalidator::SetOnRepositoriesChangedCallback(const OnRepositoriesChangedCallback& onRepositoriesChangedCallback)
+{
+	m_onRepositoriesChangedCallback = onRepositoriesChangedCallback;
+}
+
+void CacheInvalidator::MonitorRepositoryDirectories(const Git::Status& status)
+{
+	MonitoredRepository monitoredRepository;
+	monitoredRepository.RepositoryPath = status.RepositoryPath;
+	monitoredRepository.RepositoryDirectory = CacheInvalidator::NormalizeDirectory(status.RepositoryPath);
+	monitoredRepository.WorkingDirectory = CacheInvalidator::NormalizeDirectory(status.WorkingDirectory);
+
+	auto workingDirectory = status.WorkingDirectory;
+	if (!workingDirectory.empty())
+	{
+		auto token = m_directoryMonitor->AddDirectory(ConvertToUnicode(workingDirectory));
+		LockGuard lock(m_tokensToRepositoriesMutex);
+		m_tokensToRepositories[token] = monitoredRepository;
+	}
+
+	auto repositoryPath = status.RepositoryPath;
+	if (!repositoryPath.empty())
+	{
+		if (workingDirectory.empty() || repositoryPath.find(workingDirectory) != 0)
+		{
+			auto token = m_directoryMonitor->AddDirectory(ConvertToUnicode(repositoryPath));
+			LockGuard lock(m_tokensToRepositoriesMutex);
+			m_tokensToRepositories[token] = monitoredRepository;
+		}
+	}
+}
+
+std::unordered_set<std::string> CacheInvalidator::GetMonitoredRepositories()
+{
+	std::unordered_set<std::string> repositories;
+	LockGuard lock(m_tokensToRepositoriesMutex);
+	for (const auto& tokenToRepository : m_tokensToRepositories)
+		repositories.insert(tokenToRepository.second.RepositoryPath);
+	return repositories;
+}
+
+void CacheInvalidator::RefreshStaleCacheEntry(const std::string& repositoryPath)
+{
+	m_cachePrimer.ScheduleImmediatePrimingForRepositoryPath(repositoryPath);
+}
+
+void CacheInvalidator::VerifyRestoredCacheEntry(const std::string& repositoryPath)
+{
+	m_cachePrimer.SchedulePrimingForRepositoryPath(repositoryPath);
+}
+
+void CacheInvalidator::OnFilesChanged(const std::vector<DirectoryMonitor::DirectoryChanges>& directoryChanges)
+{
+	if (m_onRepositoriesChangedCallback != nullptr)
+	{
+		for (const auto& changes : directoryChanges)
+		{
+			auto repositoryChange = std::find_if(
+				changes.Changes.begin(),
+				changes.Changes.end(),
+				[](const DirectoryMonitor::FileChange& change) { return CacheInvalidator::IsRepositoryChange(change.Path, change.Action); });
+			if (repositoryChange != changes.Changes.end())
+			{
+				//Log("CacheInvalidator.OnFilesChanged.RepositoryChange", Severity::Info)
+				//	<< R"(Repository created or removed. { "filePath": ")" << repositoryChange->Path.c_str() << R"(" })";
+				m_onRepositoriesChangedCallback();
+				break;
+			}
+		}
+	}
+
+	// Repositories whose git directory is outside the working directory are monitored through
+	// two directories. Their changes are grouped so that each repository is handled once.
+	std::vector<std::pair<MonitoredRepository, std::vector<const std::vector<DirectoryMonitor::FileChange>*>>> repositoryChanges;
+	{
+		LockGuard lock(m_tokensToRepositoriesMutex);
+		std::unordered_map<std::string, size_t> repositoryIndices;
+		for (const auto& changes : directoryChanges)
+		{
+			auto iterator = m_tokensToRepositories.find(changes.DirectoryToken);
+			if (iterator == m_tokensToRepositories.end())
+			{
+				//Log("CacheInvalidator.OnFilesChanged.FailedToFindToken", Severity::Error)
+				//	<< R"(Failed to find token to repository mapping. { "token": )" << changes.DirectoryToken << R"(" })";
+				throw std::logic_error("Failed to find token to repository mapping.");
+			}
+
+			auto repositoryIndex = repositoryIndices.emplace(iterator->second.RepositoryPath, repositoryChanges.size());
+			if (repositoryIndex.second)
+				repositoryChanges.emplace_back(iterator->second, std::vector<const std::vector<DirectoryMonitor::FileChange>*>());
+			repositoryChanges[repositoryIndex.first->second].second.push_back(&changes.Changes);
+		}
+	}
+
+	for (const auto& repositoryChange : repositoryChanges)
+		CacheInvalidator::OnRepositoryFilesChanged(repositoryChange.first, repositoryChange.second);
+}
+
+void CacheInvalidator::OnRepositoryFilesChanged(
+	const MonitoredRepository& repository,
+	const std::vector<const std::vector<DirectoryMonitor::FileChange>*>& changeLists)
+{
+	bool shouldReleaseRepository = false;
+	std::vector<std::tuple<uint32_t, std::string>> statusChanges;
+	for (const auto* changes : changeLists)
+	{
+		for (const auto& change : *changes)
+		{
+			// Recovered changes don't name the files that changed, which may include ignore files.
+			if (change.Action == DirectoryMonitor::FileAction::Unknown || CacheInvalidator::IsIgnoreRulesChange(change.Path, repository))
+				m_ignoreRules.erase(repository.RepositoryPath);
+
+			if (CacheInvalidator::ShouldIgnoreFileChange(change.Path))
+			{
+				//Log("CacheInvalidator.OnFilesChanged.IgnoringFileChange", Severity::Spam)
+				//	<< R"(Ignoring file change. { "filePath": ")" << change.Path.c_str() << R"(" })";
+				continue;
+			}
+
+			shouldReleaseRepository |= CacheInvalidator::ShouldReleaseRepository(change.Path, repository);
+
+			auto statusChange = CacheInvalidator::ClassifyFileChange(change.Path, change.Action, repository);
+			if (std::get<0>(statusChange) == Git::StatusParts::None)
+			{
+				//Log("CacheInvalidator.OnFilesChanged.NoAffectedStatus", Severity::Spam)
+				//	<< R"(Ignoring file change that can't affect status. { "filePath": ")" << change.Path.c_str() << R"(" })";
+				continue;
+			}
+			statusChanges.push_back(std::move(statusChange));
+		}
+	}
+
+	const auto& repositoryPath = repository.RepositoryPath;
+	if (shouldReleaseRepository)
+		m_cache->ReleaseRepository(repositoryPath);
+
+	CacheInvalidator::RemoveIgnoredChanges(repository, statusChanges);
+	if (statusChanges.empty())
+		return;
+
+	auto invalidatedEntry = m_cache->InvalidateCacheEntry(repositoryPath, statusChanges);
+	if (invalidatedEntry)
+	{
+		//Log("CacheInvalidator.OnFilesChanged.InvalidatedCacheEntry", Severity::Info)
+		//	<< R"(Invalidated git status in cache for file changes. { "repositoryPath": ")" << repositoryPath
+		//	<< R"(", "changeCount": )" << statusChanges.size() << " }";
+	}
+
+	m_cachePrimer.SchedulePrimingForRepositoryPath(repositoryPath);
+}
+
+/*static*/ bool CacheInvalidator::ShouldIgnoreFileChange(const std::filesystem::path& path)
+{
+	if (!path.has_filename())
+		return false;
+
+	auto filename = path.filename();
+	return filename.wstring() == L"index.lock" || filename.wstring() == L".git";
+}
+
+/*static*/ bool CacheInvalidator::IsIgnoreRulesChange(const std::filesystem::path& path, const MonitoredRepository& repository)
+{
+	if (path.has_filename() && path.filename().wstring() == L".gitignore")
+		return true;
+
+	std::wstring relativePath;
+	if (!CacheInvalidator::GetRelativePath(path.generic_wstring(), repository.RepositoryDirectory, relativePath))
+		return false;
+
+	return relativePath == L"config" || relativePath == L"info/exclude";
+}
+
+IgnoreRules& CacheInvalidator::GetIgnoreRules(const MonitoredRepository& repository)
+{
+	auto ignoreRules = m_ignoreRules.find(repository.RepositoryPath);
+	if (ignoreRules != m_ignoreRules.end())
+	{
+		if (!ignoreRules->second->IsExcludesFileChanged())
+			return *ignoreRules->second;
+		m_ignoreRules.erase(ignoreRules);
+	}
+
+	auto ignoreSettings = m_cache->GetIgnoreSettings(repository.RepositoryPath);
+	auto rules = std::make_unique<IgnoreRules>(
+		std::filesystem::path(repository.WorkingDirectory),
+		std::filesystem::path(repository.RepositoryDirectory),
+		std::filesystem::path(ConvertToUnicode(std::get<1>(ignoreSettings).ExcludesFile)),
+		std::get<1>(ignoreSettings).IgnoreCase);
+	return *m_ignoreRules.emplace(repository.RepositoryPath, std::move(rules)).first->second;
+}
+
+void CacheInvalidator::RemoveIgnoredChanges(const MonitoredRepository& repository, std::vector<std::tuple<uint32_t, std::string>>& statusChanges)
+{
+	// Only changes confined to a path in the working tree can be ignored. Others need a full rescan.
+	auto isWorkingTreePathChange = [](const std::tuple<uint32_t, std::string>& change)
+	{
+		return std::get<0>(change) == Git::StatusParts::WorkingTree && !std::get<1>(change).empty();
+	};
+	if (repository.WorkingDirectory.empty() || std::none_of(statusChanges.begin(), statusChanges.end(), isWorkingTreePathChange))
+		return;
+
+	auto& ignoreRules = GetIgnoreRules(repository);
+	std::vector<std::string> ignoredPaths;
+	for (const auto& change : statusChanges)
+	{
+		if (isWorkingTreePathChange(change) && ignoreRules.IsIgnored(std::get<1>(change)))
+			ignoredPaths.push_back(std::get<1>(change));
+	}
+	if (ignoredPaths.empty())
+		return;
+
+	// Git reports changes to tracked files even if they match ignore rules.
+	auto trackedPaths = m_cache->FindTrackedPaths(repository.RepositoryPath, ignoredPaths);
+	if (!std::get<0>(trackedPaths))
+		return;
+
+	std::unordered_set<std::string> untrackedIgnoredPaths;
+	for (auto& path : ignoredPaths)
+	{
+		if (std::get<1>(trackedPaths).count(path) == 0)
+			untrackedIgnoredPaths.insert(std::move(path));
+	}
+
+	auto removedChanges = std::remove_if(
+		statusChanges.begin(),
+		statusChanges.end(),
+		[&isWorkingTreePathChange, &untrackedIgnoredPaths](const std::tuple<uint32_t, std::string>& change)
+		{
+			return isWorkingTreePathChange(change) && untrackedIgnoredPaths.count(std::get<1>(change)) != 0;
+		});
+
+	//Log("CacheInvalidator.RemoveIgnoredChanges", Severity::Spam)
+	//	<< R"(Ignoring changes to ignored files. { "repositoryPath": ")" << repository.RepositoryPath
+	//	<< R"(", "count": )" << std::distance(removedChanges, statusChanges.end()) << " }";
+	statusChanges.erase(removedChanges, statusChanges.end());
+}
+
+/*static*/ bool CacheInvalidator::ShouldReleaseRepository(const std::filesystem::path& path, const MonitoredRepository& repository)
+{
+	// Working trees often have their own config files and directories, which must not match.
+	std::wstring relativePath;
+	if (!CacheInvalidator::GetRelativePath(path.generic_wstring(), repository.RepositoryDirectory, relativePath))
+		return false;
+
+	return relativePath == L"config" || relativePath.compare(0, 13, L"objects/pack/") == 0;
+}
+
+/*static*/ std::wstring CacheInvalidator::NormalizeDirectory(const std::string& directory)
+{
+	if (directory.empty())
+		return std::wstring();
+
+	auto normalizedDirectory = std::filesystem::path(ConvertToUnicode(directory)).generic_wstring();
+	if (normalizedDirectory.back() != L'/')
+		normalizedDirectory += L'/';
+	return normalizedDirectory;
+}
+
+/*static*/ bool CacheInvalidator::GetRelativePath(const std::wstring& path, const std::wstring& directory, std::wstring& relativePath)
+{
+	if (directory.empty()
+		|| path.size() <= directory.size()
+		|| _wcsnicmp(path.c_str(), directory.c_str(), directory.size()) != 0)
+	{
+		return false;
+	}
+
+	relativePath = std::filesystem::path(path.substr(directory.size())).lexically_normal().generic_wstring();
+	while (!relativePath.empty() && relativePath.back() == L'/')
+		relativePath.pop_back();
+	return !relativePath.empty() && relativePath != L".." && relativePath.compare(0, 3, L"../") != 0;
+}
+
+/*static*/ std::tuple<uint32_t, std::string> CacheInvalidator::ClassifyFileChange(
+	const std::filesystem::path& path,
+	DirectoryMonitor::FileAction action,
+	const MonitoredRepository& repository)
+{
+	auto changedPath = path.generic_wstring();
+	std::wstring relativePath;
+	if (CacheInvalidator::GetRelativePath(changedPath, repository.RepositoryDirectory, relativePath))
+	{
+		// Directories reported with unknown changes may contain any of the repository's files.
+		if (action == DirectoryMonitor::FileAction::Unknown)
+			return { Git::StatusParts::All, std::string() };
+		return { CacheInvalidator::ClassifyRepositoryFileChange(relativePath), std::string() };
+	}
+
+	if (!CacheInvalidator::GetRelativePath(changedPath, repository.WorkingDirectory, relativePath)
+		|| relativePath == L".git"
+		|| relativePath.compare(0, 5, L".git/") == 0)
+	{
+		return { Git::StatusParts::All, std::string() };
+	}
+
+	// Ignore rules apply to everything beneath the directory containing them.
+	auto separator = relativePath.find_last_of(L'/');
+	auto filename = separator == std::wstring::npos ? relativePath : relativePath.substr(separator + 1);
+	if (filename == L".gitignore")
+		relativePath = separator == std::wstring::npos ? std::wstring() : relativePath.substr(0, separator);
+
+	return { Git::StatusParts::WorkingTree, ConvertToUtf8(relativePath) };
+}
+
+/*static*/ uint32_t CacheInvalidator::ClassifyRepositoryFileChange(const std::wstring& path)
+{
+	using StatusParts = Git::StatusParts;
+	const auto refParts = StatusParts::Branch | StatusParts::AheadBehind;
+
+	auto separator = path.find(L'/');
+	auto topLevelName = path.substr(0, separator);
+	auto remainder = separator == std::wstring::npos ? std::wstring() : path.substr(separator + 1);
+
+	// Lock files are renamed over the files they protect, which produces its own notification.
+	if (path.size() > 5 && path.compare(path.size() - 5, 5, L".lock") == 0)
+		return StatusParts::None;
+
+	if (path == L"HEAD")
+		return refParts | StatusParts::State | StatusParts::Index;
+	if (path == L"index")
+		return StatusParts::Index | StatusParts::WorkingTree;
+	if (path == L"packed-refs")
+		return refParts | StatusParts::Index;
+	if (path == L"info/exclude")
+		return StatusParts::WorkingTree;
+	if (path == L"refs/stash" || path == L"logs/refs/stash")
+		return StatusParts::Stashes;
+
+	if (topLevelName == L"refs")
+	{
+		// Notifications for the directories themselves duplicate those for the refs they contain.
+		if (remainder.compare(0, 6, L"heads/") == 0)
+			return refParts | StatusParts::Index;
+		if (remainder.compare(0, 8, L"remotes/") == 0)
+			return refParts;
+		return StatusParts::None;
+	}
+
+	if (topLevelName == L"rebase-merge"
+		|| topLevelName == L"rebase-apply"
+		|| topLevelName == L"sequencer"
+		|| path == L"MERGE_HEAD"
+		|| path == L"CHERRY_PICK_HEAD"
+		|| path == L"REVERT_HEAD"
+		|| path == L"BISECT_LOG")
+	{
+		return StatusParts::State | refParts;
+	}
+
+	if (topLevelName == L"objects"
+		|| topLevelName == L"logs"
+		|| topLevelName == L"hooks"
+		|| topLevelName == L"info"
+		|| topLevelName == L"modules"
+		|| topLevelName == L"worktrees"
+		|| topLevelName == L"lfs"
+		|| path == L"FETCH_HEAD"
+		|| path == L"ORIG_HEAD"
+		|| path == L"COMMIT_EDITMSG"
+		|| path == L"MERGE_MSG"
+		|| path == L"description"
+		|| path == L"gc.pid"
+		|| path == L"gc.log")
+	{
+		return StatusParts::None;
+	}
+
+	return StatusParts::All;
+}
+
+/*static*/ bool CacheInvalidator::IsRepositoryChange(const std::filesystem::path& path, DirectoryMonitor::FileAction action)
+{
+	// Directories are reported as modified whenever their contents change.
+	if (action == DirectoryMonitor::FileAction::Modified || !path.has_filename())
+		return false;
+
+	return path.filename().wstring() == L".git";
 }
\ No newline at end of file
@@ -1,42 +1,154 @@
-#pragma once
-#include "DirectoryMonitor.h"
-#include "Cache.h"
-#include "CachePrimer.h"
-
-#include <filesystem>
-#include <mutex>
-
-/**
-* Invalidates cache entries in response to file system changes.
-* This class is thread-safe.
-*/
-class CacheInvalidator
-{
-private:
-	using LockGuard = std::lock_guard<std::mutex>;
-
-	std::shared_ptr<Cache> m_cache;
-	CachePrimer m_cachePrimer;
-
-	std::unique_ptr<DirectoryMonitor> m_directoryMonitor;
-	std::unordered_map<DirectoryMonitor::Token, std::string> m_tokensToRepositories;
-	std::mutex m_tokensToRepositoriesMutex;
-
-	/**
-	* Checks if the file change can be safely ignored.
-	*/
-	static bool ShouldIgnoreFileChange(const std::filesystem::path& path);
-
-	/**
-	* Handles file change notifications by invalidating cache entries and scheduling priming.
-	*/
-	void OnFileChanged(DirectoryMonitor::Token token, const std::filesystem::path& path, DirectoryMonitor::FileAction action);
-
-public:
-	CacheInvalidator(const std::shared_ptr<Cache>& cache);
-
-	/**
-	* Registers working directory and repository directory for file change monitoring.
-	*/
-	void MonitorRepositoryDirectories(const Git::Status& status);
+#pragma once
+#include "DirectoryMonitor.h"
+#include "Cache.h"
+#include "CachePrimer.h"
+#include "IgnoreRules.h"
+
+#include <filesystem>
+#include <mutex>
+
+/**
+* Invalidates cache entries in response to file system changes.
+* This class is thread-safe.
+*/
+class CacheInvalidator
+{
+public:
+	/**
+	* Callback for notifications that repositories may have been created or removed
+	* under monitored directories.
+	*/
+	using OnRepositoriesChangedCallback = std::function<void(void)>;
+
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+
+	/**
+	* Repository that a monitored directory belongs to.
+	*/
+	struct MonitoredRepository
+	{
+		std::string RepositoryPath;
+
+		/**
+		* Repository and working directories with forward slashes and trailing slashes.
+		* Working directory is empty for bare repositories.
+		*/
+		std::wstring RepositoryDirectory;
+		std::wstring WorkingDirectory;
+	};
+
+	std::shared_ptr<Cache> m_cache;
+	CachePrimer m_cachePrimer;
+	OnRepositoriesChangedCallback m_onRepositoriesChangedCallback;
+
+	std::unique_ptr<DirectoryMonitor> m_directoryMonitor;
+	std::unordered_map<DirectoryMonitor::Token, MonitoredRepository> m_tokensToRepositories;
+	std::mutex m_tokensToRepositoriesMutex;
+
+	// Ignore rules by repository path. Only accessed on the directory monitor's notification thread.
+	std::unordered_map<std::string, std::unique_ptr<IgnoreRules>> m_ignoreRules;
+
+	/**
+	* Checks if the file change can be safely ignored.
+	*/
+	static bool ShouldIgnoreFileChange(const std::filesystem::path& path);
+
+	/**
+	* Converts directory to the form stored in MonitoredRepository.
+	*/
+	static std::wstring NormalizeDirectory(const std::string& directory);
+
+	/**
+	* Retrieves path relative to directory. Fails if path isn't beneath directory.
+	*/
+	static bool GetRelativePath(const std::wstring& path, const std::wstring& directory, std::wstring& relativePath);
+
+	/**
+	* Determines which parts of the repository's status a file change can affect. For changes
+	* in the working tree, also returns the changed path relative to the working directory, as
+	* used by git. The path is empty if the whole working tree must be rescanned.
+	*/
+	static std::tuple<uint32_t, std::string> ClassifyFileChange(
+		const std::filesystem::path& path,
+		DirectoryMonitor::FileAction action,
+		const MonitoredRepository& repository);
+
+	/**
+	* Determines which parts of status a change to a file in the repository directory can affect.
+	* Path is relative to the repository directory.
+	*/
+	static uint32_t ClassifyRepositoryFileChange(const std::wstring& path);
+
+	/**
+	* Checks if the file change adds, removes or renames a repository's .git entry.
+	*/
+	static bool IsRepositoryChange(const std::filesystem::path& path, DirectoryMonitor::FileAction action);
+
+	/**
+	* Checks if the file change can alter which paths the repository ignores. These are
+	* .gitignore files anywhere, and the repository directory's config and info/exclude files.
+	*/
+	static bool IsIgnoreRulesChange(const std::filesystem::path& path, const MonitoredRepository& repository);
+
+	/**
+	* Retrieves the ignore rules of repository, compiling them if needed.
+	*/
+	IgnoreRules& GetIgnoreRules(const MonitoredRepository& repository);
+
+	/**
+	* Removes changes to untracked ignored paths, which can't affect status.
+	*/
+	void RemoveIgnoredChanges(const MonitoredRepository& repository, std::vector<std::tuple<uint32_t, std::string>>& statusChanges);
+
+	/**
+	* Checks if the file change requires closing pooled repository handles. Open handles
+	* keep pack files open, which prevents git from deleting them, and may not reread config.
+	* Only the repository directory's config and pack files qualify.
+	*/
+	static bool ShouldReleaseRepository(const std::filesystem::path& path, const MonitoredRepository& repository);
+
+	/**
+	* Handles a batch of file change notifications for monitored directories by grouping them
+	* by repository, so that each repository is handled once however many of its directories changed.
+	*/
+	void OnFilesChanged(const std::vector<DirectoryMonitor::DirectoryChanges>& directoryChanges);
+
+	/**
+	* Handles the changes to a repository's monitored directories by invalidating its cache
+	* entry and scheduling priming once for the whole batch.
+	*/
+	void OnRepositoryFilesChanged(
+		const MonitoredRepository& repository,
+		const std::vector<const std::vector<DirectoryMonitor::FileChange>*>& changeLists);
+
+public:
+	CacheInvalidator(const std::shared_ptr<Cache>& cache);
+
+	/**
+	* Registers callback invoked when repositories may have been created or removed,
+	* or when file change notifications were lost. Must be called before directories are monitored.
+	*/
+	void SetOnRepositoriesChangedCallback(const OnRepositoriesChangedCallback& onRepositoriesChangedCallback);
+
+	/**
+	* Registers working directory and repository directory for file change monitoring.
+	*/
+	void MonitorRepositoryDirectories(const Git::Status& status);
+
+	/**
+	* Returns paths of all repositories registered for file change monitoring.
+	*/
+	std::unordered_set<std::string> GetMonitoredRepositories();
+
+	/**
+	* Schedules immediate recomputation of a stale cache entry that was served to a client.
+	*/
+	void RefreshStaleCacheEntry(const std::string& repositoryPath);
+
+	/**
+	* Schedules background recomputation of a cache entry restored from a snapshot, which
+	* keeps being served until it's verified.
+	*/
+	void VerifyRestoredCacheEntry(const std::string& repositoryPath);
 };
\ No newline at end of file
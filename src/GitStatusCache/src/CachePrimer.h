@@ -1,47 +1,61 @@
-#pragma once
-#include "Cache.h"
-
-#include <chrono>
-#include <mutex>
-#include <thread>
-#include <unordered_set>
-
-/**
-* Actively updates invalidated cache entries to reduce cache misses on client requests.
-* This class is thread-safe.
-*/
-class CachePrimer
-{
-private:
-	using LockGuard = std::lock_guard<std::mutex>;
-
-	std::shared_ptr<Cache> m_cache;
-
-	UniqueHandle m_stopPrimingThread;
-	std::thread m_primingThread;
-	std::chrono::time_point<std::chrono::steady_clock> m_deadline;
-	std::unordered_set<std::string> m_repositoriesToPrime;
-	std::mutex m_primingMutex;
-
-	/**
-	* Primes cache by computing status for scheduled repositories.
-	*/
-	void Prime();
-
-	/**
-	* Reserves thread for priming operations until cache shuts down.
-	*/
-	void WaitForPrimingTimerExpiration();
-
-public:
-	CachePrimer(const std::shared_ptr<Cache>& cache);
-	CachePrimer(const CachePrimer&) = delete;
-	~CachePrimer();
-
-	/**
-	* Cancels any currently scheduled priming and reschedules for five seconds in the future.
-	* Called repeatedly on file changes to refresh status for repositories five seconds after
-	* a wave file change events (ex. a build) subsides.
-	*/
-	void SchedulePrimingForRepositoryPath(const std::string& repositoryPath);
+#pragma once
+#include "Cache.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+/**
+* Actively updates invalidated cache entries to reduce cache misses on client requests.
+* This class is thread-safe.
+*/
+class CachePrimer
+{
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+
+	std::shared_ptr<Cache> m_cache;
+
+	UniqueHandle m_stopPrimingThread;
+	UniqueHandle m_primeImmediately;
+	std::thread m_primingThread;
+	std::chrono::time_point<std::chrono::steady_clock> m_deadline;
+	std::unordered_set<std::string> m_repositoriesToPrime;
+	std::unordered_set<std::string> m_repositoriesToPrimeImmediately;
+	std::mutex m_primingMutex;
+
+	/**
+	* Primes cache by computing status for repositories in the provided schedule.
+	*/
+	void Prime(std::unordered_set<std::string>& scheduledRepositories);
+
+	/**
+	* Reserves thread for priming operations until cache shuts down.
+	* Also periodically closes the cache's idle repository handles.
+	*/
+	void WaitForPrimingTimerExpiration();
+
+public:
+	CachePrimer(const std::shared_ptr<Cache>& cache);
+	CachePrimer(const CachePrimer&) = delete;
+	~CachePrimer();
+
+	/**
+	* Cancels any currently scheduled priming and reschedules for five seconds in the future.
+	* Called repeatedly on file changes to refresh status for repositories five seconds after
+	* a wave file change events (ex. a build) subsides.
+	*/
+	void SchedulePrimingForRepositoryPath(const std::string& repositoryPath);
+
+	/**
+	* Wakes the priming thread to refresh the repository without waiting for the priming timer.
+	* Used to recompute stale statuses that have been served to clients.
+	*/
+	void ScheduleImmediatePrimingForRepositoryPath(const std::string& repositoryPath);
+
+	/**
+	* Removes repository from all priming schedules. Used when the repository is evicted from the cache.
+	*/
+	void CancelPrimingForRepositoryPath(const std::string& repositoryPath);
 };
\ No newline at end of file
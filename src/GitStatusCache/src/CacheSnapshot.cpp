@@ -0,0 +1,404 @@
+#include "stdafx.h"
+#include "CacheSnapshot.h"
+#include "StringConverters.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char SnapshotMagic[4] = { 'G', 'S', 'C', 'S' };
+	const uint32_t SnapshotVersion = 3;
+
+	/**
+	* Serializes values into a snapshot buffer. Integers are stored little-endian and
+	* strings and lists are prefixed by their length.
+	*/
+	class SnapshotWriter
+	{
+	private:
+		std::string m_buffer;
+
+	public:
+		const std::string& GetBuffer() const
+		{
+			return m_buffer;
+		}
+
+		void WriteBytes(const void* bytes, size_t size)
+		{
+			m_buffer.append(static_cast<const char*>(bytes), size);
+		}
+
+		template <typename T>
+		void WriteInteger(T value)
+		{
+			static_assert(std::is_integral<T>::value, "Snapshots only store integers.");
+			WriteBytes(&value, sizeof(value));
+		}
+
+		void WriteString(std::string_view value)
+		{
+			WriteInteger(static_cast<uint32_t>(value.size()));
+			WriteBytes(value.data(), value.size());
+		}
+
+		void WritePaths(const StatusPaths& paths, uint8_t category)
+		{
+			WriteInteger(static_cast<uint32_t>(paths.Size(category)));
+			if (StatusPaths::IsRenamedCategory(category))
+			{
+				paths.ForEachRenamed(category, SIZE_MAX, [this](std::string_view oldPath, std::string_view newPath)
+				{
+					WriteString(oldPath);
+					WriteString(newPath);
+				});
+			}
+			else
+			{
+				paths.ForEach(category, SIZE_MAX, [this](std::string_view path) { WriteString(path); });
+			}
+		}
+	};
+
+	/**
+	* Deserializes values from a mapped snapshot. Reads past the end of the snapshot
+	* fail, leave the output untouched and cause all subsequent reads to fail.
+	*/
+	class SnapshotReader
+	{
+	private:
+		const char* m_position;
+		const char* m_end;
+		bool m_failed = false;
+
+	public:
+		SnapshotReader(const char* begin, size_t size)
+			: m_position(begin)
+			, m_end(begin + size)
+		{
+		}
+
+		bool Failed() const
+		{
+			return m_failed;
+		}
+
+		/**
+		* Reads a list length. Fails if the snapshot is too short to hold that many
+		* length-prefixed items, which guards against allocating for corrupt lengths.
+		*/
+		bool ReadCount(uint32_t& count)
+		{
+			if (!ReadInteger(count) || count > static_cast<size_t>(m_end - m_position) / sizeof(uint32_t))
+			{
+				m_failed = true;
+				return false;
+			}
+			return true;
+		}
+
+		bool ReadBytes(void* bytes, size_t size)
+		{
+			if (m_failed || static_cast<size_t>(m_end - m_position) < size)
+			{
+				m_failed = true;
+				return false;
+			}
+
+			std::memcpy(bytes, m_position, size);
+			m_position += size;
+			return true;
+		}
+
+		template <typename T>
+		bool ReadInteger(T& value)
+		{
+			static_assert(std::is_integral<T>::value, "Snapshots only store integers.");
+			return ReadBytes(&value, sizeof(value));
+		}
+
+		/**
+		* Reads a string in place. The view is valid for as long as the snapshot is mapped.
+		*/
+		bool ReadString(std::string_view& value)
+		{
+			uint32_t size = 0;
+			if (!ReadInteger(size) || static_cast<size_t>(m_end - m_position) < size)
+			{
+				m_failed = true;
+				return false;
+			}
+
+			value = std::string_view(m_position, size);
+			m_position += size;
+			return true;
+		}
+
+		bool ReadString(std::string& value)
+		{
+			std::string_view view;
+			if (!ReadString(view))
+				return false;
+
+			value.assign(view.data(), view.size());
+			return true;
+		}
+
+		bool ReadPaths(StatusPaths::Builder& paths, uint8_t category)
+		{
+			uint32_t count = 0;
+			if (!ReadCount(count))
+				return false;
+
+			auto isRenamed = StatusPaths::IsRenamedCategory(category);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				std::string_view path;
+				std::string_view newPath;
+				if (!ReadString(path) || (isRenamed && !ReadString(newPath)))
+					return false;
+
+				if (isRenamed)
+					paths.AddRenamed(category, path, newPath);
+				else
+					paths.Add(category, path);
+			}
+			return true;
+		}
+	};
+
+	void WriteStatus(SnapshotWriter& writer, const Git::Status& status)
+	{
+		writer.WriteInteger(status.ComputedParts);
+		writer.WriteString(status.RepositoryPath);
+		writer.WriteString(status.WorkingDirectory);
+		writer.WriteString(status.State);
+
+		writer.WriteString(status.Branch);
+		writer.WriteString(status.Upstream);
+		writer.WriteInteger(static_cast<uint8_t>(status.UpstreamGone));
+		writer.WriteInteger(static_cast<uint64_t>(status.AheadBy));
+		writer.WriteInteger(static_cast<uint64_t>(status.BehindBy));
+
+		for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+			writer.WritePaths(status.Paths, category);
+
+		writer.WriteInteger(static_cast<uint64_t>(status.MaxPaths));
+		for (auto count : status.PathCounts)
+			writer.WriteInteger(static_cast<uint64_t>(count));
+
+		writer.WriteInteger(static_cast<uint32_t>(status.Stashes.size()));
+		for (const auto& stash : status.Stashes)
+		{
+			writer.WriteInteger(stash.Index);
+			writer.WriteString(stash.Sha1Id);
+			writer.WriteString(stash.Message);
+		}
+	}
+
+	bool ReadStatus(SnapshotReader& reader, Git::Status& status)
+	{
+		reader.ReadInteger(status.ComputedParts);
+		reader.ReadString(status.RepositoryPath);
+		reader.ReadString(status.WorkingDirectory);
+		reader.ReadString(status.State);
+
+		uint8_t upstreamGone = 0;
+		uint64_t aheadBy = 0;
+		uint64_t behindBy = 0;
+		reader.ReadString(status.Branch);
+		reader.ReadString(status.Upstream);
+		reader.ReadInteger(upstreamGone);
+		reader.ReadInteger(aheadBy);
+		reader.ReadInteger(behindBy);
+		status.UpstreamGone = upstreamGone != 0;
+		status.AheadBy = static_cast<size_t>(aheadBy);
+		status.BehindBy = static_cast<size_t>(behindBy);
+
+		StatusPaths::Builder paths;
+		for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+			reader.ReadPaths(paths, category);
+		status.Paths = paths.Build();
+
+		uint64_t maxPaths = 0;
+		reader.ReadInteger(maxPaths);
+		status.MaxPaths = static_cast<size_t>(maxPaths);
+		for (auto& count : status.PathCounts)
+		{
+			uint64_t value = 0;
+			reader.ReadInteger(value);
+			count = static_cast<size_t>(value);
+		}
+
+		uint32_t stashCount = 0;
+		if (!reader.ReadCount(stashCount))
+			return false;
+
+		status.Stashes.resize(stashCount);
+		for (auto& stash : status.Stashes)
+		{
+			reader.ReadInteger(stash.Index);
+			reader.ReadString(stash.Sha1Id);
+			reader.ReadString(stash.Message);
+		}
+
+		return !reader.Failed();
+	}
+}
+
+/*static*/ CacheSnapshot::FileStamp CacheSnapshot::GetFileStamp(const std::filesystem::path& path)
+{
+	FileStamp stamp;
+	std::error_code error;
+	auto size = std::filesystem::file_size(path, error);
+	if (error)
+		return stamp;
+
+	auto lastWriteTime = std::filesystem::last_write_time(path, error);
+	if (error)
+		return stamp;
+
+	stamp.Size = size;
+	stamp.LastWriteTime = lastWriteTime.time_since_epoch().count();
+	return stamp;
+}
+
+/*static*/ std::tuple<CacheSnapshot::FileStamp, CacheSnapshot::FileStamp> CacheSnapshot::GetRepositoryStamps(const std::string& repositoryPath)
+{
+	auto path = std::filesystem::path(ConvertToUnicode(repositoryPath));
+	return std::make_tuple(GetFileStamp(path / L"index"), GetFileStamp(path / L"HEAD"));
+}
+
+/*static*/ bool CacheSnapshot::Write(const std::filesystem::path& path, const std::vector<Entry>& entries)
+{
+	SnapshotWriter writer;
+	writer.WriteBytes(SnapshotMagic, sizeof(SnapshotMagic));
+	writer.WriteInteger(SnapshotVersion);
+	writer.WriteInteger(static_cast<uint32_t>(entries.size()));
+
+	for (const auto& entry : entries)
+	{
+		auto stamps = GetRepositoryStamps(entry.Status->RepositoryPath);
+		writer.WriteInteger(static_cast<uint8_t>(entry.IsStale));
+		writer.WriteInteger(std::get<0>(stamps).Size);
+		writer.WriteInteger(std::get<0>(stamps).LastWriteTime);
+		writer.WriteInteger(std::get<1>(stamps).Size);
+		writer.WriteInteger(std::get<1>(stamps).LastWriteTime);
+		WriteStatus(writer, *entry.Status);
+	}
+
+	auto temporaryPath = path;
+	temporaryPath += L".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			//Log("CacheSnapshot.Write.OpenFailed", Severity::Error)
+			//	<< R"(Failed to open cache snapshot for writing. { "path": ")" << temporaryPath.c_str() << R"(" })";
+			return false;
+		}
+
+		const auto& buffer = writer.GetBuffer();
+		file.write(buffer.data(), buffer.size());
+		if (!file.good())
+		{
+			//Log("CacheSnapshot.Write.WriteFailed", Severity::Error)
+			//	<< R"(Failed to write cache snapshot. { "path": ")" << temporaryPath.c_str() << R"(" })";
+			return false;
+		}
+	}
+
+	if (!::MoveFileExW(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		//Log("CacheSnapshot.Write.ReplaceFailed", Severity::Error)
+		//	<< R"(Failed to replace cache snapshot. { "path": ")" << path.c_str() << R"(", "error": )" << ::GetLastError() << " }";
+		return false;
+	}
+
+	return true;
+}
+
+/*static*/ std::tuple<bool, std::vector<CacheSnapshot::Entry>> CacheSnapshot::Read(const std::filesystem::path& path)
+{
+	std::vector<Entry> entries;
+
+	auto file = MakeUniqueHandle(::CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr /*lpSecurityAttributes*/,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr /*hTemplateFile*/));
+	if (file.get() == INVALID_HANDLE_VALUE)
+	{
+		//Log("CacheSnapshot.Read.OpenFailed", Severity::Info)
+		//	<< R"(No cache snapshot to load. { "path": ")" << path.c_str() << R"(" })";
+		return std::make_tuple(false, std::move(entries));
+	}
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return std::make_tuple(false, std::move(entries));
+
+	auto mapping = ::CreateFileMappingW(file, nullptr /*lpAttributes*/, PAGE_READONLY, 0, 0, nullptr /*lpName*/);
+	if (mapping == nullptr)
+		return std::make_tuple(false, std::move(entries));
+	auto mappingHandle = MakeUniqueHandle(mapping);
+
+	auto view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+		return std::make_tuple(false, std::move(entries));
+	auto unmapView = std::experimental::scope_guard([view] { ::UnmapViewOfFile(view); });
+
+	SnapshotReader reader(static_cast<const char*>(view), static_cast<size_t>(size.QuadPart));
+	char magic[sizeof(SnapshotMagic)];
+	uint32_t version = 0;
+	uint32_t entryCount = 0;
+	reader.ReadBytes(magic, sizeof(magic));
+	reader.ReadInteger(version);
+	reader.ReadInteger(entryCount);
+	if (reader.Failed() || std::memcmp(magic, SnapshotMagic, sizeof(magic)) != 0 || version != SnapshotVersion)
+	{
+		//Log("CacheSnapshot.Read.UnrecognizedFormat", Severity::Warning)
+		//	<< R"(Ignoring cache snapshot with unrecognized format. { "path": ")" << path.c_str() << R"(" })";
+		return std::make_tuple(false, std::move(entries));
+	}
+
+	for (uint32_t i = 0; i < entryCount; ++i)
+	{
+		uint8_t isStale = 0;
+		FileStamp index;
+		FileStamp head;
+		reader.ReadInteger(isStale);
+		reader.ReadInteger(index.Size);
+		reader.ReadInteger(index.LastWriteTime);
+		reader.ReadInteger(head.Size);
+		reader.ReadInteger(head.LastWriteTime);
+
+		Git::Status status;
+		if (!ReadStatus(reader, status))
+		{
+			//Log("CacheSnapshot.Read.Truncated", Severity::Warning)
+			//	<< R"(Ignoring truncated cache snapshot. { "path": ")" << path.c_str() << R"(" })";
+			entries.clear();
+			return std::make_tuple(false, std::move(entries));
+		}
+
+		auto stamps = GetRepositoryStamps(status.RepositoryPath);
+		const auto& currentIndex = std::get<0>(stamps);
+		const auto& currentHead = std::get<1>(stamps);
+		bool changed = currentIndex.Size != index.Size
+			|| currentIndex.LastWriteTime != index.LastWriteTime
+			|| currentHead.Size != head.Size
+			|| currentHead.LastWriteTime != head.LastWriteTime;
+
+		Entry entry;
+		entry.Status = std::make_shared<const Git::Status>(std::move(status));
+		entry.IsStale = isStale != 0 || changed;
+		entries.push_back(std::move(entry));
+	}
+
+	return std::make_tuple(true, std::move(entries));
+}
\ No newline at end of file
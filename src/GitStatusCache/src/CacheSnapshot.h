@@ -0,0 +1,58 @@
+#pragma once
+#include "Git.h"
+
+#include <filesystem>
+
+/**
+* Reads and writes snapshots of cached statuses so that restarts begin with a warm cache.
+* Snapshots record stat data for each repository's index and HEAD, which is compared on
+* load to detect repositories that changed while the cache wasn't running.
+*/
+class CacheSnapshot
+{
+public:
+	/**
+	* Status stored in or loaded from a snapshot.
+	*/
+	struct Entry
+	{
+		std::shared_ptr<const Git::Status> Status;
+
+		/**
+		* True if the status was stale when written or its repository changed since.
+		*/
+		bool IsStale = false;
+	};
+
+private:
+	/**
+	* Size and last write time of a file within the repository directory.
+	*/
+	struct FileStamp
+	{
+		uint64_t Size = 0;
+		int64_t LastWriteTime = 0;
+	};
+
+	/**
+	* Retrieves stat data for file at provided path. Missing files produce an empty stamp.
+	*/
+	static FileStamp GetFileStamp(const std::filesystem::path& path);
+
+	/**
+	* Retrieves stat data for the repository's index and HEAD.
+	*/
+	static std::tuple<FileStamp, FileStamp> GetRepositoryStamps(const std::string& repositoryPath);
+
+public:
+	/**
+	* Writes entries to snapshot at provided path, replacing any existing snapshot.
+	*/
+	static bool Write(const std::filesystem::path& path, const std::vector<Entry>& entries);
+
+	/**
+	* Reads entries from snapshot at provided path. Entries for repositories whose
+	* index or HEAD changed since the snapshot was written are flagged as stale.
+	*/
+	static std::tuple<bool, std::vector<Entry>> Read(const std::filesystem::path& path);
+};
\ No newline at end of file
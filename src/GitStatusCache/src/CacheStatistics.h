@@ -1,12 +1,18 @@
-#pragma once
-
-struct CacheStatistics
-{
-	uint64_t CacheHits = 0;
-	uint64_t CacheMisses = 0;
-	uint64_t CacheEffectivePrimeRequests = 0;
-	uint64_t CacheTotalPrimeRequests = 0;
-	uint64_t CacheEffectiveInvalidationRequests = 0;
-	uint64_t CacheTotalInvalidationRequests = 0;
-	uint64_t CacheInvalidateAllRequests = 0;
+#pragma once
+
+struct CacheStatistics
+{
+	uint64_t CacheHits = 0;
+	uint64_t CacheStaleHits = 0;
+	uint64_t CacheMisses = 0;
+	uint64_t CacheIncrementalRecomputations = 0;
+	uint64_t CacheCoalescedRequests = 0;
+	uint64_t CacheEffectivePrimeRequests = 0;
+	uint64_t CacheTotalPrimeRequests = 0;
+	uint64_t CacheEffectiveInvalidationRequests = 0;
+	uint64_t CacheTotalInvalidationRequests = 0;
+	uint64_t CacheInvalidateAllRequests = 0;
+	uint64_t CacheResidentBytes = 0;
+	uint64_t CacheFrontCodingSavedBytes = 0;
+	uint64_t CacheEvictions = 0;
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include "Git.h"
+
+#include <chrono>
+
+/**
+* Git status as stored in and returned by the cache.
+*/
+struct CachedStatus
+{
+	/**
+	* False if git status could not be retrieved for the repository.
+	*/
+	bool Success = false;
+
+	/**
+	* Immutable status snapshot shared between the cache and its readers.
+	*/
+	std::shared_ptr<const Git::Status> Status;
+
+	/**
+	* True if a file change invalidated the status after it was computed.
+	*/
+	bool IsStale = false;
+
+	/**
+	* Repository generation the status was computed for. Generations change whenever
+	* the repository is invalidated and are never reused.
+	*/
+	uint64_t Generation = 0;
+
+	/**
+	* Time at which the status was computed.
+	*/
+	std::chrono::steady_clock::time_point ComputedAt;
+};
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "stdafx.h"
+#include "CommitGraph.h"
+#include "StringConverters.h"
+
+#include <cstring>
+#include <queue>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t SignatureChunkId = 0x43475048; // CGPH
+	const uint32_t FanoutChunkId = 0x4F494446; // OIDF
+	const uint32_t ObjectIdsChunkId = 0x4F49444C; // OIDL
+	const uint32_t CommitDataChunkId = 0x43444154; // CDAT
+	const uint32_t ExtraEdgesChunkId = 0x45444745; // EDGE
+
+	const size_t HeaderSize = 8;
+	const size_t ChunkEntrySize = 12;
+	const size_t ObjectIdSize = 20;
+	const size_t CommitDataSize = ObjectIdSize + 16;
+
+	const uint32_t ParentNone = 0x70000000;
+	const uint32_t ExtraEdgesNeeded = 0x80000000;
+	const uint32_t LastEdge = 0x80000000;
+
+	const uint8_t LocalFlag = 1 << 0;
+	const uint8_t UpstreamFlag = 1 << 1;
+	const uint8_t BothFlags = LocalFlag | UpstreamFlag;
+	const uint8_t QueuedFlag = 1 << 2;
+
+	uint32_t ReadBigEndian32(const uint8_t* bytes)
+	{
+		return (static_cast<uint32_t>(bytes[0]) << 24)
+			| (static_cast<uint32_t>(bytes[1]) << 16)
+			| (static_cast<uint32_t>(bytes[2]) << 8)
+			| static_cast<uint32_t>(bytes[3]);
+	}
+
+	uint64_t ReadBigEndian64(const uint8_t* bytes)
+	{
+		return (static_cast<uint64_t>(ReadBigEndian32(bytes)) << 32) | ReadBigEndian32(bytes + 4);
+	}
+}
+
+size_t CommitGraph::ObjectIdHash::operator()(const git_oid& id) const
+{
+	// Object ids are uniformly distributed, so their leading bytes make a good hash.
+	size_t hash;
+	std::memcpy(&hash, id.id, sizeof(hash));
+	return hash;
+}
+
+bool CommitGraph::ObjectIdEqual::operator()(const git_oid& lhs, const git_oid& rhs) const
+{
+	return git_oid_equal(&lhs, &rhs) != 0;
+}
+
+#ifdef _WIN32
+CommitGraph::CommitGraph()
+	: m_file(MakeUniqueHandle(INVALID_HANDLE_VALUE))
+	, m_mapping(MakeUniqueHandle(INVALID_HANDLE_VALUE))
+{
+}
+
+CommitGraph::~CommitGraph()
+{
+	if (m_view != nullptr)
+		::UnmapViewOfFile(m_view);
+}
+#else
+CommitGraph::CommitGraph()
+{
+}
+
+CommitGraph::~CommitGraph()
+{
+	if (m_view != nullptr)
+		::munmap(const_cast<uint8_t*>(m_view), m_viewSize);
+}
+#endif
+
+bool CommitGraph::Open(git_repository* repository)
+{
+	m_repository = repository;
+
+	// Git ignores commit-graph in shallow repositories, since their history is truncated.
+	auto commonDirectory = std::filesystem::path(ConvertToUnicode(git_repository_commondir(repository)));
+	if (std::filesystem::exists(commonDirectory / L"shallow"))
+		return false;
+
+	return CommitGraph::Map(commonDirectory / L"objects" / L"info" / L"commit-graph");
+}
+
+bool CommitGraph::Map(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+	auto file = ::CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		nullptr /*lpSecurityAttributes*/,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr /*hTemplateFile*/);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = MakeUniqueHandle(file);
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) < HeaderSize + ChunkEntrySize)
+		return false;
+
+	auto mapping = ::CreateFileMappingW(file, nullptr /*lpAttributes*/, PAGE_READONLY, 0, 0, nullptr /*lpName*/);
+	if (mapping == nullptr)
+		return false;
+	m_mapping = MakeUniqueHandle(mapping);
+
+	m_view = static_cast<const uint8_t*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_view == nullptr)
+		return false;
+
+	auto fileSize = static_cast<uint64_t>(size.QuadPart);
+#else
+	// The mapping stays valid after the descriptor is closed.
+	auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file == -1)
+		return false;
+	auto closeFile = std::experimental::scope_guard([file] { ::close(file); });
+
+	struct stat fileStatus;
+	if (::fstat(file, &fileStatus) != 0 || static_cast<uint64_t>(fileStatus.st_size) < HeaderSize + ChunkEntrySize)
+		return false;
+
+	auto view = ::mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+		return false;
+	m_view = static_cast<const uint8_t*>(view);
+	m_viewSize = static_cast<size_t>(fileStatus.st_size);
+
+	auto fileSize = static_cast<uint64_t>(fileStatus.st_size);
+#endif
+	auto version = m_view[4];
+	auto hashVersion = m_view[5];
+	auto chunkCount = m_view[6];
+	auto baseGraphCount = m_view[7];
+	if (ReadBigEndian32(m_view) != SignatureChunkId || version != 1 || hashVersion != 1 || baseGraphCount != 0)
+	{
+		//Log("CommitGraph.Map.UnsupportedFormat", Severity::Verbose)
+		//	<< R"(Unsupported commit-graph format. { "path": ")" << path.c_str() << R"(" })";
+		return false;
+	}
+
+	if (HeaderSize + ChunkEntrySize * (chunkCount + 1) > fileSize)
+		return false;
+
+	uint64_t fanoutOffset = 0, objectIdsOffset = 0, commitDataOffset = 0, extraEdgesOffset = 0, extraEdgesEnd = 0;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		auto chunkEntry = m_view + HeaderSize + ChunkEntrySize * i;
+		auto chunkId = ReadBigEndian32(chunkEntry);
+		auto chunkOffset = ReadBigEndian64(chunkEntry + 4);
+		auto chunkEnd = ReadBigEndian64(chunkEntry + ChunkEntrySize + 4);
+		if (chunkOffset > chunkEnd || chunkEnd > fileSize)
+			return false;
+
+		if (chunkId == FanoutChunkId && chunkEnd - chunkOffset >= 256 * sizeof(uint32_t))
+			fanoutOffset = chunkOffset;
+		else if (chunkId == ObjectIdsChunkId)
+			objectIdsOffset = chunkOffset;
+		else if (chunkId == CommitDataChunkId)
+			commitDataOffset = chunkOffset;
+		else if (chunkId == ExtraEdgesChunkId)
+		{
+			extraEdgesOffset = chunkOffset;
+			extraEdgesEnd = chunkEnd;
+		}
+	}
+
+	if (fanoutOffset == 0 || objectIdsOffset == 0 || commitDataOffset == 0)
+		return false;
+
+	m_fanout = m_view + fanoutOffset;
+	m_commitCount = ReadBigEndian32(m_fanout + 255 * sizeof(uint32_t));
+	if (objectIdsOffset + static_cast<uint64_t>(m_commitCount) * ObjectIdSize > fileSize
+		|| commitDataOffset + static_cast<uint64_t>(m_commitCount) * CommitDataSize > fileSize
+		|| m_commitCount >= ParentNone)
+	{
+		return false;
+	}
+
+	m_objectIds = m_view + objectIdsOffset;
+	m_commitData = m_view + commitDataOffset;
+	if (extraEdgesOffset != 0)
+	{
+		m_extraEdges = m_view + extraEdgesOffset;
+		m_extraEdgeCount = static_cast<size_t>((extraEdgesEnd - extraEdgesOffset) / sizeof(uint32_t));
+	}
+
+	return true;
+}
+
+bool CommitGraph::FindNode(const git_oid& id, uint32_t& node) const
+{
+	auto firstByte = id.id[0];
+	uint32_t low = firstByte == 0 ? 0 : ReadBigEndian32(m_fanout + (firstByte - 1) * sizeof(uint32_t));
+	uint32_t high = ReadBigEndian32(m_fanout + firstByte * sizeof(uint32_t));
+	high = (std::min)(high, m_commitCount);
+	while (low < high)
+	{
+		auto middle = low + (high - low) / 2;
+		auto comparison = std::memcmp(m_objectIds + static_cast<size_t>(middle) * ObjectIdSize, id.id, ObjectIdSize);
+		if (comparison == 0)
+		{
+			node = middle;
+			return true;
+		}
+
+		if (comparison < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	auto ungraphedNode = m_ungraphedNodes.find(id);
+	if (ungraphedNode == m_ungraphedNodes.end())
+		return false;
+
+	node = ungraphedNode->second;
+	return true;
+}
+
+bool CommitGraph::ResolveNode(const git_oid& id, uint32_t& node)
+{
+	if (CommitGraph::FindNode(id, node))
+		return true;
+
+	// Resolves ancestors depth first, since a commit's generation depends on its parents'.
+	std::vector<std::pair<git_oid, std::vector<git_oid>>> unresolvedCommits;
+	std::vector<git_oid> parentIds;
+	if (!CommitGraph::LookupParentIds(id, parentIds))
+		return false;
+	unresolvedCommits.emplace_back(id, std::move(parentIds));
+
+	while (!unresolvedCommits.empty())
+	{
+		if (m_ungraphedCommits.size() + unresolvedCommits.size() > MaxUngraphedCommits)
+		{
+			//Log("CommitGraph.ResolveNode.TooManyUngraphedCommits", Severity::Verbose)
+			//	<< R"(Commit-graph file is too far behind history to be useful.)";
+			return false;
+		}
+
+		UngraphedCommit commit;
+		git_oid unresolvedParentId;
+		auto hasUnresolvedParent = false;
+		for (const auto& parentId : unresolvedCommits.back().second)
+		{
+			uint32_t parent;
+			if (!CommitGraph::FindNode(parentId, parent))
+			{
+				unresolvedParentId = parentId;
+				hasUnresolvedParent = true;
+				break;
+			}
+
+			auto parentGeneration = CommitGraph::GetGeneration(parent);
+			if (parentGeneration == 0 || parentGeneration >= MaxGeneration)
+				return false;
+
+			commit.Generation = (std::max)(commit.Generation, parentGeneration + 1);
+			commit.Parents.push_back(parent);
+		}
+
+		if (hasUnresolvedParent)
+		{
+			if (!CommitGraph::LookupParentIds(unresolvedParentId, parentIds))
+				return false;
+			unresolvedCommits.emplace_back(unresolvedParentId, std::move(parentIds));
+			continue;
+		}
+
+		if (commit.Parents.empty())
+			commit.Generation = 1;
+
+		node = m_commitCount + static_cast<uint32_t>(m_ungraphedCommits.size());
+		m_ungraphedNodes.emplace(unresolvedCommits.back().first, node);
+		m_ungraphedCommits.emplace_back(std::move(commit));
+		unresolvedCommits.pop_back();
+	}
+
+	return true;
+}
+
+bool CommitGraph::LookupParentIds(const git_oid& id, std::vector<git_oid>& parentIds) const
+{
+	auto commit = MakeUniqueGitCommit(nullptr);
+	if (git_commit_lookup(&commit.get(), m_repository, &id) != GIT_OK)
+		return false;
+
+	parentIds.clear();
+	auto parentCount = git_commit_parentcount(commit.get());
+	for (unsigned int i = 0; i < parentCount; ++i)
+		parentIds.push_back(*git_commit_parent_id(commit.get(), i));
+	return true;
+}
+
+uint32_t CommitGraph::GetGeneration(uint32_t node) const
+{
+	if (node >= m_commitCount)
+		return m_ungraphedCommits[node - m_commitCount].Generation;
+
+	// Topological level occupies the upper 30 bits, followed by the commit time.
+	auto commitData = m_commitData + static_cast<size_t>(node) * CommitDataSize;
+	return ReadBigEndian32(commitData + ObjectIdSize + 8) >> 2;
+}
+
+bool CommitGraph::GetParents(uint32_t node, std::vector<uint32_t>& parents) const
+{
+	parents.clear();
+	if (node >= m_commitCount)
+	{
+		parents = m_ungraphedCommits[node - m_commitCount].Parents;
+		return true;
+	}
+
+	auto commitData = m_commitData + static_cast<size_t>(node) * CommitDataSize;
+	auto firstParent = ReadBigEndian32(commitData + ObjectIdSize);
+	auto secondParent = ReadBigEndian32(commitData + ObjectIdSize + 4);
+	if (firstParent == ParentNone)
+		return true;
+	if (firstParent >= m_commitCount)
+		return false;
+	parents.push_back(firstParent);
+
+	if (secondParent == ParentNone)
+		return true;
+	if ((secondParent & ExtraEdgesNeeded) == 0)
+	{
+		if (secondParent >= m_commitCount)
+			return false;
+		parents.push_back(secondParent);
+		return true;
+	}
+
+	// Octopus merges list their remaining parents in the extra edges chunk.
+	for (auto edge = static_cast<size_t>(secondParent & ~ExtraEdgesNeeded); edge < m_extraEdgeCount; ++edge)
+	{
+		auto parent = ReadBigEndian32(m_extraEdges + edge * sizeof(uint32_t));
+		if ((parent & ~LastEdge) >= m_commitCount)
+			return false;
+		parents.push_back(parent & ~LastEdge);
+		if ((parent & LastEdge) != 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool CommitGraph::AheadBehind(const git_oid& local, const git_oid& upstream, size_t& aheadBy, size_t& behindBy)
+{
+	uint32_t localNode;
+	uint32_t upstreamNode;
+	if (!CommitGraph::ResolveNode(local, localNode) || !CommitGraph::ResolveNode(upstream, upstreamNode))
+		return false;
+
+	// Walks both histories from the highest generation down. A commit's children all have
+	// higher generations, so its flags are final when it's popped. The walk ends once
+	// every queued commit is reachable from both sides.
+	std::unordered_map<uint32_t, uint8_t> flags;
+	std::priority_queue<std::pair<uint32_t, uint32_t>> queue;
+	size_t nonStaleCount = 0;
+	auto paint = [this, &flags, &queue, &nonStaleCount](uint32_t node, uint8_t paintedFlags)
+	{
+		auto& nodeFlags = flags[node];
+		auto previousFlags = nodeFlags;
+		nodeFlags |= paintedFlags;
+		if ((nodeFlags & BothFlags) == (previousFlags & BothFlags))
+			return true;
+
+		if ((previousFlags & QueuedFlag) != 0)
+		{
+			if ((nodeFlags & BothFlags) == BothFlags)
+				--nonStaleCount;
+			return true;
+		}
+
+		auto generation = CommitGraph::GetGeneration(node);
+		if (generation == 0 || generation >= MaxGeneration)
+			return false;
+
+		nodeFlags |= QueuedFlag;
+		queue.emplace(generation, node);
+		if ((nodeFlags & BothFlags) != BothFlags)
+			++nonStaleCount;
+		return true;
+	};
+
+	if (!paint(localNode, LocalFlag) || !paint(upstreamNode, UpstreamFlag))
+		return false;
+
+	aheadBy = 0;
+	behindBy = 0;
+	std::vector<uint32_t> parents;
+	while (nonStaleCount != 0)
+	{
+		auto node = queue.top().second;
+		queue.pop();
+
+		auto& nodeFlags = flags[node];
+		nodeFlags &= ~QueuedFlag;
+		auto nodeColor = static_cast<uint8_t>(nodeFlags & BothFlags);
+		if (nodeColor != BothFlags)
+		{
+			--nonStaleCount;
+			if (nodeColor == LocalFlag)
+				++aheadBy;
+			else
+				++behindBy;
+		}
+
+		// Stale commits still propagate, so that their ancestors become stale too.
+		if (!CommitGraph::GetParents(node, parents))
+			return false;
+
+		for (auto parent : parents)
+		{
+			if (!paint(parent, nodeColor))
+				return false;
+		}
+	}
+
+	return true;
+}
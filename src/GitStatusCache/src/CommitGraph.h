@@ -0,0 +1,109 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+* Read-only view of a repository's commit-graph file (objects/info/commit-graph).
+* Commit-graph stores each commit's parents and generation number in compact form,
+* which lets history walks avoid inflating commit objects from the object database.
+* Commits written after the graph are read through libgit2. The file is mapped only
+* for the lifetime of this object, so that git can replace it. This class is not
+* thread-safe.
+*/
+class CommitGraph
+{
+private:
+	/**
+	* Commit missing from the commit-graph file. Identified by nodes numbered
+	* after the commits in the file.
+	*/
+	struct UngraphedCommit
+	{
+		uint32_t Generation = 0;
+		std::vector<uint32_t> Parents;
+	};
+
+	struct ObjectIdHash
+	{
+		size_t operator()(const git_oid& id) const;
+	};
+
+	struct ObjectIdEqual
+	{
+		bool operator()(const git_oid& lhs, const git_oid& rhs) const;
+	};
+
+	static constexpr uint32_t MaxGeneration = 0x3FFFFFFF;
+	static constexpr size_t MaxUngraphedCommits = 4096;
+
+	git_repository* m_repository = nullptr;
+
+#ifdef _WIN32
+	UniqueHandle m_file;
+	UniqueHandle m_mapping;
+#else
+	size_t m_viewSize = 0;
+#endif
+	const uint8_t* m_view = nullptr;
+
+	uint32_t m_commitCount = 0;
+	const uint8_t* m_fanout = nullptr;
+	const uint8_t* m_objectIds = nullptr;
+	const uint8_t* m_commitData = nullptr;
+	const uint8_t* m_extraEdges = nullptr;
+	size_t m_extraEdgeCount = 0;
+
+	std::vector<UngraphedCommit> m_ungraphedCommits;
+	std::unordered_map<git_oid, uint32_t, ObjectIdHash, ObjectIdEqual> m_ungraphedNodes;
+
+	/**
+	* Maps commit-graph file at provided path and validates its chunks.
+	*/
+	bool Map(const std::filesystem::path& path);
+
+	/**
+	* Retrieves node for commit, if it was already resolved or is in the commit-graph file.
+	*/
+	bool FindNode(const git_oid& id, uint32_t& node) const;
+
+	/**
+	* Retrieves node for commit, reading it and its ancestors missing from the commit-graph
+	* file through libgit2 as needed.
+	*/
+	bool ResolveNode(const git_oid& id, uint32_t& node);
+
+	/**
+	* Retrieves ids of commit's parents through libgit2.
+	*/
+	bool LookupParentIds(const git_oid& id, std::vector<git_oid>& parentIds) const;
+
+	/**
+	* Retrieves generation number of node. Zero if the commit-graph file doesn't record one.
+	*/
+	uint32_t GetGeneration(uint32_t node) const;
+
+	/**
+	* Retrieves parents of node.
+	*/
+	bool GetParents(uint32_t node, std::vector<uint32_t>& parents) const;
+
+public:
+	CommitGraph();
+	CommitGraph(const CommitGraph&) = delete;
+	~CommitGraph();
+
+	/**
+	* Opens repository's commit-graph file. Fails if the repository has none, uses a split
+	* commit-graph chain or is shallow.
+	*/
+	bool Open(git_repository* repository);
+
+	/**
+	* Counts commits reachable from local but not upstream, and from upstream but not local.
+	* Equivalent to git_graph_ahead_behind.
+	*/
+	bool AheadBehind(const git_oid& local, const git_oid& upstream, size_t& aheadBy, size_t& behindBy);
+};
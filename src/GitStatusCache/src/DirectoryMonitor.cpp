@@ -1,155 +1,385 @@
-#include "stdafx.h"
-#include "DirectoryMonitor.h"
-
-void DirectoryMonitor::WaitForNotifications()
-{
-	//Log("DirectoryMonitor.WaitForNotifications.Start", Severity::Verbose) << "Thread for handling notifications started.";
-
-	const HANDLE handles[] = { m_stopNotificationThread, m_readDirectoryChanges.GetWaitHandle() };
-
-	bool shouldTerminate = false;
-	while (!shouldTerminate)
-	{
-		auto alertable = true;
-		DWORD waitResult = ::WaitForMultipleObjectsEx(_countof(handles), handles, false /*bWaitAll*/, INFINITE, true /*bAlertable*/);
-
-		if (waitResult == WAIT_OBJECT_0)
-		{
-			shouldTerminate = true;
-			//Log("DirectoryMonitor.WaitForNotifications.Stop", Severity::Verbose) << "Thread for handling notifications stopping.";
-		}
-		else if (waitResult == WAIT_OBJECT_0 + 1)
-		{
-			if (m_readDirectoryChanges.CheckOverflow())
-			{
-				//Log("DirectoryMonitor.Notification.Overflow", Severity::Warning)
-				//	<< "Change notification queue overflowed. Notifications were lost.";
-				if (m_onEventsLostCallback != nullptr)
-					m_onEventsLostCallback();
-			}
-			else
-			{
-				Token token;
-				DWORD action;
-				std::wstring path;
-				m_readDirectoryChanges.Pop(token, action, path);
-
-				bool shouldCallOnChangeCallback = true;
-				auto fileAction = DirectoryMonitor::FileAction::Unknown;
-				switch (action)
-				{
-				default:
-					//Log("DirectoryMonitor.Notification.Unknown", Severity::Warning)
-					//	<< R"(Unknown notification for file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
-					break;
-				case FILE_ACTION_ADDED:
-					//Log("DirectoryMonitor.Notification.Add", Severity::Spam)
-					//	<< R"(Added file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
-					fileAction = DirectoryMonitor::FileAction::Added;
-					break;
-				case FILE_ACTION_REMOVED:
-					//Log("DirectoryMonitor.Notification.Remove", Severity::Spam)
-					//	<< R"(Removed file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
-					fileAction = DirectoryMonitor::FileAction::Removed;
-					break;
-				case FILE_ACTION_MODIFIED:
-					//Log("DirectoryMonitor.Notification.Modified", Severity::Spam)
-					//	<< R"(Modified file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
-					fileAction = DirectoryMonitor::FileAction::Modified;
-					break;
-				case FILE_ACTION_RENAMED_OLD_NAME:
-					//Log("DirectoryMonitor.Notification.RenamedFrom", Severity::Spam)
-					//	<< R"(Renamed file. { "token": )" << token << R"(, "oldPath": ")" << path << R"(" })";
-					fileAction = DirectoryMonitor::FileAction::RenamedFrom;
-					break;
-				case FILE_ACTION_RENAMED_NEW_NAME:
-					//Log("DirectoryMonitor.Notification.RenamedTo", Severity::Spam)
-					//	<< R"(Renamed file. { "token": )" << token << R"(, "newPath": ")" << path << R"(" })";
-					fileAction = DirectoryMonitor::FileAction::RenamedTo;
-					break;
-				case FILE_ACTION_CHANGES_LOST:
-					//Log("DirectoryMonitor.Notification.EventsLost", Severity::Warning)
-					//	<< R"(Notifications lost. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
-					if (m_onEventsLostCallback != nullptr)
-						m_onEventsLostCallback();
-					shouldCallOnChangeCallback = false;
-					break;
-				}
-
-				if (m_onChangeCallback != nullptr && shouldCallOnChangeCallback)
-					m_onChangeCallback(token, std::filesystem::path(path), fileAction);
-			}
-		}
-	}
-}
-
-DirectoryMonitor::DirectoryMonitor(const OnChangeCallback& onChangeCallback, const OnEventsLostCallback& onEventsLostCallback) :
-	m_onChangeCallback(onChangeCallback),
-	m_onEventsLostCallback(onEventsLostCallback)
-{
-}
-
-DirectoryMonitor::~DirectoryMonitor()
-{
-	//Log("DirectoryMonitor.ShutDown", Severity::Verbose) << "Stopping directory monitor.";
-	m_readDirectoryChanges.Terminate();
-
-	if (m_stopNotificationThread != INVALID_HANDLE_VALUE)
-	{
-		//Log("DirectoryMonitor.ShutDown.StoppingBackgroundThread", Severity::Spam)
-		//	<< R"(Shutting down notification handling thread. { "threadId": 0x)" << std::hex << m_notificationThread.get_id() << " }";
-		::SetEvent(m_stopNotificationThread);
-		m_notificationThread.join();
-		::CloseHandle(m_stopNotificationThread);
-	}
-}
-
-DirectoryMonitor::Token DirectoryMonitor::AddDirectory(const std::wstring& directory)
-{
-	Token token;
-	{
-		std::unique_lock<std::shared_mutex> lock(m_directoriesMutex);
-		auto iterator = m_directories.find(directory);
-		if (iterator != m_directories.end())
-			return iterator->second;
-
-		static Token nextToken = 0;
-		token = nextToken++;
-		m_directories[directory] = token;
-	}
-
-	//Log("DirectoryMonitor.AddDirectory", Severity::Info)
-	//	<< R"(Registering directory for change notifications. { "token": )" << token << R"(, "path": ")" << directory << R"(" })";
-
-	auto notificationFlags =
-		FILE_NOTIFY_CHANGE_LAST_WRITE
-		| FILE_NOTIFY_CHANGE_CREATION
-		| FILE_NOTIFY_CHANGE_FILE_NAME
-		| FILE_NOTIFY_CHANGE_DIR_NAME
-		| FILE_NOTIFY_CHANGE_SIZE;
-	m_readDirectoryChanges.AddDirectory(directory.c_str(), token, true /*bWatchSubtree*/, notificationFlags);
-
-	static std::once_flag flag;
-	std::call_once(flag, [this]()
-	{
-		//Log("DirectoryMonitor.StartingBackgroundThread", Severity::Spam)
-		//	<< "Attempting to start background thread for handling notifications.";
-
-		auto stopNotificationThread = ::CreateEvent(
-			nullptr /*lpEventAttributes*/,
-			true    /*manualReset*/,
-			false   /*bInitialState*/,
-			nullptr /*lpName*/);
-		if (stopNotificationThread == nullptr)
-		{
-			//Log("DirectoryMonitor.StartingBackgroundThread.CreateEventFailed", Severity::Error)
-			//	<< "Failed to create event to signal thread on exit.";
-			throw std::runtime_error("CreateEvent failed unexpectedly.");
-		}
-		m_stopNotificationThread = stopNotificationThread;
-
-		m_notificationThread = std::thread(&DirectoryMonitor::WaitForNotifications, this);
-	});
-
-	return token;
-}
\ No newline at end of file
+#include "stdafx.h"
+#include "DirectoryMonitor.h"
+
+namespace
+{
+	/**
+	* Changes are queued for this long after the first one, so that bursts of changes, such as
+	* from builds or checkouts, are handled together.
+	*/
+	const std::chrono::milliseconds CoalescingWindow(50);
+
+	/**
+	* Directory trees are brought up to date with delivered changes at most this often.
+	*/
+	const std::chrono::seconds TreeRefreshInterval(1);
+
+	uint32_t GetMillisecondsUntil(std::chrono::steady_clock::time_point deadline)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			return 0;
+		return static_cast<uint32_t>(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+	}
+}
+
+void DirectoryMonitor::QueueChange(Token token, const std::filesystem::path& path, FileAction action)
+{
+	if (m_pendingChanges.empty())
+		m_deliveryDeadline = std::chrono::steady_clock::now() + CoalescingWindow;
+
+	auto directoryTree = m_directoryTrees.find(token);
+	if (directoryTree != m_directoryTrees.end())
+	{
+		directoryTree->second.MarkChanged(path);
+		if (!m_isRefreshScheduled)
+		{
+			m_isRefreshScheduled = true;
+			m_refreshDeadline = std::chrono::steady_clock::now() + TreeRefreshInterval;
+		}
+	}
+
+	auto& pendingChanges = m_pendingChanges[token];
+	auto changeIndex = pendingChanges.ChangeIndices.emplace(path.native(), pendingChanges.Changes.size());
+	if (changeIndex.second)
+	{
+		pendingChanges.Changes.push_back({ path, action });
+		return;
+	}
+
+	// Modifications carry less information than additions, removals or renames of the same path.
+	if (action != DirectoryMonitor::FileAction::Modified)
+		pendingChanges.Changes[changeIndex.first->second].Action = action;
+}
+
+bool DirectoryMonitor::GetMillisecondsUntilNextTask(uint32_t& milliseconds) const
+{
+	if (!m_pendingChanges.empty())
+	{
+		milliseconds = GetMillisecondsUntil(m_deliveryDeadline);
+		return true;
+	}
+
+	if (!m_directoryTreesToScan.empty())
+	{
+		milliseconds = 0;
+		return true;
+	}
+
+	if (m_isRefreshScheduled)
+	{
+		milliseconds = GetMillisecondsUntil(m_refreshDeadline);
+		return true;
+	}
+
+	return false;
+}
+
+void DirectoryMonitor::RunDueTasks()
+{
+	TakeAddedDirectoryTrees();
+
+	auto now = std::chrono::steady_clock::now();
+	if (!m_pendingChanges.empty())
+	{
+		if (now >= m_deliveryDeadline)
+			DeliverChanges();
+		return;
+	}
+
+	// Changes made during the scan are reported after it, since directories are watched first.
+	if (!m_directoryTreesToScan.empty())
+	{
+		auto token = m_directoryTreesToScan.front();
+		m_directoryTreesToScan.pop_front();
+		auto directoryTree = m_directoryTrees.find(token);
+		if (directoryTree != m_directoryTrees.end())
+			directoryTree->second.Scan();
+		return;
+	}
+
+	if (!m_isRefreshScheduled || now < m_refreshDeadline)
+		return;
+
+	m_isRefreshScheduled = false;
+	for (auto& directoryTree : m_directoryTrees)
+	{
+		if (directoryTree.second.HasChangedDirectories())
+			directoryTree.second.Refresh();
+	}
+}
+
+void DirectoryMonitor::DeliverChanges()
+{
+	// Notifications lost before earlier refreshes were reported by the reads preceding this delivery.
+	for (auto& directoryTree : m_directoryTrees)
+		directoryTree.second.ClearRefreshedDirectories();
+
+	auto pendingChanges = std::move(m_pendingChanges);
+	m_pendingChanges.clear();
+	if (m_onChangeCallback == nullptr)
+		return;
+
+	std::vector<DirectoryChanges> directoryChanges;
+	directoryChanges.reserve(pendingChanges.size());
+	for (auto& tokenChanges : pendingChanges)
+	{
+		//Log("DirectoryMonitor.DeliverChanges", Severity::Spam)
+		//	<< R"(Delivering file changes. { "token": )" << tokenChanges.first
+		//	<< R"(, "count": )" << tokenChanges.second.Changes.size() << " }";
+		directoryChanges.push_back({ tokenChanges.first, std::move(tokenChanges.second.Changes) });
+	}
+	m_onChangeCallback(directoryChanges);
+}
+
+void DirectoryMonitor::AddDirectoryTree(Token token, const std::filesystem::path& directory)
+{
+	LockGuard lock(m_addedDirectoryTreesMutex);
+	m_addedDirectoryTrees.emplace_back(token, DirectoryTree(directory));
+}
+
+void DirectoryMonitor::TakeAddedDirectoryTrees()
+{
+	std::vector<std::pair<Token, DirectoryTree>> addedDirectoryTrees;
+	{
+		LockGuard lock(m_addedDirectoryTreesMutex);
+		addedDirectoryTrees.swap(m_addedDirectoryTrees);
+	}
+
+	for (auto& addedDirectoryTree : addedDirectoryTrees)
+	{
+		m_directoryTrees.emplace(addedDirectoryTree.first, std::move(addedDirectoryTree.second));
+		m_directoryTreesToScan.push_back(addedDirectoryTree.first);
+	}
+}
+
+void DirectoryMonitor::QueueRecoveredChanges(Token token, DirectoryTree& directoryTree)
+{
+	if (!directoryTree.IsScanned())
+	{
+		//Log("DirectoryMonitor.RecoverLostChanges.NotScanned", Severity::Info)
+		//	<< R"(Directory wasn't scanned yet. Reporting unknown changes to all of it. { "token": )" << token
+		//	<< R"(, "path": ")" << directoryTree.GetRoot().c_str() << R"(" })";
+		QueueChange(token, directoryTree.GetRoot(), DirectoryMonitor::FileAction::Unknown);
+		return;
+	}
+
+	auto changes = directoryTree.Rescan();
+
+	//Log("DirectoryMonitor.RecoverLostChanges", Severity::Info)
+	//	<< R"(Rescanned directory for lost changes. { "token": )" << token
+	//	<< R"(, "path": ")" << directoryTree.GetRoot().c_str() << R"(", "changedDirectories": )" << changes.size() << " }";
+	for (const auto& change : changes)
+	{
+		auto fileAction = DirectoryMonitor::FileAction::Unknown;
+		if (change.Kind == DirectoryTree::ChangeKind::Added)
+			fileAction = DirectoryMonitor::FileAction::Added;
+		else if (change.Kind == DirectoryTree::ChangeKind::Removed)
+			fileAction = DirectoryMonitor::FileAction::Removed;
+		QueueChange(token, change.Path, fileAction);
+	}
+}
+
+void DirectoryMonitor::RecoverLostChanges(Token token)
+{
+	TakeAddedDirectoryTrees();
+
+	auto directoryTree = m_directoryTrees.find(token);
+	if (directoryTree != m_directoryTrees.end())
+		QueueRecoveredChanges(token, directoryTree->second);
+
+	if (m_onEventsLostCallback != nullptr)
+		m_onEventsLostCallback();
+}
+
+void DirectoryMonitor::RecoverLostChanges()
+{
+	// Lost notifications could have been for any directory, but only those that changed are reported.
+	TakeAddedDirectoryTrees();
+	for (auto& directoryTree : m_directoryTrees)
+		QueueRecoveredChanges(directoryTree.first, directoryTree.second);
+
+	if (m_onEventsLostCallback != nullptr)
+		m_onEventsLostCallback();
+}
+
+#ifdef _WIN32
+
+void DirectoryMonitor::WaitForNotifications()
+{
+	//Log("DirectoryMonitor.WaitForNotifications.Start", Severity::Verbose) << "Thread for handling notifications started.";
+
+	// The directory tree event only wakes the thread, so that added trees are taken and scanned.
+	const HANDLE handles[] = { m_stopNotificationThread, m_readDirectoryChanges.GetWaitHandle(), m_directoryTreeAdded };
+
+	bool shouldTerminate = false;
+	while (!shouldTerminate)
+	{
+		uint32_t timeout;
+		if (!GetMillisecondsUntilNextTask(timeout))
+			timeout = INFINITE;
+		DWORD waitResult = ::WaitForMultipleObjectsEx(_countof(handles), handles, false /*bWaitAll*/, timeout, true /*bAlertable*/);
+
+		if (waitResult == WAIT_OBJECT_0)
+		{
+			shouldTerminate = true;
+			//Log("DirectoryMonitor.WaitForNotifications.Stop", Severity::Verbose) << "Thread for handling notifications stopping.";
+		}
+		else if (waitResult == WAIT_OBJECT_0 + 1)
+		{
+			if (m_readDirectoryChanges.CheckOverflow())
+			{
+				//Log("DirectoryMonitor.Notification.Overflow", Severity::Warning)
+				//	<< "Change notification queue overflowed. Notifications were lost.";
+				RecoverLostChanges();
+				continue;
+			}
+
+			// The wait handle is signaled once per notification, but the whole queue is drained
+			// on each wake-up. Later wake-ups for notifications already handled find it empty.
+			Token token;
+			DWORD action;
+			std::wstring path;
+			while (m_readDirectoryChanges.Pop(token, action, path))
+			{
+				bool shouldCallOnChangeCallback = true;
+				auto fileAction = DirectoryMonitor::FileAction::Unknown;
+				switch (action)
+				{
+				default:
+					//Log("DirectoryMonitor.Notification.Unknown", Severity::Warning)
+					//	<< R"(Unknown notification for file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
+					break;
+				case FILE_ACTION_ADDED:
+					//Log("DirectoryMonitor.Notification.Add", Severity::Spam)
+					//	<< R"(Added file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
+					fileAction = DirectoryMonitor::FileAction::Added;
+					break;
+				case FILE_ACTION_REMOVED:
+					//Log("DirectoryMonitor.Notification.Remove", Severity::Spam)
+					//	<< R"(Removed file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
+					fileAction = DirectoryMonitor::FileAction::Removed;
+					break;
+				case FILE_ACTION_MODIFIED:
+					//Log("DirectoryMonitor.Notification.Modified", Severity::Spam)
+					//	<< R"(Modified file. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
+					fileAction = DirectoryMonitor::FileAction::Modified;
+					break;
+				case FILE_ACTION_RENAMED_OLD_NAME:
+					//Log("DirectoryMonitor.Notification.RenamedFrom", Severity::Spam)
+					//	<< R"(Renamed file. { "token": )" << token << R"(, "oldPath": ")" << path << R"(" })";
+					fileAction = DirectoryMonitor::FileAction::RenamedFrom;
+					break;
+				case FILE_ACTION_RENAMED_NEW_NAME:
+					//Log("DirectoryMonitor.Notification.RenamedTo", Severity::Spam)
+					//	<< R"(Renamed file. { "token": )" << token << R"(, "newPath": ")" << path << R"(" })";
+					fileAction = DirectoryMonitor::FileAction::RenamedTo;
+					break;
+				case FILE_ACTION_CHANGES_LOST:
+					//Log("DirectoryMonitor.Notification.EventsLost", Severity::Warning)
+					//	<< R"(Notifications lost. { "token": )" << token << R"(, "path": ")" << path << R"(" })";
+					RecoverLostChanges(token);
+					shouldCallOnChangeCallback = false;
+					break;
+				}
+
+				if (shouldCallOnChangeCallback)
+					QueueChange(token, std::filesystem::path(path), fileAction);
+			}
+		}
+
+		RunDueTasks();
+	}
+}
+
+DirectoryMonitor::DirectoryMonitor(const OnChangeCallback& onChangeCallback, const OnEventsLostCallback& onEventsLostCallback) :
+	m_onChangeCallback(onChangeCallback),
+	m_onEventsLostCallback(onEventsLostCallback)
+{
+}
+
+DirectoryMonitor::~DirectoryMonitor()
+{
+	//Log("DirectoryMonitor.ShutDown", Severity::Verbose) << "Stopping directory monitor.";
+	m_readDirectoryChanges.Terminate();
+
+	if (m_stopNotificationThread != INVALID_HANDLE_VALUE)
+	{
+		//Log("DirectoryMonitor.ShutDown.StoppingBackgroundThread", Severity::Spam)
+		//	<< R"(Shutting down notification handling thread. { "threadId": 0x)" << std::hex << m_notificationThread.get_id() << " }";
+		::SetEvent(m_stopNotificationThread);
+		m_notificationThread.join();
+		::CloseHandle(m_stopNotificationThread);
+	}
+
+	if (m_directoryTreeAdded != INVALID_HANDLE_VALUE)
+		::CloseHandle(m_directoryTreeAdded);
+}
+
+DirectoryMonitor::Token DirectoryMonitor::AddDirectory(const std::wstring& directory)
+{
+	Token token;
+	{
+		std::unique_lock<std::shared_mutex> lock(m_directoriesMutex);
+		auto iterator = m_directories.find(directory);
+		if (iterator != m_directories.end())
+			return iterator->second;
+
+		static Token nextToken = 0;
+		token = nextToken++;
+		m_directories[directory] = token;
+	}
+
+	//Log("DirectoryMonitor.AddDirectory", Severity::Info)
+	//	<< R"(Registering directory for change notifications. { "token": )" << token << R"(, "path": ")" << directory << R"(" })";
+
+	auto notificationFlags =
+		FILE_NOTIFY_CHANGE_LAST_WRITE
+		| FILE_NOTIFY_CHANGE_CREATION
+		| FILE_NOTIFY_CHANGE_FILE_NAME
+		| FILE_NOTIFY_CHANGE_DIR_NAME
+		| FILE_NOTIFY_CHANGE_SIZE;
+	m_readDirectoryChanges.AddDirectory(directory.c_str(), token, true /*bWatchSubtree*/, notificationFlags);
+
+	static std::once_flag flag;
+	std::call_once(flag, [this]()
+	{
+		//Log("DirectoryMonitor.StartingBackgroundThread", Severity::Spam)
+		//	<< "Attempting to start background thread for handling notifications.";
+
+		auto stopNotificationThread = ::CreateEvent(
+			nullptr /*lpEventAttributes*/,
+			true    /*manualReset*/,
+			false   /*bInitialState*/,
+			nullptr /*lpName*/);
+		if (stopNotificationThread == nullptr)
+		{
+			//Log("DirectoryMonitor.StartingBackgroundThread.CreateEventFailed", Severity::Error)
+			//	<< "Failed to create event to signal thread on exit.";
+			throw std::runtime_error("CreateEvent failed unexpectedly.");
+		}
+		m_stopNotificationThread = stopNotificationThread;
+
+		auto directoryTreeAdded = ::CreateEvent(
+			nullptr /*lpEventAttributes*/,
+			false   /*manualReset*/,
+			false   /*bInitialState*/,
+			nullptr /*lpName*/);
+		if (directoryTreeAdded == nullptr)
+		{
+			//Log("DirectoryMonitor.StartingBackgroundThread.CreateEventFailed", Severity::Error)
+			//	<< "Failed to create event to signal thread on added directory trees.";
+			throw std::runtime_error("CreateEvent failed unexpectedly.");
+		}
+		m_directoryTreeAdded = directoryTreeAdded;
+
+		m_notificationThread = std::thread(&DirectoryMonitor::WaitForNotifications, this);
+	});
+
+	// Scanned after the directory is watched, so changes made during the scan are still reported.
+	AddDirectoryTree(token, std::filesystem::path(directory));
+	::SetEvent(m_directoryTreeAdded);
+	return token;
+}
+
+#endif
@@ -1,73 +1,260 @@
-#pragma once
-#include <ReadDirectoryChanges.h>
-
-#include <filesystem>
-#include <functional>
-#include <shared_mutex>
-
-/**
- * Monitors directories for changes and provides notifications by callback.
- */
-class DirectoryMonitor
-{
-public:
-	/**
-	 * Action that triggered change notification.
-	 */
-	enum FileAction
-	{
-		Unknown,
-		Added,
-		Removed,
-		Modified,
-		RenamedFrom,
-		RenamedTo
-	};
-
-	/**
-	* Identifies AddDirectory call. Passed back with file change notifications.
-	*/
-	using Token = uint32_t;
-
-	/**
-	 * Callback for change notifications. Provides path and change action.
-	 */
-	using OnChangeCallback = std::function<void(Token, const std::filesystem::path&, FileAction)>;
-
-	/**
-	 * Callback for events lost notification. Notifications may be lost if changes
-	 * occur more rapidly than they are processed.
-	 */
-	using OnEventsLostCallback = std::function<void(void)>;
-
-private:
-	DirectoryMonitor(const DirectoryMonitor&) = delete;
-
-	HANDLE m_stopNotificationThread = INVALID_HANDLE_VALUE;
-	std::thread m_notificationThread;
-
-	OnChangeCallback m_onChangeCallback;
-	OnEventsLostCallback m_onEventsLostCallback;
-
-	CReadDirectoryChanges m_readDirectoryChanges;
-
-	std::unordered_map<std::wstring, Token> m_directories;
-	std::shared_mutex m_directoriesMutex;
-
-	void WaitForNotifications();
-
-public:
-	/**
-	 * Constructor. Callbacks will always be invoked on the same thread.
-	 * @param onChangeCallback Callback for change notification.
-	 * @param onEventsLostCallback Callback for lost events notification.
-	 */
-	DirectoryMonitor(const OnChangeCallback& onChangeCallback, const OnEventsLostCallback& onEventsLostCallback);
-	~DirectoryMonitor();
-
-	/**
-	 * Registers a directory for change notifications.
-	 * This method is thread-safe.
-	 */
-	Token AddDirectory(const std::wstring& directory);
+#pragma once
+#include "DirectoryTree.h"
+#ifdef _WIN32
+#include <ReadDirectoryChanges.h>
+#endif
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <shared_mutex>
+
+/**
+ * Monitors directories for changes and provides notifications by callback.
+ * Uses ReadDirectoryChangesW on Windows. On Linux, uses fanotify filesystem marks
+ * when privileges allow it, and inotify otherwise.
+ */
+class DirectoryMonitor
+{
+public:
+	/**
+	 * Action that triggered change notification. Unknown is also used for directories found
+	 * to have changed after notifications were lost, where the changed files aren't known.
+	 */
+	enum FileAction
+	{
+		Unknown,
+		Added,
+		Removed,
+		Modified,
+		RenamedFrom,
+		RenamedTo
+	};
+
+	/**
+	* Identifies AddDirectory call. Passed back with file change notifications.
+	*/
+	using Token = uint32_t;
+
+	/**
+	 * Change to a file or directory beneath a registered directory.
+	 */
+	struct FileChange
+	{
+		std::filesystem::path Path;
+		FileAction Action;
+	};
+
+	/**
+	 * Changes beneath the registered directory identified by token.
+	 */
+	struct DirectoryChanges
+	{
+		Token DirectoryToken;
+		std::vector<FileChange> Changes;
+	};
+
+	/**
+	 * Callback for change notifications. Provides the changes made since the previous notification
+	 * to every directory that changed, so that directories belonging together can be handled as one.
+	 * Each directory's changes are its distinct changed paths, in the order they first changed.
+	 */
+	using OnChangeCallback = std::function<void(const std::vector<DirectoryChanges>&)>;
+
+	/**
+	 * Callback for events lost notification. Notifications may be lost if changes
+	 * occur more rapidly than they are processed. Changes made while notifications were
+	 * lost are found by rescanning the affected directories, and are delivered through the
+	 * change callback before this callback is invoked.
+	 */
+	using OnEventsLostCallback = std::function<void(void)>;
+
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+
+	DirectoryMonitor(const DirectoryMonitor&) = delete;
+
+	std::thread m_notificationThread;
+
+	OnChangeCallback m_onChangeCallback;
+	OnEventsLostCallback m_onEventsLostCallback;
+
+	std::unordered_map<std::wstring, Token> m_directories;
+	std::shared_mutex m_directoriesMutex;
+
+	/**
+	* Changes waiting to be delivered for a registered directory. Only accessed on the
+	* notification thread.
+	*/
+	struct PendingChanges
+	{
+		std::vector<FileChange> Changes;
+		std::unordered_map<std::filesystem::path::string_type, size_t> ChangeIndices;
+	};
+
+	std::unordered_map<Token, PendingChanges> m_pendingChanges;
+	std::chrono::steady_clock::time_point m_deliveryDeadline;
+
+	// Directory trees of registered directories, used to recover lost changes. Trees are handed
+	// to the notification thread, which owns them and scans them one at a time between handling
+	// notifications, so registering a directory doesn't wait for its scan.
+	std::vector<std::pair<Token, DirectoryTree>> m_addedDirectoryTrees;
+	std::mutex m_addedDirectoryTreesMutex;
+	std::unordered_map<Token, DirectoryTree> m_directoryTrees;
+	std::deque<Token> m_directoryTreesToScan;
+	bool m_isRefreshScheduled = false;
+	std::chrono::steady_clock::time_point m_refreshDeadline;
+
+	/**
+	* Queues a change for delivery. Repeated changes to the same path are delivered once,
+	* with the latest action other than Modified.
+	*/
+	void QueueChange(Token token, const std::filesystem::path& path, FileAction action);
+
+	/**
+	* Invokes the change callback once with the queued changes of every directory.
+	*/
+	void DeliverChanges();
+
+	/**
+	* Hands the tree of a newly registered directory to the notification thread to be scanned.
+	* The notification thread must be woken to take it.
+	*/
+	void AddDirectoryTree(Token token, const std::filesystem::path& directory);
+
+	/**
+	* Takes ownership of trees of newly registered directories.
+	*/
+	void TakeAddedDirectoryTrees();
+
+	/**
+	* Rescans the tree of provided directory, or of all directories, and queues changes for the
+	* directories that differ from it. Then invokes the events lost callback.
+	*/
+	void RecoverLostChanges(Token token);
+	void RecoverLostChanges();
+
+	/**
+	* Queues changes found by rescanning a directory tree. Trees that weren't scanned yet queue
+	* an unknown change to their root instead, since any of their files may have changed.
+	*/
+	void QueueRecoveredChanges(Token token, DirectoryTree& directoryTree);
+
+	/**
+	* Retrieves milliseconds until changes are due for delivery, directory trees are due for
+	* scanning or directory trees are due for refresh. Fails if none is scheduled.
+	*/
+	bool GetMillisecondsUntilNextTask(uint32_t& milliseconds) const;
+
+	/**
+	* Delivers queued changes, then scans a newly added directory tree, then refreshes directory
+	* trees, doing the first of these that is due. Trees are only scanned or refreshed once queued
+	* changes are delivered.
+	*/
+	void RunDueTasks();
+
+#ifdef _WIN32
+	HANDLE m_stopNotificationThread = INVALID_HANDLE_VALUE;
+	HANDLE m_directoryTreeAdded = INVALID_HANDLE_VALUE;
+	CReadDirectoryChanges m_readDirectoryChanges;
+#else
+	/**
+	* Directory watched by an inotify watch descriptor. inotify doesn't watch subtrees, so
+	* each registered directory has a watch for every directory beneath it.
+	*/
+	struct WatchedDirectory
+	{
+		Token DirectoryToken;
+		std::filesystem::path Path;
+	};
+
+	/**
+	* Directory registered for notifications from a fanotify filesystem mark.
+	*/
+	struct MarkedDirectory
+	{
+		Token DirectoryToken;
+
+		/**
+		* Canonical path with a trailing slash, matching the paths resolved from file handles.
+		*/
+		std::string Path;
+
+		/**
+		* Path the directory was registered with. Changes are reported beneath it.
+		*/
+		std::filesystem::path RegisteredPath;
+	};
+
+	int m_inotify = -1;
+	int m_fanotify = -1;
+	int m_stopNotificationThread = -1;
+	int m_directoryTreeAdded = -1;
+
+	// inotify returns the same watch descriptor for every watch of a directory, so directories
+	// beneath several registered directories have one entry per registered directory.
+	std::unordered_map<int, std::vector<WatchedDirectory>> m_watches;
+	std::mutex m_watchesMutex;
+
+	// Marked filesystems by fsid, each with a descriptor used to open the file handles
+	// reported by its events. Marked directories are ordered from longest to shortest path.
+	std::unordered_map<uint64_t, int> m_markedFilesystems;
+	std::vector<MarkedDirectory> m_markedDirectories;
+	std::unordered_map<std::string, std::filesystem::path> m_directoryHandles;
+	std::mutex m_marksMutex;
+
+	/**
+	* Adds watches for directory and every directory beneath it.
+	*/
+	void AddWatches(Token token, const std::filesystem::path& directory);
+
+	/**
+	* Removes provided token's watches for directory and every directory beneath it. Used when
+	* a directory is moved, since its watches would otherwise report paths under its old name.
+	* Watch descriptors are only removed once no registered directory uses them.
+	*/
+	void RemoveWatches(Token token, const std::filesystem::path& directory);
+
+	/**
+	* Reads every queued inotify event and invokes callbacks for them.
+	*/
+	void ReadNotifications();
+
+	/**
+	* Marks the filesystem containing directory, unless it is already marked, and routes its
+	* events beneath directory to provided token. A filesystem needs a single mark however many
+	* directories it holds. Fails if fanotify is unavailable or can't mark the filesystem.
+	*/
+	bool AddFilesystemMark(Token token, const std::filesystem::path& directory);
+
+	/**
+	* Retrieves the path of a directory from the file handle reported by a fanotify event.
+	* Fails if the directory no longer exists.
+	*/
+	bool ResolveDirectoryHandle(uint64_t fsid, const void* fileHandle, std::filesystem::path& directory);
+
+	/**
+	* Reads every queued fanotify event and invokes callbacks for those beneath registered
+	* directories.
+	*/
+	void ReadFilesystemNotifications();
+#endif
+
+	void WaitForNotifications();
+
+public:
+	/**
+	 * Constructor. Callbacks will always be invoked on the same thread.
+	 * @param onChangeCallback Callback for change notification.
+	 * @param onEventsLostCallback Callback for lost events notification.
+	 */
+	DirectoryMonitor(const OnChangeCallback& onChangeCallback, const OnEventsLostCallback& onEventsLostCallback);
+	~DirectoryMonitor();
+
+	/**
+	 * Registers a directory for change notifications.
+	 * This method is thread-safe.
+	 */
+	Token AddDirectory(const std::wstring& directory);
 };
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include "stdafx.h"
+#include "DirectoryMonitor.h"
+
+#ifdef __linux__
+
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+namespace
+{
+	const uint32_t WatchMask =
+		IN_CREATE
+		| IN_DELETE
+		| IN_MODIFY
+		| IN_ATTRIB
+		| IN_CLOSE_WRITE
+		| IN_MOVED_FROM
+		| IN_MOVED_TO
+		| IN_ONLYDIR
+		| IN_EXCL_UNLINK;
+
+	const uint64_t FilesystemMarkMask =
+		FAN_CREATE
+		| FAN_DELETE
+		| FAN_MODIFY
+		| FAN_ATTRIB
+		| FAN_CLOSE_WRITE
+		| FAN_MOVED_FROM
+		| FAN_MOVED_TO
+		| FAN_ONDIR;
+
+	/**
+	* Size of the buffer events are read into. Each read returns as many queued events as fit.
+	*/
+	const size_t EventBufferSize = 64 * 1024;
+
+	/**
+	* Bounds the directory paths remembered for file handles reported by fanotify events.
+	*/
+	const size_t MaxDirectoryHandles = 4096;
+
+	uint64_t GetFsid(const int (&fsid)[2])
+	{
+		return static_cast<uint32_t>(fsid[0]) | (static_cast<uint64_t>(static_cast<uint32_t>(fsid[1])) << 32);
+	}
+
+	/**
+	* Checks if directory can be opened from its file handle, which is how fanotify events
+	* identify directories. Opening file handles needs CAP_DAC_READ_SEARCH. Without it, marks
+	* are still added but no event can be resolved to a path.
+	*/
+	bool CanOpenByHandle(int filesystemDescriptor, const std::filesystem::path& directory)
+	{
+		alignas(file_handle) char buffer[sizeof(file_handle) + MAX_HANDLE_SZ];
+		auto handle = reinterpret_cast<file_handle*>(buffer);
+		handle->handle_bytes = MAX_HANDLE_SZ;
+		int mountId;
+		if (::name_to_handle_at(AT_FDCWD, directory.c_str(), handle, &mountId, 0) != 0)
+			return false;
+
+		auto directoryDescriptor = ::open_by_handle_at(filesystemDescriptor, handle, O_PATH | O_CLOEXEC);
+		if (directoryDescriptor == -1)
+			return false;
+
+		::close(directoryDescriptor);
+		return true;
+	}
+}
+
+void DirectoryMonitor::AddWatches(Token token, const std::filesystem::path& directory)
+{
+	std::vector<std::filesystem::path> directories = { directory };
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator entry(directory, error), end; !error && entry != end; entry.increment(error))
+	{
+		if (entry->is_directory(error) && !entry->is_symlink(error))
+			directories.push_back(entry->path());
+	}
+
+	LockGuard lock(m_watchesMutex);
+	for (const auto& watchedDirectory : directories)
+	{
+		auto watch = ::inotify_add_watch(m_inotify, watchedDirectory.c_str(), WatchMask);
+		if (watch == -1)
+		{
+			//Log("DirectoryMonitor.AddWatches.Failed", Severity::Warning)
+			//	<< R"(Failed to watch directory. Changes beneath it won't be reported. { "token": )" << token
+			//	<< R"(, "path": ")" << watchedDirectory.c_str() << R"(", "errno": )" << errno << " }";
+			continue;
+		}
+
+		auto& watchedDirectories = m_watches[watch];
+		auto isWatched = std::any_of(
+			watchedDirectories.begin(),
+			watchedDirectories.end(),
+			[token, &watchedDirectory](const WatchedDirectory& other) { return other.DirectoryToken == token && other.Path == watchedDirectory; });
+		if (!isWatched)
+			watchedDirectories.push_back({ token, watchedDirectory });
+	}
+}
+
+void DirectoryMonitor::RemoveWatches(Token token, const std::filesystem::path& directory)
+{
+	auto prefix = directory.native() + "/";
+	auto isRemoved = [token, &directory, &prefix](const WatchedDirectory& watchedDirectory)
+	{
+		const auto& path = watchedDirectory.Path.native();
+		return watchedDirectory.DirectoryToken == token
+			&& (path == directory.native() || path.compare(0, prefix.size(), prefix) == 0);
+	};
+
+	LockGuard lock(m_watchesMutex);
+	for (auto watch = m_watches.begin(); watch != m_watches.end();)
+	{
+		auto& watchedDirectories = watch->second;
+		watchedDirectories.erase(
+			std::remove_if(watchedDirectories.begin(), watchedDirectories.end(), isRemoved),
+			watchedDirectories.end());
+		if (watchedDirectories.empty())
+		{
+			::inotify_rm_watch(m_inotify, watch->first);
+			watch = m_watches.erase(watch);
+		}
+		else
+		{
+			++watch;
+		}
+	}
+}
+
+void DirectoryMonitor::ReadNotifications()
+{
+	alignas(inotify_event) char buffer[EventBufferSize];
+	while (true)
+	{
+		auto length = ::read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			return;
+
+		for (auto position = buffer; position < buffer + length;)
+		{
+			const auto& event = *reinterpret_cast<const inotify_event*>(position);
+			position += sizeof(inotify_event) + event.len;
+
+			if ((event.mask & IN_Q_OVERFLOW) != 0)
+			{
+				//Log("DirectoryMonitor.Notification.Overflow", Severity::Warning)
+				//	<< "Change notification queue overflowed. Notifications were lost.";
+				RecoverLostChanges();
+				continue;
+			}
+
+			std::vector<WatchedDirectory> watchedDirectories;
+			{
+				LockGuard lock(m_watchesMutex);
+				auto watch = m_watches.find(event.wd);
+				if (watch == m_watches.end())
+					continue;
+
+				// Watches are removed automatically when their directory is deleted.
+				if ((event.mask & IN_IGNORED) != 0)
+				{
+					m_watches.erase(watch);
+					continue;
+				}
+				watchedDirectories = watch->second;
+			}
+
+			auto fileAction = DirectoryMonitor::FileAction::Unknown;
+			if ((event.mask & IN_CREATE) != 0)
+				fileAction = DirectoryMonitor::FileAction::Added;
+			else if ((event.mask & IN_DELETE) != 0)
+				fileAction = DirectoryMonitor::FileAction::Removed;
+			else if ((event.mask & IN_MOVED_FROM) != 0)
+				fileAction = DirectoryMonitor::FileAction::RenamedFrom;
+			else if ((event.mask & IN_MOVED_TO) != 0)
+				fileAction = DirectoryMonitor::FileAction::RenamedTo;
+			else if ((event.mask & (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE)) != 0)
+				fileAction = DirectoryMonitor::FileAction::Modified;
+			else
+				continue;
+
+			// Directories beneath nested registered directories are reported to each of them.
+			auto isDirectory = (event.mask & IN_ISDIR) != 0;
+			for (const auto& watchedDirectory : watchedDirectories)
+			{
+				auto token = watchedDirectory.DirectoryToken;
+				auto path = event.len != 0 ? watchedDirectory.Path / event.name : watchedDirectory.Path;
+
+				//Log("DirectoryMonitor.Notification", Severity::Spam)
+				//	<< R"(File changed. { "token": )" << token << R"(, "path": ")" << path.c_str()
+				//	<< R"(", "action": )" << fileAction << " }";
+
+				// New directories are watched as they appear. Anything created inside them before
+				// the watch was added is covered by the notification for the directory itself.
+				if (isDirectory && fileAction == DirectoryMonitor::FileAction::RenamedFrom)
+					RemoveWatches(token, path);
+				if (isDirectory && (fileAction == DirectoryMonitor::FileAction::Added || fileAction == DirectoryMonitor::FileAction::RenamedTo))
+					AddWatches(token, path);
+
+				QueueChange(token, path, fileAction);
+			}
+		}
+	}
+}
+
+bool DirectoryMonitor::AddFilesystemMark(Token token, const std::filesystem::path& directory)
+{
+	if (m_fanotify == -1)
+		return false;
+
+	struct statfs filesystem;
+	if (::statfs(directory.c_str(), &filesystem) != 0)
+		return false;
+
+	int fsid[2];
+	std::memcpy(fsid, &filesystem.f_fsid, sizeof(fsid));
+
+	LockGuard lock(m_marksMutex);
+	auto markedFilesystem = m_markedFilesystems.find(GetFsid(fsid));
+	auto isMarked = markedFilesystem != m_markedFilesystems.end();
+	auto filesystemDescriptor = isMarked
+		? markedFilesystem->second
+		: ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (filesystemDescriptor == -1)
+		return false;
+
+	if (!CanOpenByHandle(filesystemDescriptor, directory))
+	{
+		//Log("DirectoryMonitor.AddFilesystemMark.FileHandlesUnavailable", Severity::Info)
+		//	<< R"(Failed to open directory by file handle. Falling back to inotify. { "path": ")" << directory.c_str()
+		//	<< R"(", "errno": )" << errno << " }";
+		if (!isMarked)
+			::close(filesystemDescriptor);
+		return false;
+	}
+
+	if (!isMarked)
+	{
+		// Filesystems without stable file handles can't be marked, and are watched with inotify.
+		if (::fanotify_mark(m_fanotify, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FilesystemMarkMask, AT_FDCWD, directory.c_str()) != 0)
+		{
+			//Log("DirectoryMonitor.AddFilesystemMark.Failed", Severity::Info)
+			//	<< R"(Failed to mark filesystem. Falling back to inotify. { "path": ")" << directory.c_str()
+			//	<< R"(", "errno": )" << errno << " }";
+			::close(filesystemDescriptor);
+			return false;
+		}
+		m_markedFilesystems[GetFsid(fsid)] = filesystemDescriptor;
+	}
+
+	// Paths resolved from file handles have symbolic links resolved, so they're matched
+	// against the canonical path of directories registered through a link.
+	std::error_code error;
+	auto canonicalDirectory = std::filesystem::canonical(directory, error);
+	MarkedDirectory markedDirectory{ token, error ? directory.native() : canonicalDirectory.native(), directory };
+	if (markedDirectory.Path.back() != '/')
+		markedDirectory.Path += '/';
+	auto position = std::find_if(
+		m_markedDirectories.begin(),
+		m_markedDirectories.end(),
+		[&markedDirectory](const MarkedDirectory& other) { return other.Path.size() < markedDirectory.Path.size(); });
+	m_markedDirectories.insert(position, std::move(markedDirectory));
+	return true;
+}
+
+bool DirectoryMonitor::ResolveDirectoryHandle(uint64_t fsid, const void* fileHandle, std::filesystem::path& directory)
+{
+	auto handle = static_cast<const file_handle*>(fileHandle);
+	std::string key(reinterpret_cast<const char*>(&fsid), sizeof(fsid));
+	key.append(reinterpret_cast<const char*>(handle), sizeof(file_handle) + handle->handle_bytes);
+
+	int filesystemDescriptor;
+	{
+		LockGuard lock(m_marksMutex);
+		auto directoryHandle = m_directoryHandles.find(key);
+		if (directoryHandle != m_directoryHandles.end())
+		{
+			directory = directoryHandle->second;
+			return true;
+		}
+
+		auto markedFilesystem = m_markedFilesystems.find(fsid);
+		if (markedFilesystem == m_markedFilesystems.end())
+			return false;
+		filesystemDescriptor = markedFilesystem->second;
+	}
+
+	auto directoryDescriptor = ::open_by_handle_at(filesystemDescriptor, const_cast<file_handle*>(handle), O_PATH | O_CLOEXEC);
+	if (directoryDescriptor == -1)
+		return false;
+
+	std::error_code error;
+	directory = std::filesystem::read_symlink("/proc/self/fd/" + std::to_string(directoryDescriptor), error);
+	::close(directoryDescriptor);
+	if (error)
+		return false;
+
+	LockGuard lock(m_marksMutex);
+	if (m_directoryHandles.size() >= MaxDirectoryHandles)
+		m_directoryHandles.clear();
+	m_directoryHandles[key] = directory;
+	return true;
+}
+
+void DirectoryMonitor::ReadFilesystemNotifications()
+{
+	alignas(fanotify_event_metadata) char buffer[EventBufferSize];
+	while (true)
+	{
+		auto length = ::read(m_fanotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			return;
+
+		auto metadata = reinterpret_cast<const fanotify_event_metadata*>(buffer);
+		for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length))
+		{
+			if ((metadata->mask & FAN_Q_OVERFLOW) != 0)
+			{
+				//Log("DirectoryMonitor.Notification.Overflow", Severity::Warning)
+				//	<< "Change notification queue overflowed. Notifications were lost.";
+				RecoverLostChanges();
+				continue;
+			}
+
+			auto info = reinterpret_cast<const fanotify_event_info_fid*>(metadata + 1);
+			if (metadata->event_len < sizeof(fanotify_event_metadata) + sizeof(fanotify_event_info_fid)
+				|| (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME && info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID))
+			{
+				continue;
+			}
+
+			auto handle = reinterpret_cast<const file_handle*>(info->handle);
+			std::filesystem::path path;
+			if (!ResolveDirectoryHandle(GetFsid(info->fsid.val), handle, path))
+				continue;
+			if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+			{
+				auto name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+				if (std::strcmp(name, ".") != 0)
+					path /= name;
+			}
+
+			// Marks cover whole filesystems, so most events are for unrelated directories. Paths beneath
+			// nested registered directories are reported to each of them.
+			std::vector<std::pair<Token, std::filesystem::path>> changes;
+			{
+				LockGuard lock(m_marksMutex);
+				const auto& pathString = path.native();
+				for (const auto& markedDirectory : m_markedDirectories)
+				{
+					if (pathString.compare(0, markedDirectory.Path.size(), markedDirectory.Path) == 0)
+						changes.emplace_back(markedDirectory.DirectoryToken, markedDirectory.RegisteredPath / pathString.substr(markedDirectory.Path.size()));
+				}
+				if (changes.empty())
+					continue;
+
+				// Moving or deleting a directory changes the paths of handles beneath it.
+				if ((metadata->mask & FAN_ONDIR) != 0 && (metadata->mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE)) != 0)
+					m_directoryHandles.clear();
+			}
+
+			auto fileAction = DirectoryMonitor::FileAction::Unknown;
+			if ((metadata->mask & FAN_CREATE) != 0)
+				fileAction = DirectoryMonitor::FileAction::Added;
+			else if ((metadata->mask & FAN_DELETE) != 0)
+				fileAction = DirectoryMonitor::FileAction::Removed;
+			else if ((metadata->mask & FAN_MOVED_FROM) != 0)
+				fileAction = DirectoryMonitor::FileAction::RenamedFrom;
+			else if ((metadata->mask & FAN_MOVED_TO) != 0)
+				fileAction = DirectoryMonitor::FileAction::RenamedTo;
+			else if ((metadata->mask & (FAN_MODIFY | FAN_ATTRIB | FAN_CLOSE_WRITE)) != 0)
+				fileAction = DirectoryMonitor::FileAction::Modified;
+
+			for (const auto& change : changes)
+			{
+				//Log("DirectoryMonitor.Notification", Severity::Spam)
+				//	<< R"(File changed. { "token": )" << change.first << R"(, "path": ")" << change.second.c_str()
+				//	<< R"(", "action": )" << fileAction << " }";
+				QueueChange(change.first, change.second, fileAction);
+			}
+		}
+	}
+}
+
+void DirectoryMonitor::WaitForNotifications()
+{
+	//Log("DirectoryMonitor.WaitForNotifications.Start", Severity::Verbose) << "Thread for handling notifications started.";
+
+	// Negative descriptors are skipped by poll, which covers fanotify being unavailable.
+	pollfd descriptors[] = {
+		{ m_stopNotificationThread, POLLIN, 0 },
+		{ m_inotify, POLLIN, 0 },
+		{ m_fanotify, POLLIN, 0 },
+		{ m_directoryTreeAdded, POLLIN, 0 }
+	};
+
+	bool shouldTerminate = false;
+	while (!shouldTerminate)
+	{
+		uint32_t milliseconds;
+		auto timeout = GetMillisecondsUntilNextTask(milliseconds) ? static_cast<int>(milliseconds) : -1;
+		if (::poll(descriptors, 4, timeout) == -1)
+			continue;
+
+		if ((descriptors[0].revents & POLLIN) != 0)
+		{
+			shouldTerminate = true;
+			//Log("DirectoryMonitor.WaitForNotifications.Stop", Severity::Verbose) << "Thread for handling notifications stopping.";
+			continue;
+		}
+
+		if ((descriptors[1].revents & POLLIN) != 0)
+			ReadNotifications();
+		if ((descriptors[2].revents & POLLIN) != 0)
+			ReadFilesystemNotifications();
+
+		// The directory tree eventfd only wakes the thread, so that added trees are taken and scanned.
+		uint64_t value;
+		if ((descriptors[3].revents & POLLIN) != 0)
+			::read(m_directoryTreeAdded, &value, sizeof(value));
+
+		RunDueTasks();
+	}
+}
+
+DirectoryMonitor::DirectoryMonitor(const OnChangeCallback& onChangeCallback, const OnEventsLostCallback& onEventsLostCallback) :
+	m_onChangeCallback(onChangeCallback),
+	m_onEventsLostCallback(onEventsLostCallback)
+{
+}
+
+DirectoryMonitor::~DirectoryMonitor()
+{
+	//Log("DirectoryMonitor.ShutDown", Severity::Verbose) << "Stopping directory monitor.";
+	if (m_stopNotificationThread != -1)
+	{
+		//Log("DirectoryMonitor.ShutDown.StoppingBackgroundThread", Severity::Spam)
+		//	<< R"(Shutting down notification handling thread. { "threadId": 0x)" << std::hex << m_notificationThread.get_id() << " }";
+		uint64_t value = 1;
+		::write(m_stopNotificationThread, &value, sizeof(value));
+		m_notificationThread.join();
+		::close(m_stopNotificationThread);
+	}
+
+	if (m_directoryTreeAdded != -1)
+		::close(m_directoryTreeAdded);
+	if (m_inotify != -1)
+		::close(m_inotify);
+	if (m_fanotify != -1)
+		::close(m_fanotify);
+	for (const auto& markedFilesystem : m_markedFilesystems)
+		::close(markedFilesystem.second);
+}
+
+DirectoryMonitor::Token DirectoryMonitor::AddDirectory(const std::wstring& directory)
+{
+	Token token;
+	{
+		std::unique_lock<std::shared_mutex> lock(m_directoriesMutex);
+		auto iterator = m_directories.find(directory);
+		if (iterator != m_directories.end())
+			return iterator->second;
+
+		static Token nextToken = 0;
+		token = nextToken++;
+		m_directories[directory] = token;
+	}
+
+	//Log("DirectoryMonitor.AddDirectory", Severity::Info)
+	//	<< R"(Registering directory for change notifications. { "token": )" << token << R"(, "path": ")" << directory << R"(" })";
+
+	static std::once_flag flag;
+	std::call_once(flag, [this]()
+	{
+		//Log("DirectoryMonitor.StartingBackgroundThread", Severity::Spam)
+		//	<< "Attempting to start background thread for handling notifications.";
+
+		m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify == -1)
+		{
+			//Log("DirectoryMonitor.StartingBackgroundThread.InotifyInitFailed", Severity::Error)
+			//	<< "Failed to create inotify instance.";
+			throw std::runtime_error("inotify_init1 failed unexpectedly.");
+		}
+
+		// Filesystem marks need CAP_SYS_ADMIN, and resolving their events needs CAP_DAC_READ_SEARCH.
+		// Without them, directories are watched with inotify.
+		m_fanotify = ::fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY | O_LARGEFILE);
+		//if (m_fanotify == -1)
+		//	Log("DirectoryMonitor.StartingBackgroundThread.FanotifyUnavailable", Severity::Info)
+		//		<< R"(Filesystem marks unavailable. Watching directories with inotify. { "errno": )" << errno << " }";
+
+		m_stopNotificationThread = ::eventfd(0, EFD_CLOEXEC);
+		if (m_stopNotificationThread == -1)
+		{
+			//Log("DirectoryMonitor.StartingBackgroundThread.EventFdFailed", Severity::Error)
+			//	<< "Failed to create event to signal thread on exit.";
+			throw std::runtime_error("eventfd failed unexpectedly.");
+		}
+
+		m_directoryTreeAdded = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (m_directoryTreeAdded == -1)
+		{
+			//Log("DirectoryMonitor.StartingBackgroundThread.EventFdFailed", Severity::Error)
+			//	<< "Failed to create event to signal thread on added directory trees.";
+			throw std::runtime_error("eventfd failed unexpectedly.");
+		}
+
+		m_notificationThread = std::thread(&DirectoryMonitor::WaitForNotifications, this);
+	});
+
+	auto path = std::filesystem::path(directory);
+	if (!AddFilesystemMark(token, path))
+		AddWatches(token, path);
+
+	// Scanned after the directory is watched, so changes made during the scan are still reported.
+	AddDirectoryTree(token, path);
+	uint64_t value = 1;
+	::write(m_directoryTreeAdded, &value, sizeof(value));
+	return token;
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include "stdafx.h"
+#include "DirectoryTree.h"
+
+DirectoryTree::DirectoryTree(const std::filesystem::path& root)
+	: m_root(root)
+{
+}
+
+/*static*/ uint64_t DirectoryTree::Combine(uint64_t seed, uint64_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+/*static*/ DirectoryTree::Key DirectoryTree::GetChildKey(const Key& directory, const Key& name)
+{
+	return directory.empty() ? name : (std::filesystem::path(directory) / name).native();
+}
+
+const std::filesystem::path& DirectoryTree::GetRoot() const
+{
+	return m_root;
+}
+
+void DirectoryTree::ReadDirectory(const Key& directory, Node& node) const
+{
+	auto path = directory.empty() ? m_root : m_root / directory;
+	node = Node();
+
+	std::error_code error;
+	node.ModifiedTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+	// Entries are listed in no particular order, so file hashes are summed rather than combined.
+	std::filesystem::directory_iterator end;
+	for (std::filesystem::directory_iterator entry(path, error); !error && entry != end; entry.increment(error))
+	{
+		std::error_code entryError;
+		auto name = entry->path().filename().native();
+		if (entry->is_directory(entryError) && !entry->is_symlink(entryError))
+		{
+			node.Children.push_back(std::move(name));
+			continue;
+		}
+
+		auto size = entry->file_size(entryError);
+		auto fileHash = Combine(std::hash<Key>()(name), entryError ? 0 : size);
+		auto modifiedTime = entry->last_write_time(entryError);
+		fileHash = Combine(fileHash, entryError ? 0 : modifiedTime.time_since_epoch().count());
+		node.FilesDigest += fileHash;
+	}
+
+	std::sort(node.Children.begin(), node.Children.end());
+}
+
+void DirectoryTree::ScanDirectory(const Key& directory, std::unordered_map<Key, Node>& nodes) const
+{
+	Node node;
+	ReadDirectory(directory, node);
+	for (const auto& child : node.Children)
+		ScanDirectory(GetChildKey(directory, child), nodes);
+
+	node.Summary = ComputeSummary(directory, node, nodes);
+	nodes[directory] = std::move(node);
+}
+
+/*static*/ uint64_t DirectoryTree::ComputeSummary(const Key& directory, const Node& node, const std::unordered_map<Key, Node>& nodes)
+{
+	auto summary = Combine(static_cast<uint64_t>(node.ModifiedTime), node.FilesDigest);
+	for (const auto& child : node.Children)
+	{
+		summary = Combine(summary, std::hash<Key>()(child));
+		auto childNode = nodes.find(GetChildKey(directory, child));
+		if (childNode != nodes.end())
+			summary = Combine(summary, childNode->second.Summary);
+	}
+	return summary;
+}
+
+void DirectoryTree::EraseDirectory(const Key& directory)
+{
+	auto node = m_nodes.find(directory);
+	if (node == m_nodes.end())
+		return;
+
+	auto children = std::move(node->second.Children);
+	m_nodes.erase(node);
+	for (const auto& child : children)
+		EraseDirectory(GetChildKey(directory, child));
+}
+
+void DirectoryTree::Scan()
+{
+	m_nodes.clear();
+	m_changedDirectories.clear();
+	m_refreshedDirectories.clear();
+	ScanDirectory(Key(), m_nodes);
+}
+
+bool DirectoryTree::IsScanned() const
+{
+	// Scans always record the root, even if it can't be read.
+	return !m_nodes.empty();
+}
+
+void DirectoryTree::MarkChanged(const std::filesystem::path& path)
+{
+	auto relativePath = path.lexically_relative(m_root);
+	if (relativePath.empty() || *relativePath.begin() == L"..")
+		return;
+
+	m_changedDirectories.insert(relativePath.parent_path().native());
+}
+
+bool DirectoryTree::HasChangedDirectories() const
+{
+	return !m_changedDirectories.empty();
+}
+
+void DirectoryTree::Refresh()
+{
+	// Ancestors have shorter paths, so reading the longest paths first means each summary is
+	// recomputed after those of any changed directories beneath it.
+	std::vector<Key> changedDirectories(m_changedDirectories.begin(), m_changedDirectories.end());
+	m_changedDirectories.clear();
+	std::sort(
+		changedDirectories.begin(),
+		changedDirectories.end(),
+		[](const Key& lhs, const Key& rhs) { return lhs.size() > rhs.size(); });
+
+	for (const auto& directory : changedDirectories)
+	{
+		// Directories missing from the tree are new, and are scanned when their parent is read.
+		auto node = m_nodes.find(directory);
+		if (node == m_nodes.end())
+			continue;
+
+		Node updatedNode;
+		ReadDirectory(directory, updatedNode);
+		m_refreshedDirectories.insert(directory);
+
+		// References to nodes stay valid as others are added and removed.
+		auto& currentNode = node->second;
+		for (const auto& child : currentNode.Children)
+		{
+			if (!std::binary_search(updatedNode.Children.begin(), updatedNode.Children.end(), child))
+				EraseDirectory(GetChildKey(directory, child));
+		}
+		for (const auto& child : updatedNode.Children)
+		{
+			if (!std::binary_search(currentNode.Children.begin(), currentNode.Children.end(), child))
+				ScanDirectory(GetChildKey(directory, child), m_nodes);
+		}
+
+		currentNode.ModifiedTime = updatedNode.ModifiedTime;
+		currentNode.FilesDigest = updatedNode.FilesDigest;
+		currentNode.Children = std::move(updatedNode.Children);
+
+		for (auto ancestor = directory; ; ancestor = std::filesystem::path(ancestor).parent_path().native())
+		{
+			auto ancestorNode = m_nodes.find(ancestor);
+			if (ancestorNode != m_nodes.end())
+				ancestorNode->second.Summary = ComputeSummary(ancestor, ancestorNode->second, m_nodes);
+			if (ancestor.empty())
+				break;
+		}
+	}
+}
+
+void DirectoryTree::Compare(const Key& directory, const std::unordered_map<Key, Node>& nodes, std::vector<Change>& changes) const
+{
+	auto previousNode = m_nodes.find(directory);
+	auto currentNode = nodes.find(directory);
+	if (previousNode == m_nodes.end() || currentNode == nodes.end())
+		return;
+
+	const auto& previous = previousNode->second;
+	const auto& current = currentNode->second;
+	if (previous.Summary == current.Summary)
+		return;
+
+	auto path = directory.empty() ? m_root : m_root / directory;
+	if (previous.ModifiedTime != current.ModifiedTime || previous.FilesDigest != current.FilesDigest)
+		changes.push_back({ path, ChangeKind::Changed });
+
+	// Children are sorted, so added and removed directories are found by merging.
+	auto previousChild = previous.Children.begin();
+	auto currentChild = current.Children.begin();
+	while (previousChild != previous.Children.end() || currentChild != current.Children.end())
+	{
+		if (currentChild == current.Children.end() || (previousChild != previous.Children.end() && *previousChild < *currentChild))
+		{
+			changes.push_back({ path / *previousChild, ChangeKind::Removed });
+			++previousChild;
+		}
+		else if (previousChild == previous.Children.end() || *currentChild < *previousChild)
+		{
+			changes.push_back({ path / *currentChild, ChangeKind::Added });
+			++currentChild;
+		}
+		else
+		{
+			Compare(GetChildKey(directory, *currentChild), nodes, changes);
+			++previousChild;
+			++currentChild;
+		}
+	}
+}
+
+void DirectoryTree::ClearRefreshedDirectories()
+{
+	m_refreshedDirectories.clear();
+}
+
+std::vector<DirectoryTree::Change> DirectoryTree::Rescan()
+{
+	std::unordered_map<Key, Node> nodes;
+	ScanDirectory(Key(), nodes);
+
+	std::vector<Change> changes;
+	Compare(Key(), nodes, changes);
+
+	// Refreshed directories match the file system even if changes to them were lost.
+	for (const auto& directory : m_refreshedDirectories)
+		changes.push_back({ directory.empty() ? m_root : m_root / directory, ChangeKind::Changed });
+
+	m_nodes.swap(nodes);
+	m_changedDirectories.clear();
+	m_refreshedDirectories.clear();
+	return changes;
+}
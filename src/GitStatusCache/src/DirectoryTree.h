@@ -0,0 +1,139 @@
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+* Summary of the directories beneath a monitored directory, used to find what changed while
+* change notifications were lost. Each directory records its modification time, a digest of
+* the names, sizes and modification times of its files, and a Merkle summary of its subtree,
+* so that comparisons skip unchanged subtrees. Individual files aren't recorded.
+* This class is not thread-safe.
+*/
+class DirectoryTree
+{
+public:
+	enum ChangeKind
+	{
+		/**
+		* Files in the directory were added, removed or modified.
+		*/
+		Changed,
+		Added,
+		Removed
+	};
+
+	/**
+	* Directory found to differ between the recorded tree and the file system.
+	*/
+	struct Change
+	{
+		std::filesystem::path Path;
+		ChangeKind Kind;
+	};
+
+private:
+	using Key = std::filesystem::path::string_type;
+
+	struct Node
+	{
+		int64_t ModifiedTime = 0;
+		uint64_t FilesDigest = 0;
+		uint64_t Summary = 0;
+
+		/**
+		* Names of child directories, sorted.
+		*/
+		std::vector<Key> Children;
+	};
+
+	std::filesystem::path m_root;
+
+	// Directories by path relative to the root. The root itself is the empty string.
+	std::unordered_map<Key, Node> m_nodes;
+
+	// Directories with changes reported since they were last read.
+	std::unordered_set<Key> m_changedDirectories;
+
+	// Directories read by refreshes since changes were last delivered. Refreshes happen some time
+	// after delivery, so they may record changes whose notifications were lost in the meantime.
+	std::unordered_set<Key> m_refreshedDirectories;
+
+	static uint64_t Combine(uint64_t seed, uint64_t value);
+	static Key GetChildKey(const Key& directory, const Key& name);
+
+	/**
+	* Reads the modification time, file digest and child directories of a directory.
+	*/
+	void ReadDirectory(const Key& directory, Node& node) const;
+
+	/**
+	* Reads a directory and everything beneath it into provided nodes.
+	*/
+	void ScanDirectory(const Key& directory, std::unordered_map<Key, Node>& nodes) const;
+
+	/**
+	* Combines a directory's own state with the summaries of its children. Children must be
+	* present in provided nodes.
+	*/
+	static uint64_t ComputeSummary(const Key& directory, const Node& node, const std::unordered_map<Key, Node>& nodes);
+
+	/**
+	* Removes a directory and everything beneath it.
+	*/
+	void EraseDirectory(const Key& directory);
+
+	/**
+	* Adds differences between the recorded directory and the scanned one to changes.
+	*/
+	void Compare(const Key& directory, const std::unordered_map<Key, Node>& nodes, std::vector<Change>& changes) const;
+
+public:
+	DirectoryTree(const std::filesystem::path& root);
+
+	/**
+	* Retrieves the directory the tree summarizes.
+	*/
+	const std::filesystem::path& GetRoot() const;
+
+	/**
+	* Records every directory beneath the root.
+	*/
+	void Scan();
+
+	/**
+	* Checks if the tree was scanned. Trees that weren't can't find lost changes.
+	*/
+	bool IsScanned() const;
+
+	/**
+	* Records that provided path beneath the root changed, so its directory is read again
+	* by the next refresh.
+	*/
+	void MarkChanged(const std::filesystem::path& path);
+
+	/**
+	* Checks if any directory was marked changed since the last refresh.
+	*/
+	bool HasChangedDirectories() const;
+
+	/**
+	* Reads the directories marked changed again, keeping the tree in step with changes that
+	* were delivered, so that later comparisons only find changes that were lost.
+	*/
+	void Refresh();
+
+	/**
+	* Forgets the directories read by refreshes. Called when changes are delivered.
+	*/
+	void ClearRefreshedDirectories();
+
+	/**
+	* Scans the root again and replaces the recorded tree. Returns the directories that
+	* differ, skipping subtrees whose summaries are unchanged, and the directories read by
+	* refreshes since changes were last delivered.
+	*/
+	std::vector<Change> Rescan();
+};
@@ -1,588 +1,1230 @@
-#include "stdafx.h"
-#include "Git.h"
-#include "StringConverters.h"
-
-#include <iostream>
-#include <fstream>
-#include <filesystem>
-
-std::string ReadFirstLineInFile(const std::filesystem::path& path)
-{
-	if (!std::filesystem::exists(path))
-		return "";
-
-	auto fileStream = std::ifstream(path.c_str());
-	if (!fileStream.good())
-		return "";
-
-	std::string firstLine;
-	std::getline(fileStream, firstLine);
-	return firstLine;
-}
-
-std::string ConvertErrorCodeToString(git_error_code errorCode)
-{
-	switch (errorCode)
-	{
-	default:
-		return "Unknown";
-	case GIT_OK:
-		return "Success";
-	case GIT_ERROR:
-		return "Generic Error";
-	case GIT_ENOTFOUND:
-		return "Requested object could not be found";
-	case GIT_EEXISTS:
-		return "Object exists preventing operation";
-	case GIT_EAMBIGUOUS:
-		return "More than one object matches";
-	case GIT_EBUFS:
-		return "Output buffer too short";
-	case GIT_EUSER:
-		return "User generated error";
-	case GIT_EBAREREPO:
-		return "Operation not allowed on bare repository";
-	case GIT_EUNBORNBRANCH:
-		return "HEAD refers to branch with no commits";
-	case GIT_EUNMERGED:
-		return "Merge in progress prevented operation";
-	case GIT_ENONFASTFORWARD:
-		return "Reference not fast-forwardable";
-	case GIT_EINVALIDSPEC:
-		return "Invalid name/ref spec";
-	case GIT_ECONFLICT:
-		return "Checkout conflicts prevented operation";
-	case GIT_ELOCKED:
-		return "Lock file prevented operation";
-	case GIT_EMODIFIED:
-		return "Reference value does not match expected";
-	case GIT_EAUTH:
-		return "Authentication error";
-	case GIT_ECERTIFICATE:
-		return "Invalid certificate";
-	case GIT_EAPPLIED:
-		return "Patch or merge already applied";
-	case GIT_EPEEL:
-		return "Peel operation is not possible";
-	case GIT_EEOF:
-		return "Unexpected end of file";
-	case GIT_EINVALID:
-		return "Invalid operation or input";
-	case GIT_EUNCOMMITTED:
-		return "Prevented due to uncommitted changes";
-	case GIT_PASSTHROUGH:
-		return "Passthrough";
-	case GIT_ITEROVER:
-		return "Iteration complete";
-	}
-}
-
-Git::Git()
-{
-	git_libgit2_init();
-}
-
-Git::~Git()
-{
-	git_libgit2_shutdown();
-}
-
-bool Git::DiscoverRepository(Git::Status& status, const std::string& path)
-{
-	status.RepositoryPath = std::string();
-
-	auto repositoryPath = MakeUniqueGitBuffer(git_buf{ 0 });
-	auto result = git_repository_discover(
-		&repositoryPath.get(),
-		path.c_str(),
-		true /*across_fs*/,
-		nullptr /*ceiling_dirs*/);
-
-	if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToDiscoverRepository", Severity::Warning)
-		//	<< R"(Failed to open repository. { "path: ")" << path
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.RepositoryPath = std::string(repositoryPath.get().ptr, repositoryPath.get().size);
-	return true;
-}
-
-bool Git::GetWorkingDirectory(Git::Status& status, UniqueGitRepository& repository)
-{
-	status.WorkingDirectory = "";
-
-	auto path = git_repository_workdir(repository.get());
-	if (path == NULL)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetWorkingDirectory.FailedToFindWorkingDirectory", Severity::Warning)
-		//	<< R"(Failed to find working directory for repository. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.WorkingDirectory = path;
-	return true;
-}
-
-bool Git::GetRepositoryState(Git::Status& status, UniqueGitRepository& repository)
-{
-	status.State = "";
-
-	auto state = git_repository_state(repository.get());
-	switch (state)
-	{
-	case GIT_REPOSITORY_STATE_NONE:
-		if (git_repository_head_detached(repository.get()))
-			status.State = "DETACHED";
-		return true;
-	case GIT_REPOSITORY_STATE_MERGE:
-		status.State = "MERGING";
-		return true;
-	case GIT_REPOSITORY_STATE_REVERT:
-		status.State = "REVERTING";
-		return true;
-	case GIT_REPOSITORY_STATE_CHERRYPICK:
-		status.State = "CHERRY-PICKING";
-		return true;
-	case GIT_REPOSITORY_STATE_BISECT:
-		status.State = "BISECTING";
-		return true;
-	case GIT_REPOSITORY_STATE_REBASE:
-		status.State = "REBASE";
-		return true;
-	case GIT_REPOSITORY_STATE_REBASE_INTERACTIVE:
-		status.State = "REBASE-i";
-		return true;
-	case GIT_REPOSITORY_STATE_REBASE_MERGE:
-		status.State = "REBASE-m";
-		return true;
-	case GIT_REPOSITORY_STATE_APPLY_MAILBOX:
-		status.State = "AM";
-		return true;
-	case GIT_REPOSITORY_STATE_APPLY_MAILBOX_OR_REBASE:
-		status.State = "AM/REBASE";
-		return true;
-	}
-
-	//Log("Git.GetRepositoryState.UnknownResult", Severity::Error)
-	//	<< R"(Encountered unknown repository state. { "repositoryPath": ")" << status.RepositoryPath
-	//	<< R"(", "state": ")" << state << R"(" })";
-	return false;
-}
-
-bool Git::SetBranchToCurrentCommit(Git::Status& status)
-{
-	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
-	path.append("HEAD");
-	auto commit = ReadFirstLineInFile(path);
-
-	if (!commit.empty())
-	{
-		status.Branch = commit.substr(0, 7);
-		return true;
-	}
-
-	return false;
-}
-
-bool Git::SetBranchFromHeadName(Git::Status& status, const std::filesystem::path& path)
-{
-	auto headName = ReadFirstLineInFile(path);
-	const std::string patternToStrip("refs/heads/");
-	if (headName.size() > patternToStrip.size() && headName.find(patternToStrip) == 0)
-	{
-		status.Branch = headName.substr(patternToStrip.size());
-		return true;
-	}
-
-	return false;
-}
-
-bool Git::SetBranchFromRebaseApplyHeadName(Git::Status& status)
-{
-	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
-	path.append("rebase-apply/head-name");
-	return SetBranchFromHeadName(status, path);
-}
-
-bool Git::SetBranchFromRebaseMergeHeadName(Git::Status& status)
-{
-	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
-	path.append("rebase-merge/head-name");
-	return SetBranchFromHeadName(status, path);
-}
-
-bool Git::GetRefStatus(Git::Status& status, UniqueGitRepository& repository)
-{
-	status.Branch = "";
-	status.Upstream = "";
-	status.UpstreamGone = false;
-	status.AheadBy = 0;
-	status.BehindBy = 0;
-
-	auto head = MakeUniqueGitReference(nullptr);
-	auto result = git_repository_head(&head.get(), repository.get());
-	if (result == GIT_EUNBORNBRANCH)
-	{
-		///Log("Git.GetRefStatus.UnbornBranch", Severity::Verbose)
-		//	<< R"(Current branch is unborn. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
-		status.Branch = "UNBORN";
-		return true;
-	}
-	else if (result == GIT_ENOTFOUND)
-	{
-		//Log("Git.GetRefStatus.HeadMissing", Severity::Warning)
-		//	<< R"(HEAD is missing. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
-		return false;
-	}
-	else if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToFindHead", Severity::Error)
-		//	<< R"(Failed to find HEAD. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.Branch = git_reference_shorthand(head.get());
-	if (status.Branch == "HEAD")
-	{
-		if (status.State == "DETACHED")
-		{
-			SetBranchToCurrentCommit(status);
-		}
-		else
-		{
-			if (!SetBranchFromRebaseApplyHeadName(status))
-				SetBranchFromRebaseMergeHeadName(status);
-		}
-
-		return true;
-	}
-
-	auto upstream = MakeUniqueGitReference(nullptr);
-	result = git_branch_upstream(&upstream.get(), head.get());
-	if (result == GIT_ENOTFOUND)
-	{
-		git_buf upstreamBranchName = { 0 };
-		auto upstreamBranchResult = git_branch_upstream_name(
-			&upstreamBranchName,
-			git_reference_owner(head.get()),
-			git_reference_name(head.get()));
-
-		auto canBuildUpstream = false;
-		if (upstreamBranchResult == GIT_OK)
-		{
-			//Log("Git.GetRefStatus.UpstreamGone", Severity::Spam)
-			//	<< R"(Branch has a configured upstream that is gone. { "repositoryPath": ")" << status.RepositoryPath
-			//	<< R"(", "localBranch": ")" << status.Branch << R"(" })";
-			status.UpstreamGone = true;
-			canBuildUpstream = upstreamBranchName.ptr != nullptr && upstreamBranchName.size != 0;
-		}
-
-		if (canBuildUpstream)
-		{
-			const std::string patternToRemove("refs/remotes/");
-			std::string upstreamName(upstreamBranchName.ptr);
-			auto patternPosition = upstreamName.find(patternToRemove);
-			if (patternPosition == 0 && upstreamName.size() > patternToRemove.size())
-			{
-				upstreamName.erase(patternPosition, patternToRemove.size());
-			}
-			status.Upstream = upstreamName;
-		}
-		else
-		{
-			//Log("Git.GetRefStatus.NoUpstream", Severity::Spam)
-			//	<< R"(Branch does not have a remote tracking reference. { "repositoryPath": ")" << status.RepositoryPath
-			//	<< R"(", "localBranch": ")" << status.Branch << R"(" })";
-		}
-
-		return true;
-	}
-	else if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToFindUpstream", Severity::Error)
-		//	<< R"(Failed to find remote tracking reference. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "localBranch": ")" << status.Branch
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.Upstream = git_reference_shorthand(upstream.get());
-
-	auto localTarget = git_reference_target(head.get());
-	if (localTarget == nullptr)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToRetrieveLocalBranchGitReferenceTarget", Severity::Error)
-		//	<< R"(Failed to retrieve git_oid for local target. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "localBranch": ")" << status.Branch
-		//	<< R"(", "upstreamBranch": ")" << status.Upstream
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	auto upstreamTarget = git_reference_target(upstream.get());
-	if (upstreamTarget == nullptr)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToRetrieveRemoteBranchGitReferenceTarget", Severity::Error)
-		//	<< R"(Failed to retrieve git_oid for upstream target. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "localBranch": ")" << status.Branch
-		//	<< R"(", "upstreamBranch": ")" << status.Upstream
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	size_t aheadBy, behindBy;
-	result = git_graph_ahead_behind(&aheadBy, &behindBy, repository.get(), localTarget, upstreamTarget);
-	if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetRefStatus.FailedToRetrieveAheadBehind", Severity::Error)
-		//	<< R"(Failed to retrieve ahead/behind information. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "localBranch": ")" << status.Branch
-		//	<< R"(", "upstreamBranch": ")" << status.Upstream
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.AheadBy = aheadBy;
-	status.BehindBy = behindBy;
-	return true;
-}
-
-bool Git::GetFileStatus(Git::Status& status, UniqueGitRepository& repository)
-{
-	git_status_options statusOptions = GIT_STATUS_OPTIONS_INIT;
-	statusOptions.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
-	statusOptions.flags =
-		GIT_STATUS_OPT_INCLUDE_UNTRACKED
-		| GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX
-		| GIT_STATUS_OPT_SORT_CASE_SENSITIVELY
-		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
-
-	auto statusList = MakeUniqueGitStatusList(nullptr);
-	auto result = git_status_list_new(&statusList.get(), repository.get(), &statusOptions);
-	if (result != GIT_OK)
-	{
-		//auto lastError = giterr_last();
-		//Log("Git.GetGitStatus.FailedToCreateStatusList", Severity::Error)
-		//	<< R"(Failed to create status list. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	for (size_t i = 0; i < git_status_list_entrycount(statusList.get()); ++i)
-	{
-		auto entry = git_status_byindex(statusList.get(), i);
-
-		const auto indexFlags =
-			GIT_STATUS_INDEX_NEW
-			| GIT_STATUS_INDEX_MODIFIED
-			| GIT_STATUS_INDEX_DELETED
-			| GIT_STATUS_INDEX_RENAMED
-			| GIT_STATUS_INDEX_TYPECHANGE;
-		if ((entry->status & indexFlags) != 0)
-		{
-			auto hasOldPath = entry->head_to_index->old_file.path != nullptr;
-			auto hasNewPath = entry->head_to_index->new_file.path != nullptr;
-			auto oldPath = hasOldPath ? entry->head_to_index->old_file.path : std::string();
-			auto newPath = hasNewPath ? entry->head_to_index->new_file.path : std::string();
-
-			std::string path;
-			if (hasOldPath && hasNewPath && oldPath == newPath)
-				path = oldPath;
-			else
-				path = hasOldPath ? oldPath : newPath;
-
-			if ((entry->status & GIT_STATUS_INDEX_NEW) == GIT_STATUS_INDEX_NEW)
-				status.IndexAdded.push_back(path);
-			if ((entry->status & GIT_STATUS_INDEX_MODIFIED) == GIT_STATUS_INDEX_MODIFIED)
-				status.IndexModified.push_back(path);
-			if ((entry->status & GIT_STATUS_INDEX_DELETED) == GIT_STATUS_INDEX_DELETED)
-				status.IndexDeleted.push_back(path);
-			if ((entry->status & GIT_STATUS_INDEX_RENAMED) == GIT_STATUS_INDEX_RENAMED)
-				status.IndexRenamed.emplace_back(std::make_pair(oldPath, newPath));
-			if ((entry->status & GIT_STATUS_INDEX_TYPECHANGE) == GIT_STATUS_INDEX_TYPECHANGE)
-				status.IndexTypeChange.push_back(path);
-		}
-
-		const auto workingFlags =
-			GIT_STATUS_WT_NEW
-			| GIT_STATUS_WT_MODIFIED
-			| GIT_STATUS_WT_DELETED
-			| GIT_STATUS_WT_TYPECHANGE
-			| GIT_STATUS_WT_RENAMED
-			| GIT_STATUS_WT_UNREADABLE;
-		if ((entry->status & workingFlags) != 0 && entry->index_to_workdir != nullptr)
-		{
-			auto hasOldPath = entry->index_to_workdir->old_file.path != nullptr;
-			auto hasNewPath = entry->index_to_workdir->new_file.path != nullptr;
-			auto oldPath = hasOldPath ? entry->index_to_workdir->old_file.path : std::string();
-			auto newPath = hasNewPath ? entry->index_to_workdir->new_file.path : std::string();
-
-			std::string path;
-			if (hasOldPath && hasNewPath && oldPath == newPath)
-				path = oldPath;
-			else
-				path = hasOldPath ? oldPath : newPath;
-
-			if ((entry->status & GIT_STATUS_WT_NEW) == GIT_STATUS_WT_NEW)
-				status.WorkingAdded.push_back(path);
-			if ((entry->status & GIT_STATUS_WT_MODIFIED) == GIT_STATUS_WT_MODIFIED)
-				status.WorkingModified.push_back(path);
-			if ((entry->status & GIT_STATUS_WT_DELETED) == GIT_STATUS_WT_DELETED)
-				status.WorkingDeleted.push_back(path);
-			if ((entry->status & GIT_STATUS_WT_TYPECHANGE) == GIT_STATUS_WT_TYPECHANGE)
-				status.WorkingTypeChange.push_back(path);
-			if ((entry->status & GIT_STATUS_WT_RENAMED) == GIT_STATUS_WT_RENAMED)
-				status.WorkingRenamed.emplace_back(std::make_pair(oldPath, newPath));
-			if ((entry->status & GIT_STATUS_WT_UNREADABLE) == GIT_STATUS_WT_UNREADABLE)
-				status.WorkingUnreadable.push_back(path);
-		}
-
-		const auto conflictIgnoreFlags = GIT_STATUS_IGNORED | GIT_STATUS_CONFLICTED;
-		if ((entry->status & conflictIgnoreFlags) != 0)
-		{
-			// libgit2 reports a subset of conflicts as two separate status entries with identical paths.
-			// One entry contains index_to_workdir and the other contains head_to_index.
-			auto hasOldPath = false;
-			auto hasNewPath = false;
-			auto oldPath = std::string();
-			auto newPath = std::string();
-			if (entry->index_to_workdir != nullptr)
-			{
-				hasOldPath = entry->index_to_workdir->old_file.path != nullptr;
-				hasNewPath = entry->index_to_workdir->new_file.path != nullptr;
-				oldPath = hasOldPath ? entry->index_to_workdir->old_file.path : std::string();
-				newPath = hasNewPath ? entry->index_to_workdir->new_file.path : std::string();
-			}
-			else if (entry->head_to_index != nullptr)
-			{
-				hasOldPath = entry->head_to_index->old_file.path != nullptr;
-				hasNewPath = entry->head_to_index->new_file.path != nullptr;
-				oldPath = hasOldPath ? entry->head_to_index->old_file.path : std::string();
-				newPath = hasNewPath ? entry->head_to_index->new_file.path : std::string();
-			}
-
-			std::string path;
-			if (hasOldPath && hasNewPath && oldPath == newPath)
-				path = oldPath;
-			else
-				path = hasOldPath ? oldPath : newPath;
-
-			if ((entry->status & GIT_STATUS_IGNORED) == GIT_STATUS_IGNORED)
-			{
-				if (std::find(status.Ignored.begin(), status.Ignored.end(), path) == status.Ignored.end())
-					status.Ignored.push_back(path);
-			}
-			if ((entry->status & GIT_STATUS_CONFLICTED) == GIT_STATUS_CONFLICTED)
-			{
-				if (std::find(status.Conflicted.begin(), status.Conflicted.end(), path) == status.Conflicted.end())
-					status.Conflicted.push_back(path);
-			}
-		}
-	}
-
-	return true;
-}
-
-bool Git::GetStashList(Status& status, UniqueGitRepository& repository)
-{
-	std::vector<Stash> stashes;
-	auto result = git_stash_foreach(
-		repository.get(),
-		[](size_t index, const char* message, const git_oid *stash_id, void *payload)
-		{
-			if (payload == nullptr)
-				return -1;
-
-			char hashBuffer[40] = { 0 };
-			Stash stash = {
-				index,
-				{ git_oid_tostr(hashBuffer, sizeof(hashBuffer), stash_id) },
-				message
-			};
-
-			auto payloadAsStashes = reinterpret_cast<std::vector<Stash>*>(payload);
-			payloadAsStashes->emplace_back(std::move(stash));
-			return 0;
-		},
-		&stashes);
-
-	if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetStashList.FailedToRetrieveStashList", Severity::Error)
-		//	<< R"(Failed to retrieve stash list. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return false;
-	}
-
-	status.Stashes = std::move(stashes);
-	return true;
-}
-
-std::tuple<bool, std::string> Git::DiscoverRepository(const std::string& path)
-{
-	Git::Status status;
-	if (Git::DiscoverRepository(status, path))
-		return { true, std::move(status.RepositoryPath) };
-	return { false, std::string() };
-}
-
-std::tuple<bool, Git::Status> Git::GetStatus(const std::string& path)
-{
-	Git::Status status;
-	if (!Git::DiscoverRepository(status, path))
-	{
-		return { false, Git::Status() };
-	}
-
-	auto repository = MakeUniqueGitRepository(nullptr);
-	auto result = git_repository_open_ext(
-		&repository.get(),
-		status.RepositoryPath.c_str(),
-		GIT_REPOSITORY_OPEN_NO_SEARCH,
-		nullptr);
-
-	if (result != GIT_OK)
-	{
-		auto lastError = giterr_last();
-		//Log("Git.GetGitStatus.FailedToOpenRepository", Severity::Error)
-		//	<< R"(Failed to open repository. { "repositoryPath": ")" << status.RepositoryPath
-		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
-		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
-		return { false, Git::Status() };
-	}
-
-	if (git_repository_is_bare(repository.get()))
-	{
-		//Log("Git.GetGitStatus.BareRepository", Severity::Warning)
-		//	<< R"(Aborting due to bare repository. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
-		return { false, Git::Status() };
-	}
-
-	Git::GetWorkingDirectory(status, repository);
-	Git::GetRepositoryState(status, repository);
-	Git::GetRefStatus(status, repository);
-	Git::GetStashList(status, repository);
-	if (!Git::GetFileStatus(status, repository))
-		return { false, Git::Status() };
-
-	return { true, std::move(status) };
-}
+#include "stdafx.h"
+#include "Git.h"
+#include "CommitGraph.h"
+#include "StringConverters.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <future>
+
+std::string ReadFirstLineInFile(const std::filesystem::path& path)
+{
+	if (!std::filesystem::exists(path))
+		return "";
+
+	auto fileStream = std::ifstream(path.c_str());
+	if (!fileStream.good())
+		return "";
+
+	std::string firstLine;
+	std::getline(fileStream, firstLine);
+	return firstLine;
+}
+
+std::wstring ReadEnvironmentVariable(const wchar_t* name)
+{
+#ifdef _WIN32
+	auto length = ::GetEnvironmentVariableW(name, nullptr, 0);
+	if (length == 0)
+		return std::wstring();
+
+	std::wstring value(length, L'\0');
+	length = ::GetEnvironmentVariableW(name, &value[0], length);
+	value.resize(length);
+	return value;
+#else
+	auto value = std::getenv(ConvertToUtf8(name).c_str());
+	return value == nullptr ? std::wstring() : ConvertToUnicode(value);
+#endif
+}
+
+std::string ConvertErrorCodeToString(git_error_code errorCode)
+{
+	switch (errorCode)
+	{
+	default:
+		return "Unknown";
+	case GIT_OK:
+		return "Success";
+	case GIT_ERROR:
+		return "Generic Error";
+	case GIT_ENOTFOUND:
+		return "Requested object could not be found";
+	case GIT_EEXISTS:
+		return "Object exists preventing operation";
+	case GIT_EAMBIGUOUS:
+		return "More than one object matches";
+	case GIT_EBUFS:
+		return "Output buffer too short";
+	case GIT_EUSER:
+		return "User generated error";
+	case GIT_EBAREREPO:
+		return "Operation not allowed on bare repository";
+	case GIT_EUNBORNBRANCH:
+		return "HEAD refers to branch with no commits";
+	case GIT_EUNMERGED:
+		return "Merge in progress prevented operation";
+	case GIT_ENONFASTFORWARD:
+		return "Reference not fast-forwardable";
+	case GIT_EINVALIDSPEC:
+		return "Invalid name/ref spec";
+	case GIT_ECONFLICT:
+		return "Checkout conflicts prevented operation";
+	case GIT_ELOCKED:
+		return "Lock file prevented operation";
+	case GIT_EMODIFIED:
+		return "Reference value does not match expected";
+	case GIT_EAUTH:
+		return "Authentication error";
+	case GIT_ECERTIFICATE:
+		return "Invalid certificate";
+	case GIT_EAPPLIED:
+		return "Patch or merge already applied";
+	case GIT_EPEEL:
+		return "Peel operation is not possible";
+	case GIT_EEOF:
+		return "Unexpected end of file";
+	case GIT_EINVALID:
+		return "Invalid operation or input";
+	case GIT_EUNCOMMITTED:
+		return "Prevented due to uncommitted changes";
+	case GIT_PASSTHROUGH:
+		return "Passthrough";
+	case GIT_ITEROVER:
+		return "Iteration complete";
+	}
+}
+
+Git::Git(uint32_t scanThreads)
+	: m_repositoryPool(16 /*capacity*/, std::chrono::seconds(60) /*idleTimeout*/)
+	, m_aheadBehindCache(1024 /*capacity*/)
+	, m_scanThreads(scanThreads != 0 ? scanThreads : (std::max)(std::thread::hardware_concurrency(), 1u))
+{
+	git_libgit2_init();
+}
+
+Git::~Git()
+{
+	m_repositoryPool.Clear();
+	git_libgit2_shutdown();
+}
+
+/*static*/ uint32_t Git::AddRequiredParts(uint32_t parts)
+{
+	// Ahead/behind counts need the upstream branch, and branch naming depends on repository state.
+	if ((parts & StatusParts::AheadBehind) != 0)
+		parts |= StatusParts::Branch;
+	if ((parts & StatusParts::Branch) != 0)
+		parts |= StatusParts::State;
+	return parts;
+}
+
+/*static*/ bool Git::OpenRepository(UniqueGitRepository& repository, const std::string& repositoryPath)
+{
+	auto result = git_repository_open_ext(
+		&repository.get(),
+		repositoryPath.c_str(),
+		GIT_REPOSITORY_OPEN_NO_SEARCH,
+		nullptr);
+
+	if (result != GIT_OK)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.OpenRepository.FailedToOpenRepository", Severity::Error)
+		//	<< R"(Failed to open repository. { "repositoryPath": ")" << repositoryPath
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	return true;
+}
+
+bool Git::DiscoverRepository(Git::Status& status, const std::string& path)
+{
+	status.RepositoryPath = std::string();
+
+	auto repositoryPath = MakeUniqueGitBuffer(git_buf{ 0 });
+	auto result = git_repository_discover(
+		&repositoryPath.get(),
+		path.c_str(),
+		true /*across_fs*/,
+		nullptr /*ceiling_dirs*/);
+
+	if (result != GIT_OK)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetRefStatus.FailedToDiscoverRepository", Severity::Warning)
+		//	<< R"(Failed to open repository. { "path: ")" << path
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	status.RepositoryPath = std::string(repositoryPath.get().ptr, repositoryPath.get().size);
+	return true;
+}
+
+bool Git::GetWorkingDirectory(Git::Status& status, UniqueGitRepository& repository)
+{
+	status.WorkingDirectory = "";
+
+	auto path = git_repository_workdir(repository.get());
+	if (path == NULL)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetWorkingDirectory.FailedToFindWorkingDirectory", Severity::Warning)
+		//	<< R"(Failed to find working directory for repository. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	status.WorkingDirectory = path;
+	return true;
+}
+
+bool Git::GetRepositoryState(Git::Status& status, UniqueGitRepository& repository)
+{
+	status.State = "";
+
+	auto state = git_repository_state(repository.get());
+	switch (state)
+	{
+	case GIT_REPOSITORY_STATE_NONE:
+		if (git_repository_head_detached(repository.get()))
+			status.State = "DETACHED";
+		return true;
+	case GIT_REPOSITORY_STATE_MERGE:
+		status.State = "MERGING";
+		return true;
+	case GIT_REPOSITORY_STATE_REVERT:
+		status.State = "REVERTING";
+		return true;
+	case GIT_REPOSITORY_STATE_CHERRYPICK:
+		status.State = "CHERRY-PICKING";
+		return true;
+	case GIT_REPOSITORY_STATE_BISECT:
+		status.State = "BISECTING";
+		return true;
+	case GIT_REPOSITORY_STATE_REBASE:
+		status.State = "REBASE";
+		return true;
+	case GIT_REPOSITORY_STATE_REBASE_INTERACTIVE:
+		status.State = "REBASE-i";
+		return true;
+	case GIT_REPOSITORY_STATE_REBASE_MERGE:
+		status.State = "REBASE-m";
+		return true;
+	case GIT_REPOSITORY_STATE_APPLY_MAILBOX:
+		status.State = "AM";
+		return true;
+	case GIT_REPOSITORY_STATE_APPLY_MAILBOX_OR_REBASE:
+		status.State = "AM/REBASE";
+		return true;
+	}
+
+	//Log("Git.GetRepositoryState.UnknownResult", Severity::Error)
+	//	<< R"(Encountered unknown repository state. { "repositoryPath": ")" << status.RepositoryPath
+	//	<< R"(", "state": ")" << state << R"(" })";
+	return false;
+}
+
+bool Git::SetBranchToCurrentCommit(Git::Status& status)
+{
+	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
+	path.append("HEAD");
+	auto commit = ReadFirstLineInFile(path);
+
+	if (!commit.empty())
+	{
+		status.Branch = commit.substr(0, 7);
+		return true;
+	}
+
+	return false;
+}
+
+bool Git::SetBranchFromHeadName(Git::Status& status, const std::filesystem::path& path)
+{
+	auto headName = ReadFirstLineInFile(path);
+	const std::string patternToStrip("refs/heads/");
+	if (headName.size() > patternToStrip.size() && headName.find(patternToStrip) == 0)
+	{
+		status.Branch = headName.substr(patternToStrip.size());
+		return true;
+	}
+
+	return false;
+}
+
+bool Git::SetBranchFromRebaseApplyHeadName(Git::Status& status)
+{
+	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
+	path.append("rebase-apply/head-name");
+	return SetBranchFromHeadName(status, path);
+}
+
+bool Git::SetBranchFromRebaseMergeHeadName(Git::Status& status)
+{
+	auto path = std::filesystem::path(ConvertToUnicode(status.RepositoryPath));
+	path.append("rebase-merge/head-name");
+	return SetBranchFromHeadName(status, path);
+}
+
+bool Git::GetRefStatus(Git::Status& status, UniqueGitRepository& repository, bool includeAheadBehind)
+{
+	status.Branch = "";
+	status.Upstream = "";
+	status.UpstreamGone = false;
+	status.AheadBy = 0;
+	status.BehindBy = 0;
+
+	auto head = MakeUniqueGitReference(nullptr);
+	auto result = git_repository_head(&head.get(), repository.get());
+	if (result == GIT_EUNBORNBRANCH)
+	{
+		///Log("Git.GetRefStatus.UnbornBranch", Severity::Verbose)
+		//	<< R"(Current branch is unborn. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
+		status.Branch = "UNBORN";
+		return true;
+	}
+	else if (result == GIT_ENOTFOUND)
+	{
+		//Log("Git.GetRefStatus.HeadMissing", Severity::Warning)
+		//	<< R"(HEAD is missing. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
+		return false;
+	}
+	else if (result != GIT_OK)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetRefStatus.FailedToFindHead", Severity::Error)
+		//	<< R"(Failed to find HEAD. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	status.Branch = git_reference_shorthand(head.get());
+	if (status.Branch == "HEAD")
+	{
+		if (status.State == "DETACHED")
+		{
+			SetBranchToCurrentCommit(status);
+		}
+		else
+		{
+			if (!SetBranchFromRebaseApplyHeadName(status))
+				SetBranchFromRebaseMergeHeadName(status);
+		}
+
+		return true;
+	}
+
+	auto upstream = MakeUniqueGitReference(nullptr);
+	result = git_branch_upstream(&upstream.get(), head.get());
+	if (result == GIT_ENOTFOUND)
+	{
+		git_buf upstreamBranchName = { 0 };
+		auto upstreamBranchResult = git_branch_upstream_name(
+			&upstreamBranchName,
+			git_reference_owner(head.get()),
+			git_reference_name(head.get()));
+
+		auto canBuildUpstream = false;
+		if (upstreamBranchResult == GIT_OK)
+		{
+			//Log("Git.GetRefStatus.UpstreamGone", Severity::Spam)
+			//	<< R"(Branch has a configured upstream that is gone. { "repositoryPath": ")" << status.RepositoryPath
+			//	<< R"(", "localBranch": ")" << status.Branch << R"(" })";
+			status.UpstreamGone = true;
+			canBuildUpstream = upstreamBranchName.ptr != nullptr && upstreamBranchName.size != 0;
+		}
+
+		if (canBuildUpstream)
+		{
+			const std::string patternToRemove("refs/remotes/");
+			std::string upstreamName(upstreamBranchName.ptr);
+			auto patternPosition = upstreamName.find(patternToRemove);
+			if (patternPosition == 0 && upstreamName.size() > patternToRemove.size())
+			{
+				upstreamName.erase(patternPosition, patternToRemove.size());
+			}
+			status.Upstream = upstreamName;
+		}
+		else
+		{
+			//Log("Git.GetRefStatus.NoUpstream", Severity::Spam)
+			//	<< R"(Branch does not have a remote tracking reference. { "repositoryPath": ")" << status.RepositoryPath
+			//	<< R"(", "localBranch": ")" << status.Branch << R"(" })";
+		}
+
+		return true;
+	}
+	else if (result != GIT_OK)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetRefStatus.FailedToFindUpstream", Severity::Error)
+		//	<< R"(Failed to find remote tracking reference. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "localBranch": ")" << status.Branch
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	status.Upstream = git_reference_shorthand(upstream.get());
+	if (!includeAheadBehind)
+		return true;
+
+	auto localTarget = git_reference_target(head.get());
+	if (localTarget == nullptr)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetRefStatus.FailedToRetrieveLocalBranchGitReferenceTarget", Severity::Error)
+		//	<< R"(Failed to retrieve git_oid for local target. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "localBranch": ")" << status.Branch
+		//	<< R"(", "upstreamBranch": ")" << status.Upstream
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	auto upstreamTarget = git_reference_target(upstream.get());
+	if (upstreamTarget == nullptr)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetRefStatus.FailedToRetrieveRemoteBranchGitReferenceTarget", Severity::Error)
+		//	<< R"(Failed to retrieve git_oid for upstream target. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "localBranch": ")" << status.Branch
+		//	<< R"(", "upstreamBranch": ")" << status.Upstream
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	AheadBehindCache::Counts counts;
+	if (!Git::GetAheadBehind(status, repository, *localTarget, *upstreamTarget, counts))
+		return false;
+
+	status.AheadBy = counts.AheadBy;
+	status.BehindBy = counts.BehindBy;
+	return true;
+}
+
+bool Git::GetAheadBehind(
+	const Git::Status& status,
+	UniqueGitRepository& repository,
+	const git_oid& localTarget,
+	const git_oid& upstreamTarget,
+	AheadBehindCache::Counts& counts)
+{
+	AheadBehindCache::CommitPair commitPair = { localTarget, upstreamTarget };
+	auto cachedCounts = m_aheadBehindCache.Find(commitPair);
+	if (std::get<0>(cachedCounts))
+	{
+		counts = std::get<1>(cachedCounts);
+		return true;
+	}
+
+	auto branchKey = status.RepositoryPath + '\n' + status.Branch;
+	auto last = m_aheadBehindCache.FindLast(branchKey);
+	if ((!std::get<0>(last) || !Git::UpdateAheadBehind(repository, std::get<1>(last), std::get<2>(last), commitPair, counts))
+		&& !Git::GetAheadBehindFromCommitGraph(repository, commitPair, counts))
+	{
+		auto result = git_graph_ahead_behind(&counts.AheadBy, &counts.BehindBy, repository.get(), &localTarget, &upstreamTarget);
+		if (result != GIT_OK)
+		{
+			auto lastError = giterr_last();
+			//Log("Git.GetAheadBehind.FailedToRetrieveAheadBehind", Severity::Error)
+			//	<< R"(Failed to retrieve ahead/behind information. { "repositoryPath": ")" << status.RepositoryPath
+			//	<< R"(", "localBranch": ")" << status.Branch
+			//	<< R"(", "upstreamBranch": ")" << status.Upstream
+			//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+			//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+			return false;
+		}
+	}
+
+	m_aheadBehindCache.Insert(branchKey, commitPair, counts);
+	return true;
+}
+
+/*static*/ bool Git::GetAheadBehindFromCommitGraph(
+	UniqueGitRepository& repository,
+	const AheadBehindCache::CommitPair& commitPair,
+	AheadBehindCache::Counts& counts)
+{
+	CommitGraph commitGraph;
+	if (!commitGraph.Open(repository.get()))
+		return false;
+
+	return commitGraph.AheadBehind(commitPair.Local, commitPair.Upstream, counts.AheadBy, counts.BehindBy);
+}
+
+/*static*/ bool Git::UpdateAheadBehind(
+	UniqueGitRepository& repository,
+	const AheadBehindCache::CommitPair& previousCommitPair,
+	const AheadBehindCache::Counts& previousCounts,
+	const AheadBehindCache::CommitPair& commitPair,
+	AheadBehindCache::Counts& counts)
+{
+	auto localMoved = !git_oid_equal(&previousCommitPair.Local, &commitPair.Local);
+	auto upstreamMoved = !git_oid_equal(&previousCommitPair.Upstream, &commitPair.Upstream);
+	if (localMoved == upstreamMoved)
+		return false;
+
+	// Names the side that moved "tip" and the side that didn't "other".
+	const auto& previousTip = localMoved ? previousCommitPair.Local : previousCommitPair.Upstream;
+	const auto& tip = localMoved ? commitPair.Local : commitPair.Upstream;
+	const auto& other = localMoved ? commitPair.Upstream : commitPair.Local;
+	if (git_graph_descendant_of(repository.get(), &tip, &previousTip) != 1)
+		return false;
+
+	// New commits on the tip's side that the other side lacks extend the tip's lead.
+	// The rest were already on the other side and no longer count towards its lead.
+	size_t newCommits;
+	size_t newUniqueCommits;
+	if (!Git::CountCommits(repository, tip, { &previousTip }, newCommits)
+		|| !Git::CountCommits(repository, tip, { &previousTip, &other }, newUniqueCommits))
+	{
+		return false;
+	}
+
+	auto previousTipLead = localMoved ? previousCounts.AheadBy : previousCounts.BehindBy;
+	auto previousOtherLead = localMoved ? previousCounts.BehindBy : previousCounts.AheadBy;
+	auto sharedCommits = newCommits - newUniqueCommits;
+	if (sharedCommits > previousOtherLead)
+		return false;
+
+	auto tipLead = previousTipLead + newUniqueCommits;
+	auto otherLead = previousOtherLead - sharedCommits;
+	counts.AheadBy = localMoved ? tipLead : otherLead;
+	counts.BehindBy = localMoved ? otherLead : tipLead;
+	return true;
+}
+
+/*static*/ bool Git::CountCommits(UniqueGitRepository& repository, const git_oid& commit, const std::vector<const git_oid*>& hiddenCommits, size_t& count)
+{
+	auto revwalk = MakeUniqueGitRevwalk(nullptr);
+	if (git_revwalk_new(&revwalk.get(), repository.get()) != GIT_OK)
+		return false;
+
+	if (git_revwalk_push(revwalk.get(), &commit) != GIT_OK)
+		return false;
+
+	for (auto hiddenCommit : hiddenCommits)
+	{
+		if (git_revwalk_hide(revwalk.get(), hiddenCommit) != GIT_OK)
+			return false;
+	}
+
+	count = 0;
+	git_oid walkedCommit;
+	int result;
+	while ((result = git_revwalk_next(&walkedCommit, revwalk.get())) == GIT_OK)
+		++count;
+
+	return result == GIT_ITEROVER;
+}
+
+bool Git::GetFileStatus(Git::Status& status, UniqueGitRepository& repository, uint32_t parts)
+{
+	auto includeIndex = (parts & StatusParts::Index) != 0;
+	auto includeWorkingTree = (parts & StatusParts::WorkingTree) != 0;
+	if (!includeIndex && !includeWorkingTree)
+		return true;
+
+	if (includeWorkingTree && m_scanThreads > 1)
+	{
+		auto partitions = Git::GetWorkingTreePartitions(status, repository);
+		if (partitions.size() > 1)
+			return Git::GetFileStatusInParallel(status, repository, parts, partitions);
+	}
+
+	git_status_options statusOptions = GIT_STATUS_OPTIONS_INIT;
+	statusOptions.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+	statusOptions.flags =
+		GIT_STATUS_OPT_SORT_CASE_SENSITIVELY
+		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
+	if (includeIndex)
+		statusOptions.flags |= GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX;
+	else
+		statusOptions.show = GIT_STATUS_SHOW_WORKDIR_ONLY;
+	if (includeWorkingTree)
+		statusOptions.flags |= GIT_STATUS_OPT_INCLUDE_UNTRACKED;
+	else
+		statusOptions.show = GIT_STATUS_SHOW_INDEX_ONLY;
+
+	return Git::CollectFileStatus(status, repository, statusOptions);
+}
+
+std::vector<std::vector<std::string>> Git::GetWorkingTreePartitions(const Git::Status& status, UniqueGitRepository& repository)
+{
+	auto index = MakeUniqueGitIndex(nullptr);
+	if (git_repository_index(&index.get(), repository.get()) != GIT_OK)
+		return {};
+
+	auto entryCount = git_index_entrycount(index.get());
+	if (entryCount < MinParallelScanEntries)
+		return {};
+
+	// Tracked files beneath each top-level entry approximate the cost of scanning it.
+	// Entries that only exist in the index must be scanned to report their deletion.
+	std::unordered_map<std::string, size_t> weights;
+	std::pair<const std::string, size_t>* weight = nullptr;
+	for (size_t i = 0; i < entryCount; ++i)
+	{
+		auto path = git_index_get_byindex(index.get(), i)->path;
+		auto separator = std::strchr(path, '/');
+		auto nameLength = separator != nullptr ? static_cast<size_t>(separator - path) : std::strlen(path);
+		if (weight == nullptr || weight->first.compare(0, std::string::npos, path, nameLength) != 0)
+			weight = &*weights.emplace(std::string(path, nameLength), 0).first;
+		++weight->second;
+	}
+
+	std::error_code error;
+	std::filesystem::directory_iterator end;
+	for (std::filesystem::directory_iterator entry(ConvertToUnicode(status.WorkingDirectory), error); !error && entry != end; entry.increment(error))
+	{
+		auto name = ConvertToUtf8(entry->path().filename().wstring());
+		if (name != ".git")
+			weights.emplace(name, 1);
+	}
+
+	if (error)
+	{
+		//Log("Git.GetWorkingTreePartitions.FailedToListWorkingDirectory", Severity::Warning)
+		//	<< R"(Failed to list working directory. Scanning serially. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "error": ")" << error.message() << R"(" })";
+		return {};
+	}
+
+	std::vector<std::pair<std::string, size_t>> names(weights.begin(), weights.end());
+	std::sort(
+		names.begin(),
+		names.end(),
+		[](const std::pair<std::string, size_t>& lhs, const std::pair<std::string, size_t>& rhs) { return lhs.second > rhs.second; });
+
+	// Heaviest entries are placed first, each into the least loaded partition.
+	auto partitionCount = std::min<size_t>(m_scanThreads, names.size());
+	std::vector<std::vector<std::string>> partitions(partitionCount);
+	std::vector<size_t> loads(partitionCount, 0);
+	for (auto& name : names)
+	{
+		auto partition = std::distance(loads.begin(), std::min_element(loads.begin(), loads.end()));
+		loads[partition] += name.second;
+		partitions[partition].push_back(std::move(name.first));
+	}
+
+	return partitions;
+}
+
+bool Git::GetFileStatusInParallel(
+	Git::Status& status,
+	UniqueGitRepository& repository,
+	uint32_t parts,
+	const std::vector<std::vector<std::string>>& partitions)
+{
+	std::vector<std::future<std::tuple<bool, Git::Status>>> partitionStatuses;
+	for (const auto& partition : partitions)
+	{
+		partitionStatuses.push_back(std::async(
+			std::launch::async,
+			[this, &status, &partition]() { return Git::GetPartitionFileStatus(status.RepositoryPath, partition); }));
+	}
+
+	// Staged changes only depend on the index, so they're cheap to compute while the working
+	// directory is scanned. Computing them in one pass keeps renames between partitions intact.
+	git_status_options statusOptions = GIT_STATUS_OPTIONS_INIT;
+	statusOptions.show = GIT_STATUS_SHOW_INDEX_ONLY;
+	statusOptions.flags =
+		GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX
+		| GIT_STATUS_OPT_SORT_CASE_SENSITIVELY
+		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
+	// Path lists are merged in full, then limited.
+	auto maxPaths = status.MaxPaths;
+	status.MaxPaths = UnlimitedPaths;
+	auto success = (parts & StatusParts::Index) == 0 || Git::CollectFileStatus(status, repository, statusOptions);
+
+	std::vector<Git::Status> workingStatuses;
+	for (auto& partitionStatus : partitionStatuses)
+	{
+		auto result = partitionStatus.get();
+		success = success && std::get<0>(result);
+		workingStatuses.emplace_back(std::move(std::get<1>(result)));
+	}
+
+	if (!success)
+		return false;
+
+	// Partitions hold disjoint top-level entries, so merging their sorted entries
+	// reproduces the order of a single case sensitive scan.
+	std::vector<const StatusPaths*> sources = { &status.Paths };
+	for (const auto& workingStatus : workingStatuses)
+		sources.push_back(&workingStatus.Paths);
+
+	StatusPaths::Builder builder;
+	for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+	{
+		if (category < StatusPaths::Category::WorkingAdded)
+			builder.Append(category, status.Paths);
+		else
+			Git::AddMergedPaths(builder, category, sources);
+	}
+	status.Paths = builder.Build();
+
+	status.MaxPaths = maxPaths;
+	Git::ApplyPathLimit(status);
+	return true;
+}
+
+std::tuple<bool, Git::Status> Git::GetPartitionFileStatus(const std::string& repositoryPath, const std::vector<std::string>& partition)
+{
+	Git::Status status;
+	status.RepositoryPath = repositoryPath;
+
+	auto repository = MakeUniqueGitRepository(nullptr);
+	if (!Git::OpenRepository(repository, repositoryPath))
+		return { false, Git::Status() };
+
+	std::vector<char*> pathspecs;
+	for (const auto& name : partition)
+		pathspecs.push_back(const_cast<char*>(name.c_str()));
+
+	git_status_options statusOptions = GIT_STATUS_OPTIONS_INIT;
+	statusOptions.show = GIT_STATUS_SHOW_WORKDIR_ONLY;
+	statusOptions.flags =
+		GIT_STATUS_OPT_INCLUDE_UNTRACKED
+		| GIT_STATUS_OPT_SORT_CASE_SENSITIVELY
+		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES
+		| GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH;
+	statusOptions.pathspec.strings = pathspecs.data();
+	statusOptions.pathspec.count = pathspecs.size();
+
+	if (!Git::CollectFileStatus(status, repository, statusOptions))
+		return { false, Git::Status() };
+
+	return { true, std::move(status) };
+}
+
+/*static*/ void Git::AddMergedPaths(StatusPaths::Builder& builder, uint8_t category, const std::vector<const StatusPaths*>& sources)
+{
+	if (StatusPaths::IsRenamedCategory(category))
+	{
+		std::vector<std::pair<std::string_view, std::string_view>> renamedPaths;
+		for (auto source : sources)
+		{
+			auto sourcePaths = source->GetRenamed(category);
+			auto middle = renamedPaths.size();
+			for (size_t i = 0; i < sourcePaths.size(); ++i)
+				renamedPaths.push_back(sourcePaths[i]);
+			std::inplace_merge(renamedPaths.begin(), renamedPaths.begin() + middle, renamedPaths.end());
+		}
+		renamedPaths.erase(std::unique(renamedPaths.begin(), renamedPaths.end()), renamedPaths.end());
+
+		for (const auto& renamedPath : renamedPaths)
+			builder.AddRenamed(category, renamedPath.first, renamedPath.second);
+		return;
+	}
+
+	std::vector<std::string_view> paths;
+	for (auto source : sources)
+	{
+		auto middle = paths.size();
+		for (auto path : source->Get(category))
+			paths.push_back(path);
+		std::inplace_merge(paths.begin(), paths.begin() + middle, paths.end());
+	}
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	for (auto path : paths)
+		builder.Add(category, path);
+}
+
+/*static*/ void Git::ClearFileStatus(Git::Status& status)
+{
+	status.Paths = StatusPaths();
+	status.PathCounts = {};
+}
+
+/*static*/ void Git::ApplyPathLimit(Git::Status& status)
+{
+	status.PathCounts = status.Paths.GetSizes();
+	auto isTruncated = std::any_of(
+		status.PathCounts.begin(),
+		status.PathCounts.end(),
+		[&status](size_t count) { return count > status.MaxPaths; });
+	if (!isTruncated)
+		return;
+
+	StatusPaths::Builder builder;
+	for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+		builder.Append(category, status.Paths, status.MaxPaths);
+	status.Paths = builder.Build();
+}
+
+/*static*/ bool Git::IsFileStatusTruncated(const Git::Status& status)
+{
+	for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+	{
+		if (status.Paths.Size(category) < status.PathCounts[category])
+			return true;
+	}
+	return false;
+}
+
+bool Git::UpdateFileStatus(Git::Status& status, UniqueGitRepository& repository, const std::vector<std::string>& paths)
+{
+	// Paths inside untracked directories are rescanned as the whole directory, since
+	// git reports untracked directories rather than their contents.
+	std::unordered_set<std::string> untrackedDirectories;
+	for (auto workingAdded : status.Paths.Get(StatusPaths::Category::WorkingAdded))
+	{
+		if (workingAdded.back() == '/')
+			untrackedDirectories.emplace(workingAdded.substr(0, workingAdded.size() - 1));
+	}
+
+	std::unordered_set<std::string> scopes;
+	for (const auto& path : paths)
+	{
+		auto scope = path;
+		for (auto separator = path.find('/'); separator != std::string::npos; separator = path.find('/', separator + 1))
+		{
+			if (untrackedDirectories.find(path.substr(0, separator)) != untrackedDirectories.end())
+			{
+				scope = path.substr(0, separator);
+				break;
+			}
+		}
+		scopes.insert(scope);
+	}
+
+	// Removes entries equal to or beneath a scope, or that contain a scope.
+	auto isInScope = [&scopes](std::string_view path)
+	{
+		auto entry = path.back() == '/' ? path.substr(0, path.size() - 1) : path;
+		for (auto separator = entry.find('/'); separator != std::string_view::npos; separator = entry.find('/', separator + 1))
+		{
+			if (scopes.find(std::string(entry.substr(0, separator))) != scopes.end())
+				return true;
+		}
+		if (scopes.find(std::string(entry)) != scopes.end())
+			return true;
+
+		if (path.back() != '/')
+			return false;
+
+		for (const auto& scope : scopes)
+		{
+			if (scope.size() > entry.size() && scope[entry.size()] == '/' && scope.compare(0, entry.size(), entry) == 0)
+				return true;
+		}
+		return false;
+	};
+	std::vector<char*> pathspecs;
+	for (const auto& scope : scopes)
+		pathspecs.push_back(const_cast<char*>(scope.c_str()));
+
+	git_status_options statusOptions = GIT_STATUS_OPTIONS_INIT;
+	statusOptions.show = GIT_STATUS_SHOW_WORKDIR_ONLY;
+	statusOptions.flags =
+		GIT_STATUS_OPT_INCLUDE_UNTRACKED
+		| GIT_STATUS_OPT_SORT_CASE_SENSITIVELY
+		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES
+		| GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH;
+	statusOptions.pathspec.strings = pathspecs.data();
+	statusOptions.pathspec.count = pathspecs.size();
+
+	Git::Status changes;
+	changes.RepositoryPath = status.RepositoryPath;
+	if (!Git::CollectFileStatus(changes, repository, statusOptions))
+		return false;
+
+	// Entries of patched path lists in scope are replaced by the rescanned entries.
+	auto isPatched = [](uint8_t category)
+	{
+		return category >= StatusPaths::Category::WorkingAdded && category <= StatusPaths::Category::WorkingUnreadable;
+	};
+
+	StatusPaths::Builder builder;
+	for (uint8_t category = 0; category < StatusPaths::Category::Count; ++category)
+	{
+		if (!isPatched(category))
+		{
+			builder.Append(category, status.Paths);
+			continue;
+		}
+
+		std::vector<std::string_view> entries;
+		for (auto entry : status.Paths.Get(category))
+		{
+			if (!isInScope(entry))
+				entries.push_back(entry);
+		}
+
+		auto changedEntries = changes.Paths.Get(category);
+		if (!changedEntries.empty())
+		{
+			entries.insert(entries.end(), changedEntries.begin(), changedEntries.end());
+			std::sort(entries.begin(), entries.end());
+			entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+		}
+
+		for (auto entry : entries)
+			builder.Add(category, entry);
+	}
+	status.Paths = builder.Build();
+
+	Git::ApplyPathLimit(status);
+	return true;
+}
+
+bool Git::CollectFileStatus(Git::Status& status, UniqueGitRepository& repository, const git_status_options& statusOptions)
+{
+	auto statusList = MakeUniqueGitStatusList(nullptr);
+	auto result = git_status_list_new(&statusList.get(), repository.get(), &statusOptions);
+	if (result != GIT_OK)
+	{
+		//auto lastError = giterr_last();
+		//Log("Git.GetGitStatus.FailedToCreateStatusList", Severity::Error)
+		//	<< R"(Failed to create status list. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	auto entryCount = git_status_list_entrycount(statusList.get());
+	std::vector<const git_status_entry*> entries(entryCount);
+	for (size_t i = 0; i < entryCount; ++i)
+		entries[i] = git_status_byindex(statusList.get(), i);
+
+	CollectFileStatus(status, entries);
+	return true;
+}
+
+/*static*/ void Git::CollectFileStatus(Git::Status& status, const std::vector<const git_status_entry*>& entries)
+{
+	// Paths beyond the status' path limit are counted but not kept.
+	using Category = StatusPaths::Category;
+	StatusPaths::Builder builder;
+	StatusPaths::Counts counts = {};
+	auto addPath = [&status, &builder, &counts](uint8_t category, std::string_view path)
+	{
+		if (builder.Size(category) < status.MaxPaths)
+			builder.Add(category, path);
+		++counts[category];
+	};
+	auto addRenamedPath = [&status, &builder, &counts](uint8_t category, std::string_view oldPath, std::string_view newPath)
+	{
+		if (builder.Size(category) < status.MaxPaths)
+			builder.AddRenamed(category, oldPath, newPath);
+		++counts[category];
+	};
+	// Duplicates are found by hashing, so that merges with many conflicts stay linear.
+	// Paths beyond the limit are remembered too, so that they're only counted once.
+	auto addUniquePath = [&addPath](uint8_t category, std::unordered_set<std::string_view>& seenPaths, std::string_view path)
+	{
+		if (seenPaths.insert(path).second)
+			addPath(category, path);
+	};
+	std::unordered_set<std::string_view> ignoredPaths;
+	std::unordered_set<std::string_view> conflictedPaths;
+
+	// Paths are viewed in place in the status list and copied once, into the builder's arena.
+	auto toPath = [](const char* path) { return path != nullptr ? std::string_view(path) : std::string_view(); };
+
+	for (auto entry : entries)
+	{
+		const auto indexFlags =
+			GIT_STATUS_INDEX_NEW
+			| GIT_STATUS_INDEX_MODIFIED
+			| GIT_STATUS_INDEX_DELETED
+			| GIT_STATUS_INDEX_RENAMED
+			| GIT_STATUS_INDEX_TYPECHANGE;
+		if ((entry->status & indexFlags) != 0)
+		{
+			auto oldPath = toPath(entry->head_to_index->old_file.path);
+			auto newPath = toPath(entry->head_to_index->new_file.path);
+			auto path = entry->head_to_index->old_file.path != nullptr ? oldPath : newPath;
+
+			if ((entry->status & GIT_STATUS_INDEX_NEW) == GIT_STATUS_INDEX_NEW)
+				addPath(Category::IndexAdded, path);
+			if ((entry->status & GIT_STATUS_INDEX_MODIFIED) == GIT_STATUS_INDEX_MODIFIED)
+				addPath(Category::IndexModified, path);
+			if ((entry->status & GIT_STATUS_INDEX_DELETED) == GIT_STATUS_INDEX_DELETED)
+				addPath(Category::IndexDeleted, path);
+			if ((entry->status & GIT_STATUS_INDEX_RENAMED) == GIT_STATUS_INDEX_RENAMED)
+				addRenamedPath(Category::IndexRenamed, oldPath, newPath);
+			if ((entry->status & GIT_STATUS_INDEX_TYPECHANGE) == GIT_STATUS_INDEX_TYPECHANGE)
+				addPath(Category::IndexTypeChange, path);
+		}
+
+		const auto workingFlags =
+			GIT_STATUS_WT_NEW
+			| GIT_STATUS_WT_MODIFIED
+			| GIT_STATUS_WT_DELETED
+			| GIT_STATUS_WT_TYPECHANGE
+			| GIT_STATUS_WT_RENAMED
+			| GIT_STATUS_WT_UNREADABLE;
+		if ((entry->status & workingFlags) != 0 && entry->index_to_workdir != nullptr)
+		{
+			auto oldPath = toPath(entry->index_to_workdir->old_file.path);
+			auto newPath = toPath(entry->index_to_workdir->new_file.path);
+			auto path = entry->index_to_workdir->old_file.path != nullptr ? oldPath : newPath;
+
+			if ((entry->status & GIT_STATUS_WT_NEW) == GIT_STATUS_WT_NEW)
+				addPath(Category::WorkingAdded, path);
+			if ((entry->status & GIT_STATUS_WT_MODIFIED) == GIT_STATUS_WT_MODIFIED)
+				addPath(Category::WorkingModified, path);
+			if ((entry->status & GIT_STATUS_WT_DELETED) == GIT_STATUS_WT_DELETED)
+				addPath(Category::WorkingDeleted, path);
+			if ((entry->status & GIT_STATUS_WT_TYPECHANGE) == GIT_STATUS_WT_TYPECHANGE)
+				addPath(Category::WorkingTypeChange, path);
+			if ((entry->status & GIT_STATUS_WT_RENAMED) == GIT_STATUS_WT_RENAMED)
+				addRenamedPath(Category::WorkingRenamed, oldPath, newPath);
+			if ((entry->status & GIT_STATUS_WT_UNREADABLE) == GIT_STATUS_WT_UNREADABLE)
+				addPath(Category::WorkingUnreadable, path);
+		}
+
+		const auto conflictIgnoreFlags = GIT_STATUS_IGNORED | GIT_STATUS_CONFLICTED;
+		if ((entry->status & conflictIgnoreFlags) != 0)
+		{
+			// libgit2 reports a subset of conflicts as two separate status entries with identical paths.
+			// One entry contains index_to_workdir and the other contains head_to_index.
+			auto delta = entry->index_to_workdir != nullptr ? entry->index_to_workdir : entry->head_to_index;
+			std::string_view path;
+			if (delta != nullptr)
+				path = delta->old_file.path != nullptr ? toPath(delta->old_file.path) : toPath(delta->new_file.path);
+
+			if ((entry->status & GIT_STATUS_IGNORED) == GIT_STATUS_IGNORED)
+				addUniquePath(Category::Ignored, ignoredPaths, path);
+			if ((entry->status & GIT_STATUS_CONFLICTED) == GIT_STATUS_CONFLICTED)
+				addUniquePath(Category::Conflicted, conflictedPaths, path);
+		}
+	}
+
+	status.Paths = builder.Build();
+	status.PathCounts = counts;
+}
+
+bool Git::GetStashList(Status& status, UniqueGitRepository& repository)
+{
+	std::vector<Stash> stashes;
+	auto result = git_stash_foreach(
+		repository.get(),
+		[](size_t index, const char* message, const git_oid *stash_id, void *payload)
+		{
+			if (payload == nullptr)
+				return -1;
+
+			char hashBuffer[40] = { 0 };
+			Stash stash = {
+				index,
+				{ git_oid_tostr(hashBuffer, sizeof(hashBuffer), stash_id) },
+				message
+			};
+
+			auto payloadAsStashes = reinterpret_cast<std::vector<Stash>*>(payload);
+			payloadAsStashes->emplace_back(std::move(stash));
+			return 0;
+		},
+		&stashes);
+
+	if (result != GIT_OK)
+	{
+		auto lastError = giterr_last();
+		//Log("Git.GetStashList.FailedToRetrieveStashList", Severity::Error)
+		//	<< R"(Failed to retrieve stash list. { "repositoryPath": ")" << status.RepositoryPath
+		//	<< R"(", "result": ")" << ConvertErrorCodeToString(static_cast<git_error_code>(result))
+		//	<< R"(", "lastError": ")" << (lastError == nullptr ? "null" : lastError->message) << R"(" })";
+		return false;
+	}
+
+	status.Stashes = std::move(stashes);
+	return true;
+}
+
+std::tuple<bool, std::string> Git::DiscoverRepository(const std::string& path)
+{
+	Git::Status status;
+	if (Git::DiscoverRepository(status, path))
+		return { true, std::move(status.RepositoryPath) };
+	return { false, std::string() };
+}
+
+std::tuple<bool, Git::Status> Git::GetStatus(const std::string& path, uint32_t parts, size_t maxPaths)
+{
+	Git::Status status;
+	if (!Git::DiscoverRepository(status, path))
+	{
+		return { false, Git::Status() };
+	}
+
+	auto repository = m_repositoryPool.Checkout(status.RepositoryPath);
+	if (repository.get() == nullptr && !Git::OpenRepository(repository, status.RepositoryPath))
+		return { false, Git::Status() };
+
+	if (git_repository_is_bare(repository.get()))
+	{
+		//Log("Git.GetGitStatus.BareRepository", Severity::Warning)
+		//	<< R"(Aborting due to bare repository. { "repositoryPath": ")" << status.RepositoryPath << R"(" })";
+		m_repositoryPool.Return(status.RepositoryPath, std::move(repository));
+		return { false, Git::Status() };
+	}
+
+	parts = Git::AddRequiredParts(parts);
+	status.ComputedParts = parts;
+	status.MaxPaths = maxPaths;
+
+	Git::GetWorkingDirectory(status, repository);
+	if ((parts & StatusParts::State) != 0)
+		Git::GetRepositoryState(status, repository);
+	if ((parts & StatusParts::Branch) != 0)
+		Git::GetRefStatus(status, repository, (parts & StatusParts::AheadBehind) != 0);
+	if ((parts & StatusParts::Stashes) != 0)
+		Git::GetStashList(status, repository);
+	if (!Git::GetFileStatus(status, repository, parts))
+		return { false, Git::Status() };
+
+	m_repositoryPool.Return(status.RepositoryPath, std::move(repository));
+	return { true, std::move(status) };
+}
+
+std::tuple<bool, Git::Status> Git::UpdateStatus(
+	const Git::Status& previousStatus,
+	uint32_t parts,
+	const std::vector<std::string>& changedPaths,
+	size_t maxPaths)
+{
+	Git::Status status = previousStatus;
+	// Path lists are patched in place, which needs random access to them.
+	if (status.Paths.IsFrontCoded())
+		status.Paths = status.Paths.Decode();
+
+	auto repository = m_repositoryPool.Checkout(status.RepositoryPath);
+	if (repository.get() == nullptr && !Git::OpenRepository(repository, status.RepositoryPath))
+		return { false, Git::Status() };
+
+	// Parts missing from the previous status are computed from scratch.
+	auto computedParts = Git::AddRequiredParts(previousStatus.ComputedParts | parts);
+	auto missingParts = computedParts & ~previousStatus.ComputedParts;
+	parts = (parts | missingParts) & computedParts;
+	status.ComputedParts = computedParts;
+
+	// Truncated path lists can't be patched or extended, so they're recomputed instead.
+	// The path limit is never lowered.
+	auto isTruncated = Git::IsFileStatusTruncated(previousStatus);
+	status.MaxPaths = (std::max)(previousStatus.MaxPaths, maxPaths);
+	if (isTruncated && status.MaxPaths > previousStatus.MaxPaths)
+		parts |= computedParts & (StatusParts::Index | StatusParts::WorkingTree);
+
+	// Branch naming depends on repository state, so state changes also recompute refs.
+	// Refs are recomputed with ahead/behind counts, since both come from the same lookup.
+	if ((parts & StatusParts::State) != 0)
+		Git::GetRepositoryState(status, repository);
+	if ((parts & (StatusParts::State | StatusParts::Branch | StatusParts::AheadBehind)) != 0 && (computedParts & StatusParts::Branch) != 0)
+		Git::GetRefStatus(status, repository, (computedParts & StatusParts::AheadBehind) != 0);
+	if ((parts & StatusParts::Stashes) != 0)
+		Git::GetStashList(status, repository);
+
+	if ((parts & StatusParts::Index) != 0
+		|| ((parts & StatusParts::WorkingTree) != 0 && (changedPaths.empty() || isTruncated || (missingParts & StatusParts::WorkingTree) != 0)))
+	{
+		Git::ClearFileStatus(status);
+		if (!Git::GetFileStatus(status, repository, computedParts))
+			return { false, Git::Status() };
+	}
+	else if ((parts & StatusParts::WorkingTree) != 0)
+	{
+		if (!Git::UpdateFileStatus(status, repository, changedPaths))
+			return { false, Git::Status() };
+	}
+
+	m_repositoryPool.Return(status.RepositoryPath, std::move(repository));
+	return { true, std::move(status) };
+}
+
+std::tuple<bool, Git::IgnoreSettings> Git::GetIgnoreSettings(const std::string& repositoryPath)
+{
+	auto repository = m_repositoryPool.Checkout(repositoryPath);
+	if (repository.get() == nullptr && !Git::OpenRepository(repository, repositoryPath))
+		return { false, IgnoreSettings() };
+
+	IgnoreSettings ignoreSettings;
+	{
+		auto config = MakeUniqueGitConfig(nullptr);
+		if (git_repository_config_snapshot(&config.get(), repository.get()) != GIT_OK)
+			return { false, IgnoreSettings() };
+
+		int ignoreCase;
+		if (git_config_get_bool(&ignoreCase, config.get(), "core.ignorecase") == GIT_OK)
+			ignoreSettings.IgnoreCase = ignoreCase != 0;
+
+		auto path = MakeUniqueGitBuffer(git_buf{ 0 });
+		if (git_config_get_path(&path.get(), config.get(), "core.excludesfile") == GIT_OK)
+		{
+			ignoreSettings.ExcludesFile = std::string(path.get().ptr, path.get().size);
+		}
+		else
+		{
+			// Like git, the default excludes file is in the XDG config directory whether or not
+			// a config file is there. Git for Windows uses the user profile when HOME isn't set.
+			auto configDirectory = std::filesystem::path(ReadEnvironmentVariable(L"XDG_CONFIG_HOME"));
+			if (configDirectory.empty())
+			{
+				auto homeDirectory = ReadEnvironmentVariable(L"HOME");
+				if (homeDirectory.empty())
+					homeDirectory = ReadEnvironmentVariable(L"USERPROFILE");
+				if (!homeDirectory.empty())
+					configDirectory = std::filesystem::path(homeDirectory) / L".config";
+			}
+			if (!configDirectory.empty())
+				ignoreSettings.ExcludesFile = ConvertToUtf8((configDirectory / L"git" / L"ignore").wstring());
+		}
+	}
+
+	m_repositoryPool.Return(repositoryPath, std::move(repository));
+	return { true, std::move(ignoreSettings) };
+}
+
+std::tuple<bool, std::unordered_set<std::string>> Git::FindTrackedPaths(const std::string& repositoryPath, const std::vector<std::string>& paths)
+{
+	auto repository = m_repositoryPool.Checkout(repositoryPath);
+	if (repository.get() == nullptr && !Git::OpenRepository(repository, repositoryPath))
+		return { false, std::unordered_set<std::string>() };
+
+	std::unordered_set<std::string> trackedPaths;
+	{
+		// Pooled repositories keep their index loaded, so it's reread only if it changed on disk.
+		auto index = MakeUniqueGitIndex(nullptr);
+		if (git_repository_index(&index.get(), repository.get()) != GIT_OK
+			|| git_index_read(index.get(), false /*force*/) != GIT_OK)
+		{
+			return { false, std::unordered_set<std::string>() };
+		}
+
+		// Conflicted paths only have entries in higher stages, so every stage is searched.
+		for (const auto& path : paths)
+		{
+			size_t position;
+			if (git_index_find(&position, index.get(), path.c_str()) == GIT_OK
+				|| git_index_find_prefix(&position, index.get(), (path + "/").c_str()) == GIT_OK)
+			{
+				trackedPaths.insert(path);
+			}
+		}
+	}
+
+	m_repositoryPool.Return(repositoryPath, std::move(repository));
+	return { true, std::move(trackedPaths) };
+}
+
+void Git::ReleaseRepository(const std::string& repositoryPath)
+{
+	m_repositoryPool.Release(repositoryPath);
+}
+
+void Git::ReleaseIdleRepositories()
+{
+	m_repositoryPool.ReleaseExpired();
+}
@@ -1,116 +1,321 @@
-#pragma once
-
-#include <string>
-#include <filesystem>
-#include <vector>
-
-/**
- * Performs git operations.
- */
-class Git
-{
-public:
-	struct Stash
-	{
-		uint64_t Index = 0;
-		std::string Sha1Id;
-		std::string Message;
-	};
-
-	struct Status
-	{
-		std::string RepositoryPath;
-		std::string WorkingDirectory;
-		std::string State;
-
-		std::string Branch;
-		std::string Upstream;
-		bool UpstreamGone = false;
-		size_t AheadBy = 0;
-		size_t BehindBy = 0;
-
-		std::vector<std::string> IndexAdded;
-		std::vector<std::string> IndexModified;
-		std::vector<std::string> IndexDeleted;
-		std::vector<std::string> IndexTypeChange;
-		std::vector<std::pair<std::string, std::string>> IndexRenamed;
-
-		std::vector<std::string> WorkingAdded;
-		std::vector<std::string> WorkingModified;
-		std::vector<std::string> WorkingDeleted;
-		std::vector<std::string> WorkingTypeChange;
-		std::vector<std::string> WorkingUnreadable;
-		std::vector<std::pair<std::string, std::string>> WorkingRenamed;
-
-		std::vector<std::string> Ignored;
-		std::vector<std::string> Conflicted;
-
-		std::vector<Stash> Stashes;
-	};
-
-private:
-	/**
-	* Searches for repository containing provided path and updates status.
-	*/
-	bool DiscoverRepository(Status& status, const std::string& path);
-
-	/**
-	* Retrieves the repository's working directory and updates status.
-	*/
-	bool GetWorkingDirectory(Status& status, UniqueGitRepository& repository);
-
-	/**
-	 * Retrieves current repository state based on current ongoing operation
-	 * (ex. rebase, cherry pick) and updates status.
-	 */
-	bool GetRepositoryState(Status& status, UniqueGitRepository& repository);
-
-	/**
-	 * Attempts to set the branch in the status to the current commit.
-	 */
-	bool SetBranchToCurrentCommit(Status& status);
-
-	/**
-	 * Attempts to set the branch in the status by parsing head-name.
-	 */
-	bool SetBranchFromHeadName(Status& status, const std::filesystem::path& path);
-
-	/**
-	* Attempts to set the branch in the status using the reference from .git/rebase-apply/head-name.
-	*/
-	bool SetBranchFromRebaseApplyHeadName(Status& status);
-
-	/**
-	* Attempts to set the branch in the status using the reference from .git/rebase-merge/head-name.
-	*/
-	bool SetBranchFromRebaseMergeHeadName(Status& status);
-
-	/**
-	* Retrieves the current branch/upstream and updates status.
-	*/
-	bool GetRefStatus(Status& status, UniqueGitRepository& repository);
-
-	/**
-	 * Retrieves file add/modify/delete statistics and updates status.
-	 */
-	bool GetFileStatus(Status& status, UniqueGitRepository& repository);
-
-	/**
-	 * Retrieves information about stashes and updates status.
-	 */
-	bool GetStashList(Status& status, UniqueGitRepository& repository);
-
-public:
-	Git();
-	~Git();
-
-	/**
-	* Searches for repository containing provided path and updates status.
-	*/
-	std::tuple<bool, std::string> DiscoverRepository(const std::string& path);
-
-	/**
-	 * Retrieves current git status for repository at provided path.
-	 */
-	std::tuple<bool, Git::Status> GetStatus(const std::string& path);
+#pragma once
+#include "AheadBehindCache.h"
+#include "RepositoryPool.h"
+#include "StatusPaths.h"
+
+#include <string>
+#include <unordered_set>
+#include <filesystem>
+#include <vector>
+
+/**
+ * Performs git operations.
+ */
+class Git
+{
+public:
+	struct Stash
+	{
+		uint64_t Index = 0;
+		std::string Sha1Id;
+		std::string Message;
+	};
+
+	/**
+	* Path limit of statuses that keep every path.
+	*/
+	static constexpr size_t UnlimitedPaths = SIZE_MAX;
+
+	struct Status
+	{
+		/**
+		* Parts of the status that were computed. See StatusParts. Fields belonging
+		* to other parts are left empty.
+		*/
+		uint32_t ComputedParts = 0;
+
+		std::string RepositoryPath;
+		std::string WorkingDirectory;
+		std::string State;
+
+		std::string Branch;
+		std::string Upstream;
+		bool UpstreamGone = false;
+		size_t AheadBy = 0;
+		size_t BehindBy = 0;
+
+		/**
+		* Path lists, such as IndexAdded or WorkingModified. See StatusPaths::Category.
+		*/
+		StatusPaths Paths;
+
+		/**
+		* Maximum number of paths kept in each path list. Paths beyond the limit are
+		* only counted in PathCounts.
+		*/
+		size_t MaxPaths = UnlimitedPaths;
+
+		/**
+		* Full length of each path list, indexed by StatusPaths::Category.
+		*/
+		StatusPaths::Counts PathCounts = {};
+
+		std::vector<Stash> Stashes;
+	};
+
+	/**
+	* Configuration of a repository that determines which paths it ignores.
+	*/
+	struct IgnoreSettings
+	{
+		/**
+		* Path of the excludes file, from core.excludesFile or git's default location.
+		* Empty if there is none.
+		*/
+		std::string ExcludesFile;
+
+		/**
+		* Whether core.ignoreCase is set, under which paths are matched case-insensitively.
+		*/
+		bool IgnoreCase = false;
+	};
+
+	/**
+	* Parts of a status that can be recomputed independently. Combined as a bitmask.
+	*/
+	struct StatusParts
+	{
+		static constexpr uint32_t None = 0;
+		static constexpr uint32_t Branch = 1 << 0;
+		static constexpr uint32_t AheadBehind = 1 << 1;
+		static constexpr uint32_t Stashes = 1 << 2;
+		static constexpr uint32_t State = 1 << 3;
+		static constexpr uint32_t Index = 1 << 4;
+		static constexpr uint32_t WorkingTree = 1 << 5;
+		static constexpr uint32_t All = Branch | AheadBehind | Stashes | State | Index | WorkingTree;
+	};
+
+private:
+	/**
+	* Repositories with fewer tracked files are always scanned on a single thread.
+	*/
+	static constexpr size_t MinParallelScanEntries = 10000;
+
+	RepositoryPool m_repositoryPool;
+	AheadBehindCache m_aheadBehindCache;
+	uint32_t m_scanThreads;
+
+	/**
+	* Adds the parts that provided parts can't be computed without.
+	*/
+	static uint32_t AddRequiredParts(uint32_t parts);
+
+	/**
+	* Opens repository at provided path.
+	*/
+	static bool OpenRepository(UniqueGitRepository& repository, const std::string& repositoryPath);
+
+	/**
+	* Searches for repository containing provided path and updates status.
+	*/
+	bool DiscoverRepository(Status& status, const std::string& path);
+
+	/**
+	* Retrieves the repository's working directory and updates status.
+	*/
+	bool GetWorkingDirectory(Status& status, UniqueGitRepository& repository);
+
+	/**
+	 * Retrieves current repository state based on current ongoing operation
+	 * (ex. rebase, cherry pick) and updates status.
+	 */
+	bool GetRepositoryState(Status& status, UniqueGitRepository& repository);
+
+	/**
+	 * Attempts to set the branch in the status to the current commit.
+	 */
+	bool SetBranchToCurrentCommit(Status& status);
+
+	/**
+	 * Attempts to set the branch in the status by parsing head-name.
+	 */
+	bool SetBranchFromHeadName(Status& status, const std::filesystem::path& path);
+
+	/**
+	* Attempts to set the branch in the status using the reference from .git/rebase-apply/head-name.
+	*/
+	bool SetBranchFromRebaseApplyHeadName(Status& status);
+
+	/**
+	* Attempts to set the branch in the status using the reference from .git/rebase-merge/head-name.
+	*/
+	bool SetBranchFromRebaseMergeHeadName(Status& status);
+
+	/**
+	* Retrieves the current branch/upstream and updates status.
+	*/
+	bool GetRefStatus(Status& status, UniqueGitRepository& repository, bool includeAheadBehind);
+
+	/**
+	* Retrieves how far the local branch is ahead of and behind its upstream. Counts are
+	* memoized by commit pair and updated incrementally when either side fast-forwards.
+	* Otherwise they're computed from the commit-graph file if available, falling back to
+	* a walk through libgit2.
+	*/
+	bool GetAheadBehind(
+		const Status& status,
+		UniqueGitRepository& repository,
+		const git_oid& localTarget,
+		const git_oid& upstreamTarget,
+		AheadBehindCache::Counts& counts);
+
+	/**
+	* Retrieves ahead/behind counts by walking the repository's commit-graph file, which
+	* avoids reading commits through the object database. Fails if there is no usable
+	* commit-graph file.
+	*/
+	static bool GetAheadBehindFromCommitGraph(
+		UniqueGitRepository& repository,
+		const AheadBehindCache::CommitPair& commitPair,
+		AheadBehindCache::Counts& counts);
+
+	/**
+	* Updates counts for a previous commit pair to counts for provided commit pair. Fails
+	* unless one side is unchanged and the other fast-forwarded.
+	*/
+	static bool UpdateAheadBehind(
+		UniqueGitRepository& repository,
+		const AheadBehindCache::CommitPair& previousCommitPair,
+		const AheadBehindCache::Counts& previousCounts,
+		const AheadBehindCache::CommitPair& commitPair,
+		AheadBehindCache::Counts& counts);
+
+	/**
+	* Counts commits reachable from provided commit but not from any hidden commit.
+	*/
+	static bool CountCommits(UniqueGitRepository& repository, const git_oid& commit, const std::vector<const git_oid*>& hiddenCommits, size_t& count);
+
+	/**
+	 * Retrieves file add/modify/delete statistics and updates status. Only the index and
+	 * working tree parts included in provided parts are retrieved.
+	 */
+	bool GetFileStatus(Status& status, UniqueGitRepository& repository, uint32_t parts);
+
+	/**
+	 * Splits the working directory's top-level entries into partitions of roughly equal
+	 * numbers of tracked files, one per scan thread. Returns no partitions if the
+	 * repository is too small to benefit from a parallel scan.
+	 */
+	std::vector<std::vector<std::string>> GetWorkingTreePartitions(const Status& status, UniqueGitRepository& repository);
+
+	/**
+	 * Retrieves file statistics, scanning each working tree partition on its own thread.
+	 * Entries are ordered as if retrieved by a single scan.
+	 */
+	bool GetFileStatusInParallel(
+		Status& status,
+		UniqueGitRepository& repository,
+		uint32_t parts,
+		const std::vector<std::vector<std::string>>& partitions);
+
+	/**
+	 * Retrieves working directory statistics for top-level entries in provided partition.
+	 * Opens its own repository, since repositories can't be shared between threads.
+	 */
+	std::tuple<bool, Git::Status> GetPartitionFileStatus(const std::string& repositoryPath, const std::vector<std::string>& partition);
+
+	/**
+	 * Adds the sorted union of provided category's paths in each of provided sources.
+	 * Each source's paths must be sorted.
+	 */
+	static void AddMergedPaths(StatusPaths::Builder& builder, uint8_t category, const std::vector<const StatusPaths*>& sources);
+
+	/**
+	 * Removes file statistics from status.
+	 */
+	static void ClearFileStatus(Status& status);
+
+	/**
+	 * Counts the paths in each of status' complete path lists and truncates them to its path limit.
+	 */
+	static void ApplyPathLimit(Status& status);
+
+	/**
+	 * Retrieves working directory statistics for provided paths only and patches them into status.
+	 * Paths are relative to the working directory and may name directories.
+	 */
+	bool UpdateFileStatus(Status& status, UniqueGitRepository& repository, const std::vector<std::string>& paths);
+
+	/**
+	 * Replaces status' file statistics with entries from status list created with provided options.
+	 */
+	bool CollectFileStatus(Status& status, UniqueGitRepository& repository, const git_status_options& statusOptions);
+
+	/**
+	 * Retrieves information about stashes and updates status.
+	 */
+	bool GetStashList(Status& status, UniqueGitRepository& repository);
+
+public:
+	Git(uint32_t scanThreads = 1);
+	~Git();
+
+	/**
+	* Searches for repository containing provided path and updates status.
+	*/
+	std::tuple<bool, std::string> DiscoverRepository(const std::string& path);
+
+	/**
+	 * Retrieves current git status for repository at provided path. Only provided parts,
+	 * and those they depend on, are computed.
+	 */
+	std::tuple<bool, Git::Status> GetStatus(
+		const std::string& path,
+		uint32_t parts = StatusParts::All,
+		size_t maxPaths = UnlimitedPaths);
+
+	/**
+	 * Recomputes the provided parts of a previously retrieved status. If the working tree part
+	 * is provided with changed paths, only those paths are rescanned. Paths are relative to the
+	 * working directory. Provided parts the previous status lacks are computed from scratch.
+	 * File statistics are recomputed in full if the previous status' path lists were truncated.
+	 */
+	std::tuple<bool, Git::Status> UpdateStatus(
+		const Git::Status& previousStatus,
+		uint32_t parts,
+		const std::vector<std::string>& changedPaths,
+		size_t maxPaths = UnlimitedPaths);
+
+	/**
+	* Checks if any of status' path lists were truncated to its path limit.
+	*/
+	static bool IsFileStatusTruncated(const Status& status);
+
+	/**
+	* Replaces status' file statistics with provided libgit2 status entries. libgit2 may report
+	* a conflict as two entries with the same path, so ignored and conflicted paths are only
+	* counted once.
+	*/
+	static void CollectFileStatus(Status& status, const std::vector<const git_status_entry*>& entries);
+
+	/**
+	* Retrieves the configuration determining which paths repository at provided path ignores.
+	*/
+	std::tuple<bool, IgnoreSettings> GetIgnoreSettings(const std::string& repositoryPath);
+
+	/**
+	* Retrieves which of provided paths are tracked in the index of repository at provided path,
+	* or are directories containing tracked files. Paths are relative to the working directory.
+	*/
+	std::tuple<bool, std::unordered_set<std::string>> FindTrackedPaths(const std::string& repositoryPath, const std::vector<std::string>& paths);
+
+	/**
+	* Closes pooled handles for repository at provided path.
+	*/
+	void ReleaseRepository(const std::string& repositoryPath);
+
+	/**
+	* Closes pooled handles that haven't been used recently.
+	*/
+	void ReleaseIdleRepositories();
 };
\ No newline at end of file
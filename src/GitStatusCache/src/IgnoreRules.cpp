@@ -0,0 +1,331 @@
+#include "stdafx.h"
+#include "IgnoreRules.h"
+#include "StringConverters.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	/**
+	* Folds ASCII letters to lowercase. Like git, case is only ignored for ASCII letters.
+	*/
+	char FoldCase(char character)
+	{
+		return 'A' <= character && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+	}
+
+	std::string FoldCase(std::string text)
+	{
+		for (auto& character : text)
+			character = FoldCase(character);
+		return text;
+	}
+}
+
+IgnoreRules::IgnoreRules(
+	const std::filesystem::path& workingDirectory,
+	const std::filesystem::path& repositoryDirectory,
+	const std::filesystem::path& excludesFile,
+	bool ignoreCase)
+	: m_workingDirectory(workingDirectory)
+	, m_excludesFile(excludesFile)
+	, m_ignoreCase(ignoreCase)
+	, m_excludesFileVersion(IgnoreRules::GetFileVersion(excludesFile))
+	, m_excludesFileRules(excludesFile.empty() ? RuleSet() : IgnoreRules::ReadRules(excludesFile, ignoreCase))
+	, m_infoExcludeRules(IgnoreRules::ReadRules(repositoryDirectory / L"info" / L"exclude", ignoreCase))
+{
+}
+
+/*static*/ std::tuple<uintmax_t, std::filesystem::file_time_type> IgnoreRules::GetFileVersion(const std::filesystem::path& path)
+{
+	if (path.empty())
+		return { 0, std::filesystem::file_time_type() };
+
+	// Failures return the same sentinel values each time, so missing files compare equal.
+	std::error_code error;
+	auto size = std::filesystem::file_size(path, error);
+	auto modifiedTime = std::filesystem::last_write_time(path, error);
+	return { size, modifiedTime };
+}
+
+bool IgnoreRules::IsExcludesFileChanged() const
+{
+	return IgnoreRules::GetFileVersion(m_excludesFile) != m_excludesFileVersion;
+}
+
+/*static*/ IgnoreRules::RuleSet IgnoreRules::ReadRules(const std::filesystem::path& path, bool ignoreCase)
+{
+	RuleSet rules;
+	std::ifstream file(path, std::ios::binary);
+	std::string line;
+	while (std::getline(file, line))
+		IgnoreRules::AddPattern(rules, line, ignoreCase);
+	return rules;
+}
+
+/*static*/ void IgnoreRules::AddPattern(RuleSet& rules, std::string_view line, bool ignoreCase)
+{
+	if (!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+
+	// Trailing spaces are dropped unless escaped with a backslash.
+	while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\'))
+		line.remove_suffix(1);
+
+	if (line.empty() || line.front() == '#')
+		return;
+
+	Pattern pattern;
+	if (line.front() == '!')
+	{
+		pattern.IsNegated = true;
+		line.remove_prefix(1);
+	}
+	if (!line.empty() && line.back() == '/')
+	{
+		pattern.IsDirectoryOnly = true;
+		line.remove_suffix(1);
+	}
+	if (line.find('/') != std::string_view::npos)
+	{
+		pattern.IsAnchored = true;
+		if (line.front() == '/')
+			line.remove_prefix(1);
+	}
+	if (line.empty())
+		return;
+
+	pattern.Text.assign(line.data(), line.size());
+	auto patternIndex = rules.Patterns.size();
+	if (pattern.Text.find_first_of("*?[\\") == std::string::npos)
+	{
+		auto literal = ignoreCase ? FoldCase(pattern.Text) : pattern.Text;
+		auto& literalMatch = pattern.IsAnchored ? rules.Paths[literal] : rules.Filenames[literal];
+		if (pattern.IsDirectoryOnly)
+			literalMatch.LastDirectoryPattern = patternIndex;
+		else
+			literalMatch.LastPattern = patternIndex;
+	}
+	else
+	{
+		rules.Globs.push_back(patternIndex);
+	}
+
+	rules.Patterns.push_back(std::move(pattern));
+}
+
+/*static*/ bool IgnoreRules::MatchBracket(const char*& pattern, char character, bool ignoreCase)
+{
+	auto current = pattern + 1;
+	auto isNegated = *current == '!' || *current == '^';
+	if (isNegated)
+		++current;
+
+	auto isMatch = false;
+	auto isFirst = true;
+	while (*current != '\0' && (*current != ']' || isFirst))
+	{
+		isFirst = false;
+
+		// Character classes such as [:alpha:] aren't supported. Patterns using them never match.
+		if (current[0] == '[' && current[1] == ':')
+			return false;
+
+		auto low = *current++;
+		if (low == '\\' && *current != '\0')
+			low = *current++;
+
+		auto high = low;
+		if (current[0] == '-' && current[1] != ']' && current[1] != '\0')
+		{
+			high = current[1];
+			current += 2;
+			if (high == '\\' && *current != '\0')
+				high = *current++;
+		}
+
+		auto isInRange = [low, high](char value)
+		{
+			return static_cast<unsigned char>(low) <= static_cast<unsigned char>(value)
+				&& static_cast<unsigned char>(value) <= static_cast<unsigned char>(high);
+		};
+		if (isInRange(character))
+			isMatch = true;
+
+		// Either case of a letter matches, so "[A-Z]" matches lowercase letters too.
+		auto lowercase = FoldCase(character);
+		auto uppercase = 'a' <= lowercase && lowercase <= 'z' ? static_cast<char>(lowercase - 'a' + 'A') : lowercase;
+		if (ignoreCase && (isInRange(lowercase) || isInRange(uppercase)))
+			isMatch = true;
+	}
+
+	if (*current != ']')
+		return false;
+
+	pattern = current + 1;
+	return isMatch != isNegated;
+}
+
+/*static*/ bool IgnoreRules::MatchGlob(const char* pattern, const char* text, const char* patternBegin, bool ignoreCase)
+{
+	while (*pattern != '\0')
+	{
+		switch (*pattern)
+		{
+		case '?':
+			if (*text == '\0' || *text == '/')
+				return false;
+			++pattern;
+			++text;
+			break;
+
+		case '[':
+			if (*text == '\0' || *text == '/' || !IgnoreRules::MatchBracket(pattern, *text, ignoreCase))
+				return false;
+			++text;
+			break;
+
+		case '*':
+		{
+			auto stars = pattern;
+			while (*pattern == '*')
+				++pattern;
+
+			auto isDirectoryWildcard = pattern - stars > 1
+				&& (stars == patternBegin || stars[-1] == '/')
+				&& (*pattern == '\0' || *pattern == '/');
+			if (isDirectoryWildcard)
+			{
+				if (*pattern == '\0')
+					return true;
+
+				// Leading or middle "**/" matches zero or more directories.
+				++pattern;
+				for (auto directory = text; ; ++directory)
+				{
+					if (IgnoreRules::MatchGlob(pattern, directory, patternBegin, ignoreCase))
+						return true;
+					directory = std::strchr(directory, '/');
+					if (directory == nullptr)
+						return false;
+				}
+			}
+
+			for (auto remainder = text; ; ++remainder)
+			{
+				if (IgnoreRules::MatchGlob(pattern, remainder, patternBegin, ignoreCase))
+					return true;
+				if (*remainder == '\0' || *remainder == '/')
+					return false;
+			}
+		}
+
+		case '\\':
+			if (pattern[1] != '\0')
+				++pattern;
+			// Escaped characters match literally.
+			[[fallthrough]];
+
+		default:
+			if (*pattern != *text && (!ignoreCase || FoldCase(*pattern) != FoldCase(*text)))
+				return false;
+			++pattern;
+			++text;
+			break;
+		}
+	}
+
+	return *text == '\0';
+}
+
+/*static*/ size_t IgnoreRules::Match(const RuleSet& rules, const std::string& path, bool isDirectory, bool ignoreCase)
+{
+	auto separator = path.find_last_of('/');
+	auto filename = separator == std::string::npos ? path : path.substr(separator + 1);
+
+	// Later patterns take precedence over earlier ones.
+	auto match = NoPattern;
+	auto addLiteralMatch = [&match, isDirectory](const std::unordered_map<std::string, LiteralMatch>& literals, const std::string& text)
+	{
+		auto literalMatch = literals.find(text);
+		if (literalMatch == literals.end())
+			return;
+
+		for (auto pattern : { literalMatch->second.LastPattern, isDirectory ? literalMatch->second.LastDirectoryPattern : NoPattern })
+		{
+			if (pattern != NoPattern && (match == NoPattern || pattern > match))
+				match = pattern;
+		}
+	};
+	addLiteralMatch(rules.Filenames, ignoreCase ? FoldCase(filename) : filename);
+	addLiteralMatch(rules.Paths, ignoreCase ? FoldCase(path) : path);
+
+	for (auto glob = rules.Globs.rbegin(); glob != rules.Globs.rend(); ++glob)
+	{
+		if (match != NoPattern && *glob < match)
+			break;
+
+		const auto& pattern = rules.Patterns[*glob];
+		if (pattern.IsDirectoryOnly && !isDirectory)
+			continue;
+
+		const auto& text = pattern.IsAnchored ? path : filename;
+		if (IgnoreRules::MatchGlob(pattern.Text.c_str(), text.c_str(), pattern.Text.c_str(), ignoreCase))
+		{
+			match = *glob;
+			break;
+		}
+	}
+
+	return match;
+}
+
+const IgnoreRules::RuleSet& IgnoreRules::GetDirectoryRules(const std::string& directory)
+{
+	auto directoryRules = m_directoryRules.find(directory);
+	if (directoryRules != m_directoryRules.end())
+		return directoryRules->second;
+
+	auto path = m_workingDirectory / ConvertToUnicode(directory + ".gitignore");
+	return m_directoryRules.emplace(directory, IgnoreRules::ReadRules(path, m_ignoreCase)).first->second;
+}
+
+bool IgnoreRules::IsExcluded(const std::string& path, bool isDirectory)
+{
+	// Deeper .gitignore files take precedence, followed by info/exclude and then core.excludesFile.
+	auto separator = path.find_last_of('/');
+	while (true)
+	{
+		auto directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+		const auto& rules = GetDirectoryRules(directory);
+		auto match = IgnoreRules::Match(rules, path.substr(directory.size()), isDirectory, m_ignoreCase);
+		if (match != NoPattern)
+			return !rules.Patterns[match].IsNegated;
+
+		if (separator == std::string::npos)
+			break;
+		separator = separator == 0 ? std::string::npos : path.find_last_of('/', separator - 1);
+	}
+
+	for (auto rules : { &m_infoExcludeRules, &m_excludesFileRules })
+	{
+		auto match = IgnoreRules::Match(*rules, path, isDirectory, m_ignoreCase);
+		if (match != NoPattern)
+			return !rules->Patterns[match].IsNegated;
+	}
+
+	return false;
+}
+
+bool IgnoreRules::IsIgnored(const std::string& path)
+{
+	// Paths beneath an excluded directory can't be included again, so parents are checked first.
+	for (auto separator = path.find('/'); separator != std::string::npos; separator = path.find('/', separator + 1))
+	{
+		if (IsExcluded(path.substr(0, separator), true /*isDirectory*/))
+			return true;
+	}
+
+	return IsExcluded(path, false /*isDirectory*/);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+/**
+* Compiled gitignore rules of a repository, used to recognize changes that can't affect its
+* status. Rules are read from core.excludesFile, info/exclude and the .gitignore file of each
+* directory. A directory's .gitignore file is read the first time a path beneath it is
+* matched, so only directories that see changes are read. Tracked files are never ignored
+* by git, so callers must still check whether ignored paths are tracked. Like git with
+* core.ignoreCase set, rules can match paths case-insensitively.
+* This class is not thread-safe.
+*/
+class IgnoreRules
+{
+private:
+	struct Pattern
+	{
+		std::string Text;
+		bool IsNegated = false;
+
+		/**
+		* Pattern ended with a slash and only matches directories.
+		*/
+		bool IsDirectoryOnly = false;
+
+		/**
+		* Pattern contained a slash and matches paths relative to its file's directory.
+		* Other patterns match the filename of paths at any depth.
+		*/
+		bool IsAnchored = false;
+	};
+
+	/**
+	* Last patterns matching a literal path or filename, if any.
+	*/
+	struct LiteralMatch
+	{
+		size_t LastPattern = NoPattern;
+		size_t LastDirectoryPattern = NoPattern;
+	};
+
+	/**
+	* Patterns of one ignore file. Patterns without wildcards are looked up by hash, and only
+	* patterns with wildcards are matched one at a time. Literals are lowercase when ignoring case.
+	*/
+	struct RuleSet
+	{
+		std::vector<Pattern> Patterns;
+		std::unordered_map<std::string, LiteralMatch> Filenames;
+		std::unordered_map<std::string, LiteralMatch> Paths;
+		std::vector<size_t> Globs;
+	};
+
+	static constexpr size_t NoPattern = SIZE_MAX;
+
+	std::filesystem::path m_workingDirectory;
+	std::filesystem::path m_excludesFile;
+	bool m_ignoreCase;
+
+	// Size and modification time of the excludes file when it was read. The excludes file is
+	// usually outside the repository, so changes to it aren't reported.
+	std::tuple<uintmax_t, std::filesystem::file_time_type> m_excludesFileVersion;
+	RuleSet m_excludesFileRules;
+	RuleSet m_infoExcludeRules;
+
+	// Rules of .gitignore files by directory relative to the working directory, with a trailing
+	// slash. The working directory itself is the empty string.
+	std::unordered_map<std::string, RuleSet> m_directoryRules;
+
+	/**
+	* Retrieves the size and modification time of a file. Missing files have the same values
+	* each time.
+	*/
+	static std::tuple<uintmax_t, std::filesystem::file_time_type> GetFileVersion(const std::filesystem::path& path);
+
+	/**
+	* Parses the patterns of an ignore file. Missing files have no patterns.
+	*/
+	static RuleSet ReadRules(const std::filesystem::path& path, bool ignoreCase);
+
+	/**
+	* Adds a line of an ignore file to rules. Blank lines and comments are skipped.
+	*/
+	static void AddPattern(RuleSet& rules, std::string_view line, bool ignoreCase);
+
+	/**
+	* Matches text against a glob. Wildcards don't match slashes, except for "**" between slashes,
+	* which matches any number of directories.
+	*/
+	static bool MatchGlob(const char* pattern, const char* text, const char* patternBegin, bool ignoreCase);
+
+	/**
+	* Matches text against a bracket expression, such as "[a-z]". Advances pattern past it.
+	* Fails if the expression isn't terminated.
+	*/
+	static bool MatchBracket(const char*& pattern, char character, bool ignoreCase);
+
+	/**
+	* Retrieves the last pattern of rules matching path, or NoPattern. Path is relative to the
+	* directory of the rules' file.
+	*/
+	static size_t Match(const RuleSet& rules, const std::string& path, bool isDirectory, bool ignoreCase);
+
+	/**
+	* Retrieves the rules of provided directory's .gitignore file, reading it if needed.
+	*/
+	const RuleSet& GetDirectoryRules(const std::string& directory);
+
+	/**
+	* Checks if the rules exclude path itself, without considering its parent directories.
+	*/
+	bool IsExcluded(const std::string& path, bool isDirectory);
+
+public:
+	/**
+	* Reads info/exclude and provided excludes file. Excludes file may be empty.
+	*/
+	IgnoreRules(
+		const std::filesystem::path& workingDirectory,
+		const std::filesystem::path& repositoryDirectory,
+		const std::filesystem::path& excludesFile,
+		bool ignoreCase);
+	IgnoreRules(const IgnoreRules&) = delete;
+
+	/**
+	* Checks if the excludes file changed since it was read, in which case the rules must be
+	* compiled again.
+	*/
+	bool IsExcludesFileChanged() const;
+
+	/**
+	* Checks if path, relative to the working directory with forward slashes, is ignored.
+	* Paths are ignored if they or any parent directory match. Paths are matched as files, since
+	* removed paths can't be inspected, so patterns only matching directories don't apply to
+	* changes of the directories themselves.
+	*/
+	bool IsIgnored(const std::string& path);
+};
@@ -1,89 +1,154 @@
-#include "stdafx.h"
-#include "DirectoryMonitor.h"
-#include "NamedPipeServer.h"
-#include "Service.h"
-#include "StatusCache.h"
-#include "StatusController.h"
-
-int IsService(void)
-{
-	BOOL		member;
-	PSID		ServiceSid;
-	PSID		LocalSystemSid;
-	SID_IDENTIFIER_AUTHORITY NtAuthority = { SECURITY_NT_AUTHORITY };
-
-	/* First check for LocalSystem */
-	if (!AllocateAndInitializeSid(&NtAuthority, 1,
-		SECURITY_LOCAL_SYSTEM_RID, 0, 0, 0, 0, 0, 0, 0,
-		&LocalSystemSid))
-	{
-		return -1;
-	}
-
-	if (!CheckTokenMembership(NULL, LocalSystemSid, &member))
-	{
-		FreeSid(LocalSystemSid);
-		return -1;
-	}
-	FreeSid(LocalSystemSid);
-
-	if (member)
-	{
-		return 1;
-	}
-
-	/* Check for service group membership */
-	if (!AllocateAndInitializeSid(&NtAuthority, 1,
-		SECURITY_SERVICE_RID, 0, 0, 0, 0, 0, 0, 0,
-		&ServiceSid))
-	{
-		return -1;
-	}
-
-	if (!CheckTokenMembership(NULL, ServiceSid, &member))
-	{
-		FreeSid(ServiceSid);
-		return -1;
-	}
-	FreeSid(ServiceSid);
-
-	return member;
-}
-
-int main(int argc, char** argv)
-{
-	if (argv[1] != NULL)
-	{
-		if (_strcmpi(argv[1], "install") == 0)
-		{
-			SvcInstall();
-			return 0;
-		}
-
-		if (_strcmpi(argv[1], "uninstall") == 0)
-		{
-			SvcUninstall();
-			return 0;
-		}
-
-		if (_strcmpi(argv[1], "debug") == 0)
-		{
-			StatusController statusController;
-			NamedPipeServer server([&statusController](const std::string & request) { return statusController.HandleRequest(request); });
-
-			statusController.WaitForShutdownRequest();
-			return 0;
-		}
-	}
-
-	if (IsService() == 1) {
-		return SvcStart();
-	}
-
-	// Usage
-	printf("%s install - installs the service\n", argv[0]);
-	printf("%s uninstall - uninstalls the service\n", argv[0]);
-	printf("%s debug - runs the main loop\n", argv[0]);
-
-	return 1;
-}
+#include "stdafx.h"
+#include "DirectoryMonitor.h"
+#include "NamedPipeServer.h"
+#include "Options.h"
+#include "Service.h"
+#include "StatusCache.h"
+#include "StatusController.h"
+
+int IsService(void)
+{
+	BOOL		member;
+	PSID		ServiceSid;
+	PSID		LocalSystemSid;
+	SID_IDENTIFIER_AUTHORITY NtAuthority = { SECURITY_NT_AUTHORITY };
+
+	/* First check for LocalSystem */
+	if (!AllocateAndInitializeSid(&NtAuthority, 1,
+		SECURITY_LOCAL_SYSTEM_RID, 0, 0, 0, 0, 0, 0, 0,
+		&LocalSystemSid))
+	{
+		return -1;
+	}
+
+	if (!CheckTokenMembership(NULL, LocalSystemSid, &member))
+	{
+		FreeSid(LocalSystemSid);
+		return -1;
+	}
+	FreeSid(LocalSystemSid);
+
+	if (member)
+	{
+		return 1;
+	}
+
+	/* Check for service group membership */
+	if (!AllocateAndInitializeSid(&NtAuthority, 1,
+		SECURITY_SERVICE_RID, 0, 0, 0, 0, 0, 0, 0,
+		&ServiceSid))
+	{
+		return -1;
+	}
+
+	if (!CheckTokenMembership(NULL, ServiceSid, &member))
+	{
+		FreeSid(ServiceSid);
+		return -1;
+	}
+	FreeSid(ServiceSid);
+
+	return member;
+}
+
+/**
+ * Appends option to the arguments forwarded to the installed service.
+ */
+void AppendArgument(std::string& arguments, const char* argument)
+{
+	if (!arguments.empty())
+		arguments += " ";
+	arguments += argument;
+}
+
+/**
+ * Parses options from the command line. Recognized options are also collected
+ * into arguments so that install can forward them to the service.
+ */
+Options ParseOptions(int argc, char** argv, std::string& arguments)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (_strcmpi(argv[i], "--allow-stale") == 0)
+		{
+			options.AllowStaleStatus = true;
+			AppendArgument(arguments, argv[i]);
+		}
+		else if (_strcmpi(argv[i], "--memory-budget-mb") == 0 && i + 1 < argc)
+		{
+			options.MemoryBudgetBytes = std::strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024;
+			AppendArgument(arguments, argv[i]);
+			AppendArgument(arguments, argv[++i]);
+		}
+		else if (_strcmpi(argv[i], "--snapshot-file") == 0 && i + 1 < argc)
+		{
+			options.SnapshotPath = argv[i + 1];
+			auto quotedPath = "\"" + options.SnapshotPath + "\"";
+			AppendArgument(arguments, argv[i]);
+			AppendArgument(arguments, quotedPath.c_str());
+			++i;
+		}
+		else if (_strcmpi(argv[i], "--scan-threads") == 0 && i + 1 < argc)
+		{
+			options.ScanThreads = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+			AppendArgument(arguments, argv[i]);
+			AppendArgument(arguments, argv[++i]);
+		}
+		else if (_strcmpi(argv[i], "--front-code-paths") == 0)
+		{
+			options.FrontCodePaths = true;
+			AppendArgument(arguments, argv[i]);
+		}
+	}
+
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	std::string arguments;
+	auto options = ParseOptions(argc, argv, arguments);
+
+	if (argv[1] != NULL)
+	{
+		if (_strcmpi(argv[1], "install") == 0)
+		{
+			SvcInstall(arguments);
+			return 0;
+		}
+
+		if (_strcmpi(argv[1], "uninstall") == 0)
+		{
+			SvcUninstall();
+			return 0;
+		}
+
+		if (_strcmpi(argv[1], "debug") == 0)
+		{
+			StatusController statusController(options);
+			NamedPipeServer server([&statusController](const std::string & request) { return statusController.HandleRequest(request); });
+
+			statusController.WaitForShutdownRequest();
+			return 0;
+		}
+	}
+
+	if (IsService() == 1) {
+		return SvcStart(options);
+	}
+
+	// Usage
+	printf("%s install - installs the service\n", argv[0]);
+	printf("%s uninstall - uninstalls the service\n", argv[0]);
+	printf("%s debug - runs the main loop\n", argv[0]);
+	printf("\n");
+	printf("options (accepted by install and debug):\n");
+	printf("  --allow-stale - serve invalidated status flagged as stale while it is refreshed\n");
+	printf("  --memory-budget-mb <megabytes> - evict least recently used status beyond this size\n");
+	printf("  --snapshot-file <path> - persist cached status to this file and restore it on startup\n");
+	printf("  --scan-threads <count> - scan large working directories on this many threads, 0 for one per core\n");
+	printf("  --front-code-paths - store cached paths prefix compressed to reduce memory\n");
+
+	return 1;
+}
@@ -1,179 +1,179 @@
-#include "stdafx.h"
-#include "NamedPipeInstance.h"
-
-void NamedPipeInstance::OnClientRequest()
-{
-	//Log("NamedPipeInstance.OnClientRequest.Start", Severity::Verbose) << "Request servicing thread started.";
-
-	while (true)
-	{
-		auto [ result, data ] = ReadRequest();
-		if (result != IoResult::Success)
-		{
-			break;
-		}
-
-		//Log("NamedPipeInstance.OnClientRequest.Request", Severity::Spam)
-		//	<< R"(Received request from client. { "request": ")" << readResult.second << R"(" })";
-
-		auto response = m_onClientRequestCallback(data);
-
-		//Log("NamedPipeInstance.OnClientRequest.Response", Severity::Spam)
-		//	<< R"(Sending response to client. { "response": ")" << response << R"(" })";
-
-		result = WriteResponse(response);
-		if (result != IoResult::Success)
-		{
-			break;
-		}
-	}
-
-	::FlushFileBuffers(m_pipe);
-	::DisconnectNamedPipe(m_pipe);
-	m_pipe.invoke();
-	m_isClosed = true;
-
-	//Log("NamedPipeInstance.OnClientRequest.Stop", Severity::Verbose) << "Request servicing thread stopping.";
-}
-
-NamedPipeInstance::ReadResult NamedPipeInstance::ReadRequest()
-{
-	auto requestBuffer = std::vector<char>(BufferSize);
-	DWORD bytesRead = 0;
-	auto readResult = ::ReadFile(
-		m_pipe,
-		requestBuffer.data(),
-		(DWORD)requestBuffer.capacity(),
-		&bytesRead,
-		nullptr /*lpOverlapped*/);
-
-	if (!readResult || bytesRead == 0)
-	{
-		auto error = ::GetLastError();
-		if (error == ERROR_BROKEN_PIPE)
-		{
-			//Log("NamedPipeInstance.ReadRequest.Disconnect", Severity::Verbose)
-			//	<< "Client disconnected. ReadFile returned ERROR_BROKEN_PIPE.";
-			return { IoResult::Aborted, "" };
-		}
-		else if (error == ERROR_OPERATION_ABORTED)
-		{
-			//Log("NamedPipeInstance.ReadRequest.Aborted", Severity::Verbose) << "ReadFile returned ERROR_OPERATION_ABORTED.";
-			return { IoResult::Aborted, "" };
-		}
-		else
-		{
-			//Log("NamedPipeInstance.ReadRequest.UnknownError", Severity::Error)
-			//	<< R"(ReadFile failed with unexpected error. { "error": )" << error << R"( })";
-			//throw std::runtime_error("ReadFile failed unexpectedly.");
-			return { IoResult::Error, "" };
-		}
-	}
-
-	return { IoResult::Success, { requestBuffer.data(), bytesRead / sizeof(char) } };
-}
-
-NamedPipeInstance::IoResult NamedPipeInstance::WriteResponse(const std::string& response)
-{
-	DWORD bytesWritten = 0;
-	auto writeResult = ::WriteFile(
-		m_pipe,
-		response.data(),
-		(DWORD)response.size(),
-		&bytesWritten,
-		nullptr /*lpOverlapped*/);
-
-	if (!writeResult || bytesWritten != response.size())
-	{
-		auto error = ::GetLastError();
-		if (error == ERROR_BROKEN_PIPE)
-		{
-			//Log("NamedPipeInstance.WriteResponse.Disconnect", Severity::Verbose)
-			//	<< "Client disconnected. WriteFile returned ERROR_BROKEN_PIPE.";
-			return IoResult::Aborted;
-		}
-		else if (error == ERROR_OPERATION_ABORTED)
-		{
-			//Log("NamedPipeInstance.WriteResponse.Aborted", Severity::Verbose) << "WriteFile returned ERROR_OPERATION_ABORTED.";
-			return IoResult::Aborted;
-		}
-		else
-		{
-			//Log("NamedPipeInstance.WriteResponse.UnknownError", Severity::Error)
-			//	<< R"(WriteFile failed with unexpected error. { "error": )" << error << R"( })";
-			//throw std::runtime_error("WriteFile failed unexpectedly.");
-			return IoResult::Error;
-		}
-	}
-
-	return IoResult::Success;
-}
-
-NamedPipeInstance::NamedPipeInstance(SECURITY_ATTRIBUTES* sa, const OnClientRequestCallback& onClientRequestCallback)
-	: m_onClientRequestCallback(onClientRequestCallback)
-	, m_pipe(MakeUniqueHandle(INVALID_HANDLE_VALUE))
-{
-	auto pipeMode = PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
-	auto timeout = 0;
-	auto pipe = ::CreateNamedPipe(
-		L"\\\\.\\pipe\\GitStatusCache",
-		PIPE_ACCESS_DUPLEX,
-		pipeMode,
-		PIPE_UNLIMITED_INSTANCES,
-		(DWORD)BufferSize,
-		(DWORD)BufferSize,
-		timeout,
-		sa);
-
-	if (pipe == INVALID_HANDLE_VALUE)
-	{
-		//Log("NamedPipeInstance.Create", Severity::Error) << "Failed to create named pipe instance.";
-		throw std::runtime_error("Failed to create named pipe instance.");
-	}
-	m_pipe = MakeUniqueHandle(pipe);
-}
-
-NamedPipeInstance::~NamedPipeInstance()
-{
-	if (m_thread.joinable())
-	{
-		if (!m_isClosed)
-		{
-			//Log("NamedPipeInstance.ShutDown.StoppingBackgroundThread", Severity::Spam)
-			//	<< R"(Shutting down request servicing thread. { "threadId": 0x)" << std::hex << m_thread.get_id() << " }";
-			::CancelSynchronousIo(m_thread.native_handle());
-		}
-		m_thread.join();
-	}
-}
-
-NamedPipeInstance::IoResult NamedPipeInstance::Connect()
-{
-	auto connected = ::ConnectNamedPipe(m_pipe, nullptr /*lpOverlapped*/);
-	if (connected || ::GetLastError() == ERROR_PIPE_CONNECTED)
-	{
-		//Log("NamedPipeInstance.Connect.Success", Severity::Spam) << "ConnectNamedPipe succeeded.";
-
-		std::call_once(m_flag, [this]()
-		{
-			//Log("NamedPipeInstance.StartingBackgroundThread", Severity::Spam)
-			//	<< "Attempting to start background thread for servicing requests.";
-			m_thread = std::thread(&NamedPipeInstance::OnClientRequest, this);
-		});
-
-		return IoResult::Success;
-	}
-
-	auto error = GetLastError();
-	if (error == ERROR_OPERATION_ABORTED)
-	{
-		//Log("NamedPipeInstance.Connect.Aborted", Severity::Verbose) << "ConnectNamedPipe returned ERROR_OPERATION_ABORTED.";
-		return IoResult::Aborted;
-	}
-
-	//Log("NamedPipeInstance.Connect.UnknownError", Severity::Error)
-	//	<< R"(ConnectNamedPipe failed with unexpected error. { "error": )" << error << R"( })";
-	throw std::runtime_error("ConnectNamedPipe failed unexpectedly.");
-
-	return IoResult::Error;
-}
+#include "stdafx.h"
+#include "NamedPipeInstance.h"
+
+void NamedPipeInstance::OnClientRequest()
+{
+	//Log("NamedPipeInstance.OnClientRequest.Start", Severity::Verbose) << "Request servicing thread started.";
+
+	while (true)
+	{
+		auto [ result, data ] = ReadRequest();
+		if (result != IoResult::Success)
+		{
+			break;
+		}
+
+		//Log("NamedPipeInstance.OnClientRequest.Request", Severity::Spam)
+		//	<< R"(Received request from client. { "request": ")" << readResult.second << R"(" })";
+
+		auto response = m_onClientRequestCallback(data);
+
+		//Log("NamedPipeInstance.OnClientRequest.Response", Severity::Spam)
+		//	<< R"(Sending response to client. { "response": ")" << response << R"(" })";
+
+		result = WriteResponse(response);
+		if (result != IoResult::Success)
+		{
+			break;
+		}
+	}
+
+	::FlushFileBuffers(m_pipe);
+	::DisconnectNamedPipe(m_pipe);
+	m_pipe.invoke();
+	m_isClosed = true;
+
+	//Log("NamedPipeInstance.OnClientRequest.Stop", Severity::Verbose) << "Request servicing thread stopping.";
+}
+
+NamedPipeInstance::ReadResult NamedPipeInstance::ReadRequest()
+{
+	auto requestBuffer = std::vector<char>(BufferSize);
+	DWORD bytesRead = 0;
+	auto readResult = ::ReadFile(
+		m_pipe,
+		requestBuffer.data(),
+		(DWORD)requestBuffer.capacity(),
+		&bytesRead,
+		nullptr /*lpOverlapped*/);
+
+	if (!readResult || bytesRead == 0)
+	{
+		auto error = ::GetLastError();
+		if (error == ERROR_BROKEN_PIPE)
+		{
+			//Log("NamedPipeInstance.ReadRequest.Disconnect", Severity::Verbose)
+			//	<< "Client disconnected. ReadFile returned ERROR_BROKEN_PIPE.";
+			return { IoResult::Aborted, "" };
+		}
+		else if (error == ERROR_OPERATION_ABORTED)
+		{
+			//Log("NamedPipeInstance.ReadRequest.Aborted", Severity::Verbose) << "ReadFile returned ERROR_OPERATION_ABORTED.";
+			return { IoResult::Aborted, "" };
+		}
+		else
+		{
+			//Log("NamedPipeInstance.ReadRequest.UnknownError", Severity::Error)
+			//	<< R"(ReadFile failed with unexpected error. { "error": )" << error << R"( })";
+			//throw std::runtime_error("ReadFile failed unexpectedly.");
+			return { IoResult::Error, "" };
+		}
+	}
+
+	return { IoResult::Success, { requestBuffer.data(), bytesRead / sizeof(char) } };
+}
+
+NamedPipeInstance::IoResult NamedPipeInstance::WriteResponse(const std::string& response)
+{
+	DWORD bytesWritten = 0;
+	auto writeResult = ::WriteFile(
+		m_pipe,
+		response.data(),
+		(DWORD)response.size(),
+		&bytesWritten,
+		nullptr /*lpOverlapped*/);
+
+	if (!writeResult || bytesWritten != response.size())
+	{
+		auto error = ::GetLastError();
+		if (error == ERROR_BROKEN_PIPE)
+		{
+			//Log("NamedPipeInstance.WriteResponse.Disconnect", Severity::Verbose)
+			//	<< "Client disconnected. WriteFile returned ERROR_BROKEN_PIPE.";
+			return IoResult::Aborted;
+		}
+		else if (error == ERROR_OPERATION_ABORTED)
+		{
+			//Log("NamedPipeInstance.WriteResponse.Aborted", Severity::Verbose) << "WriteFile returned ERROR_OPERATION_ABORTED.";
+			return IoResult::Aborted;
+		}
+		else
+		{
+			//Log("NamedPipeInstance.WriteResponse.UnknownError", Severity::Error)
+			//	<< R"(WriteFile failed with unexpected error. { "error": )" << error << R"( })";
+			//throw std::runtime_error("WriteFile failed unexpectedly.");
+			return IoResult::Error;
+		}
+	}
+
+	return IoResult::Success;
+}
+
+NamedPipeInstance::NamedPipeInstance(SECURITY_ATTRIBUTES* sa, const OnClientRequestCallback& onClientRequestCallback)
+	: m_onClientRequestCallback(onClientRequestCallback)
+	, m_pipe(MakeUniqueHandle(INVALID_HANDLE_VALUE))
+{
+	auto pipeMode = PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
+	auto timeout = 0;
+	auto pipe = ::CreateNamedPipe(
+		L"\\\\.\\pipe\\GitStatusCache",
+		PIPE_ACCESS_DUPLEX,
+		pipeMode,
+		PIPE_UNLIMITED_INSTANCES,
+		(DWORD)BufferSize,
+		(DWORD)BufferSize,
+		timeout,
+		sa);
+
+	if (pipe == INVALID_HANDLE_VALUE)
+	{
+		//Log("NamedPipeInstance.Create", Severity::Error) << "Failed to create named pipe instance.";
+		throw std::runtime_error("Failed to create named pipe instance.");
+	}
+	m_pipe = MakeUniqueHandle(pipe);
+}
+
+NamedPipeInstance::~NamedPipeInstance()
+{
+	if (m_thread.joinable())
+	{
+		if (!m_isClosed)
+		{
+			//Log("NamedPipeInstance.ShutDown.StoppingBackgroundThread", Severity::Spam)
+			//	<< R"(Shutting down request servicing thread. { "threadId": 0x)" << std::hex << m_thread.get_id() << " }";
+			::CancelSynchronousIo(m_thread.native_handle());
+		}
+		m_thread.join();
+	}
+}
+
+NamedPipeInstance::IoResult NamedPipeInstance::Connect()
+{
+	auto connected = ::ConnectNamedPipe(m_pipe, nullptr /*lpOverlapped*/);
+	if (connected || ::GetLastError() == ERROR_PIPE_CONNECTED)
+	{
+		//Log("NamedPipeInstance.Connect.Success", Severity::Spam) << "ConnectNamedPipe succeeded.";
+
+		std::call_once(m_flag, [this]()
+		{
+			//Log("NamedPipeInstance.StartingBackgroundThread", Severity::Spam)
+			//	<< "Attempting to start background thread for servicing requests.";
+			m_thread = std::thread(&NamedPipeInstance::OnClientRequest, this);
+		});
+
+		return IoResult::Success;
+	}
+
+	auto error = GetLastError();
+	if (error == ERROR_OPERATION_ABORTED)
+	{
+		//Log("NamedPipeInstance.Connect.Aborted", Severity::Verbose) << "ConnectNamedPipe returned ERROR_OPERATION_ABORTED.";
+		return IoResult::Aborted;
+	}
+
+	//Log("NamedPipeInstance.Connect.UnknownError", Severity::Error)
+	//	<< R"(ConnectNamedPipe failed with unexpected error. { "error": )" << error << R"( })";
+	throw std::runtime_error("ConnectNamedPipe failed unexpectedly.");
+
+	return IoResult::Error;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/**
+* Settings controlling the cache's behavior. Specified on the command line.
+*/
+struct Options
+{
+	/**
+	* Serve invalidated statuses flagged as stale while they are recomputed in the
+	* background, instead of recomputing them synchronously. Set by --allow-stale.
+	*/
+	bool AllowStaleStatus = false;
+
+	/**
+	* Approximate upper bound on memory held by cached statuses. Least recently used
+	* repositories are evicted when exceeded. Zero means unbounded. Set by --memory-budget-mb.
+	*/
+	uint64_t MemoryBudgetBytes = 0;
+
+	/**
+	* File in which cached statuses are persisted on shutdown and every five minutes,
+	* and from which they are restored on startup. Empty disables persistence.
+	* Set by --snapshot-file.
+	*/
+	std::string SnapshotPath;
+
+	/**
+	* Number of threads scanning the working directory when computing a full status of a
+	* large repository. Zero uses one thread per core. Set by --scan-threads.
+	*/
+	uint32_t ScanThreads = 1;
+
+	/**
+	* Store cached path lists front coded, which trades decoding on each serialization for
+	* memory. Set by --front-code-paths.
+	*/
+	bool FrontCodePaths = false;
+};
\ No newline at end of file
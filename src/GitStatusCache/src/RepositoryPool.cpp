@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "RepositoryPool.h"
+
+RepositoryPool::RepositoryPool(size_t capacity, std::chrono::steady_clock::duration idleTimeout)
+	: m_capacity(capacity)
+	, m_idleTimeout(idleTimeout)
+{
+}
+
+UniqueGitRepository RepositoryPool::Checkout(const std::string& repositoryPath)
+{
+	LockGuard lock(m_mutex);
+	for (auto idleRepository = m_idleRepositories.rbegin(); idleRepository != m_idleRepositories.rend(); ++idleRepository)
+	{
+		if (idleRepository->RepositoryPath != repositoryPath)
+			continue;
+
+		auto repository = std::move(idleRepository->Repository);
+		m_idleRepositories.erase(std::next(idleRepository).base());
+		return repository;
+	}
+
+	return MakeUniqueGitRepository(nullptr);
+}
+
+void RepositoryPool::Return(const std::string& repositoryPath, UniqueGitRepository&& repository)
+{
+	if (repository.get() == nullptr || m_capacity == 0)
+		return;
+
+	// Repositories are closed outside the lock, when these go out of scope.
+	auto returnedRepository = std::move(repository);
+	auto closedRepository = MakeUniqueGitRepository(nullptr);
+	{
+		LockGuard lock(m_mutex);
+		if (m_idleRepositories.size() >= m_capacity)
+		{
+			closedRepository = std::move(m_idleRepositories.front().Repository);
+			m_idleRepositories.pop_front();
+		}
+
+		m_idleRepositories.push_back({ repositoryPath, std::move(returnedRepository), std::chrono::steady_clock::now() });
+	}
+}
+
+void RepositoryPool::Release(const std::string& repositoryPath)
+{
+	std::deque<IdleRepository> releasedRepositories;
+	{
+		LockGuard lock(m_mutex);
+		auto released = std::stable_partition(
+			m_idleRepositories.begin(),
+			m_idleRepositories.end(),
+			[&repositoryPath](const IdleRepository& idleRepository) { return idleRepository.RepositoryPath != repositoryPath; });
+		std::move(released, m_idleRepositories.end(), std::back_inserter(releasedRepositories));
+		m_idleRepositories.erase(released, m_idleRepositories.end());
+	}
+
+	//Log("RepositoryPool.Release", Severity::Verbose)
+	//	<< R"(Closed pooled repositories. { "repositoryPath": ")" << repositoryPath
+	//	<< R"(", "count": )" << releasedRepositories.size() << " }";
+}
+
+void RepositoryPool::ReleaseExpired()
+{
+	std::deque<IdleRepository> releasedRepositories;
+	{
+		LockGuard lock(m_mutex);
+		auto now = std::chrono::steady_clock::now();
+		while (!m_idleRepositories.empty() && now - m_idleRepositories.front().ReturnedAt > m_idleTimeout)
+		{
+			releasedRepositories.push_back(std::move(m_idleRepositories.front()));
+			m_idleRepositories.pop_front();
+		}
+	}
+}
+
+void RepositoryPool::Clear()
+{
+	std::deque<IdleRepository> releasedRepositories;
+	{
+		LockGuard lock(m_mutex);
+		releasedRepositories.swap(m_idleRepositories);
+	}
+}
\ No newline at end of file
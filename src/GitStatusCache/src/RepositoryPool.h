@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+
+/**
+* Bounded pool of open repositories keyed by repository path. Reusing repositories
+* preserves libgit2's parsed config, reference database, object database and caches
+* across status computations. A checked out repository is owned exclusively by the
+* calling thread until it is returned. This class is thread-safe.
+*/
+class RepositoryPool
+{
+private:
+	using LockGuard = std::lock_guard<std::mutex>;
+
+	/**
+	* Repository waiting in the pool to be checked out.
+	*/
+	struct IdleRepository
+	{
+		std::string RepositoryPath;
+		UniqueGitRepository Repository;
+		std::chrono::steady_clock::time_point ReturnedAt;
+	};
+
+	size_t m_capacity;
+	std::chrono::steady_clock::duration m_idleTimeout;
+
+	// Ordered from least to most recently returned.
+	std::deque<IdleRepository> m_idleRepositories;
+	std::mutex m_mutex;
+
+public:
+	RepositoryPool(size_t capacity, std::chrono::steady_clock::duration idleTimeout);
+	RepositoryPool(const RepositoryPool&) = delete;
+
+	/**
+	* Removes an idle repository for provided path from the pool.
+	* Returns an empty handle if none is available.
+	*/
+	UniqueGitRepository Checkout(const std::string& repositoryPath);
+
+	/**
+	* Returns repository to the pool. The least recently returned repository
+	* is closed if the pool is full.
+	*/
+	void Return(const std::string& repositoryPath, UniqueGitRepository&& repository);
+
+	/**
+	* Closes idle repositories for provided path. Used to release file handles
+	* held on the repository, for example before git deletes pack files.
+	*/
+	void Release(const std::string& repositoryPath);
+
+	/**
+	* Closes repositories that have been idle for longer than the idle timeout.
+	*/
+	void ReleaseExpired();
+
+	/**
+	* Closes all idle repositories.
+	*/
+	void Clear();
+};
\ No newline at end of file
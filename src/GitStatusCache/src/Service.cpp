@@ -18,9 +18,10 @@ static SERVICE_TABLE_ENTRY ServiceDispatchTable[] = {
 SERVICE_STATUS          gSvcStatus;
 SERVICE_STATUS_HANDLE   gSvcStatusHandle;
 
+Options gOptions;
 std::unique_ptr<StatusController> gStatusController;
 
-void SvcInstall()
+void SvcInstall(const std::string& arguments)
 {
 	SC_HANDLE schManager;
 	SC_HANDLE schService;
@@ -32,7 +33,14 @@ void SvcInstall()
 		copied = GetModuleFileName(0, &pathBuffer[0], MAX_PATH);
 	} while (copied >= pathBuffer.size());
 
-	std::basic_string<TCHAR> szPath(pathBuffer.begin(), pathBuffer.end());
+	std::basic_string<TCHAR> szPath(TEXT("\""));
+	szPath.append(&pathBuffer[0], copied);
+	szPath.append(TEXT("\""));
+	if (!arguments.empty())
+	{
+		szPath.append(TEXT(" "));
+		szPath.append(CA2T(arguments.c_str()));
+	}
 
 	schManager = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
 
@@ -257,18 +265,25 @@ void WINAPI SvcMain(DWORD argc, LPWSTR* argv)
 
 	ReportSvcStatus(SERVICE_START_PENDING, NO_ERROR, 3000);
 
-	gStatusController = std::make_unique<StatusController>();
-	NamedPipeServer server([](const std::string & request) { return gStatusController->HandleRequest(request); });
+	gStatusController = std::make_unique<StatusController>(gOptions);
+	{
+		NamedPipeServer server([](const std::string & request) { return gStatusController->HandleRequest(request); });
+
+		ReportSvcStatus(SERVICE_RUNNING, NO_ERROR, 0);
 
-	ReportSvcStatus(SERVICE_RUNNING, NO_ERROR, 0);
+		gStatusController->WaitForShutdownRequest();
+	}
 
-	gStatusController->WaitForShutdownRequest();
+	// Release the cache before reporting stopped so it can persist its snapshot.
+	gStatusController.reset();
 
 	ReportSvcStatus(SERVICE_STOPPED, NO_ERROR, 0);
 }
 
-int SvcStart()
+int SvcStart(const Options& options)
 {
+	gOptions = options;
+
 	if (!StartServiceCtrlDispatcher(ServiceDispatchTable)) {
 		// TODO: Logging
 		return 1;
@@ -1,6 +1,7 @@
 #pragma once
+#include "Options.h"
 
-void SvcInstall();
+void SvcInstall(const std::string& arguments);
 void SvcUninstall();
 
-int SvcStart();
\ No newline at end of file
+int SvcStart(const Options& options);
\ No newline at end of file
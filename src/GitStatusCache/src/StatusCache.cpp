@@ -1,22 +1,142 @@
-#include "stdafx.h"
-#include "StatusCache.h"
-
-StatusCache::StatusCache()
-	: m_cache(std::make_shared<Cache>())
-	, m_cacheInvalidator(m_cache)
-{
-}
-
-std::tuple<bool, Git::Status> StatusCache::GetStatus(const std::string& repositoryPath)
-{
-	auto status = m_cache->GetStatus(repositoryPath);
-	if (std::get<0>(status))
-		m_cacheInvalidator.MonitorRepositoryDirectories(std::get<1>(status));
-
-	return status;
-}
-
-CacheStatistics StatusCache::GetCacheStatistics()
-{
-	return m_cache->GetCacheStatistics();
+#include "stdafx.h"
+#include "StatusCache.h"
+#include "CacheSnapshot.h"
+
+StatusCache::StatusCache(const Options& options)
+	: m_cache(std::make_shared<Cache>(options))
+	, m_cacheInvalidator(m_cache)
+	, m_snapshotPath(options.SnapshotPath)
+	, m_stopSnapshotThread(MakeUniqueHandle(INVALID_HANDLE_VALUE))
+{
+	m_cacheInvalidator.SetOnRepositoriesChangedCallback(
+		[this]
+		{
+			WriteLock writeLock(m_repositoryPathsMutex);
+			m_repositoryPaths.clear();
+			++m_repositoryPathsVersion;
+		});
+
+	if (m_snapshotPath.empty())
+		return;
+
+	LoadSnapshot();
+
+	auto stopSnapshotThread = ::CreateEvent(
+		nullptr /*lpEventAttributes*/,
+		true    /*manualReset*/,
+		false   /*bInitialState*/,
+		nullptr /*lpName*/);
+	if (stopSnapshotThread == nullptr)
+	{
+		//Log("StatusCache.StartingSnapshotThread.CreateEventFailed", Severity::Error)
+		//	<< "Failed to create event to signal thread on exit.";
+		throw std::runtime_error("CreateEvent failed unexpectedly.");
+	}
+	m_stopSnapshotThread = MakeUniqueHandle(stopSnapshotThread);
+	m_snapshotThread = std::thread(&StatusCache::WaitForSnapshotTimerExpiration, this);
+}
+
+StatusCache::~StatusCache()
+{
+	if (!m_snapshotThread.joinable())
+		return;
+
+	::SetEvent(m_stopSnapshotThread);
+	m_snapshotThread.join();
+	SaveSnapshot();
+}
+
+void StatusCache::LoadSnapshot()
+{
+	auto snapshot = CacheSnapshot::Read(m_snapshotPath);
+	if (!std::get<0>(snapshot))
+		return;
+
+	for (const auto& entry : std::get<1>(snapshot))
+	{
+		m_cache->RestoreCacheEntry(entry.Status, entry.IsStale);
+		m_cacheInvalidator.MonitorRepositoryDirectories(*entry.Status);
+		if (entry.IsStale)
+			m_cacheInvalidator.RefreshStaleCacheEntry(entry.Status->RepositoryPath);
+		else
+			m_cacheInvalidator.VerifyRestoredCacheEntry(entry.Status->RepositoryPath);
+	}
+
+	//Log("StatusCache.LoadSnapshot", Severity::Info)
+	//	<< R"(Loaded cache snapshot. { "entries": )" << std::get<1>(snapshot).size() << " }";
+}
+
+void StatusCache::SaveSnapshot()
+{
+	auto monitoredRepositories = m_cacheInvalidator.GetMonitoredRepositories();
+
+	std::vector<CacheSnapshot::Entry> entries;
+	for (const auto& cachedStatus : m_cache->GetCachedStatuses())
+	{
+		if (monitoredRepositories.find(cachedStatus.Status->RepositoryPath) == monitoredRepositories.end())
+			continue;
+
+		CacheSnapshot::Entry entry;
+		entry.Status = cachedStatus.Status;
+		entry.IsStale = cachedStatus.IsStale;
+		entries.push_back(std::move(entry));
+	}
+
+	CacheSnapshot::Write(m_snapshotPath, entries);
+}
+
+void StatusCache::WaitForSnapshotTimerExpiration()
+{
+	//Log("StatusCache.WaitForSnapshotTimerExpiration.Start", Severity::Verbose) << "Thread for cache snapshots started.";
+
+	while (::WaitForSingleObject(m_stopSnapshotThread, 5 * 60 * 1000 /*dwMilliseconds*/) == WAIT_TIMEOUT)
+		SaveSnapshot();
+
+	//Log("StatusCache.WaitForSnapshotTimerExpiration.Stop", Severity::Verbose) << "Thread for cache snapshots stopping.";
+}
+
+std::tuple<bool, std::string> StatusCache::DiscoverRepository(const std::string& path)
+{
+	uint64_t version = 0;
+	{
+		ReadLock readLock(m_repositoryPathsMutex);
+		auto repositoryPath = m_repositoryPaths.find(path);
+		if (repositoryPath != m_repositoryPaths.end())
+			return { true, repositoryPath->second };
+		version = m_repositoryPathsVersion;
+	}
+
+	auto repositoryPath = m_git.DiscoverRepository(path);
+	if (!std::get<0>(repositoryPath))
+		return repositoryPath;
+
+	{
+		// Don't remember results of searches that raced with a repository being created or removed.
+		WriteLock writeLock(m_repositoryPathsMutex);
+		if (version != m_repositoryPathsVersion)
+			return repositoryPath;
+
+		if (m_repositoryPaths.size() >= MaxRepositoryPaths)
+			m_repositoryPaths.clear();
+		m_repositoryPaths[path] = std::get<1>(repositoryPath);
+	}
+
+	return repositoryPath;
+}
+
+CachedStatus StatusCache::GetStatus(const std::string& repositoryPath, uint32_t parts, size_t maxPaths)
+{
+	auto status = m_cache->GetStatus(repositoryPath, parts, maxPaths);
+	if (status.Success)
+		m_cacheInvalidator.MonitorRepositoryDirectories(*status.Status);
+
+	if (status.IsStale)
+		m_cacheInvalidator.RefreshStaleCacheEntry(repositoryPath);
+
+	return status;
+}
+
+CacheStatistics StatusCache::GetCacheStatistics()
+{
+	return m_cache->GetCacheStatistics();
 }
\ No newline at end of file
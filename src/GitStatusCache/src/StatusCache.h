@@ -1,28 +1,77 @@
-#pragma once
-#include "Cache.h"
-#include "CacheInvalidator.h"
-
-/**
- * Caches git status information. This class is thread-safe.
- */
-class StatusCache
-{
-private:
-	std::shared_ptr<Cache> m_cache;
-	CacheInvalidator m_cacheInvalidator;
-
-public:
-	StatusCache();
-	StatusCache(const StatusCache&) = delete;
-
-	/**
-	* Retrieves current git status for repository at provided path.
-	* Returns from cache if present, otherwise queries git and adds to cache.
-	*/
-	std::tuple<bool, Git::Status> GetStatus(const std::string& repositoryPath);
-
-	/**
-	* Returns information about cache's performance.
-	*/
-	CacheStatistics GetCacheStatistics();
+#pragma once
+#include "Cache.h"
+#include "CacheInvalidator.h"
+#include "Options.h"
+
+#include <filesystem>
+#include <shared_mutex>
+#include <thread>
+
+/**
+ * Caches git status information. This class is thread-safe.
+ */
+class StatusCache
+{
+private:
+	using ReadLock = std::shared_lock<std::shared_mutex>;
+	using WriteLock = std::unique_lock<std::shared_mutex>;
+
+	static constexpr size_t MaxRepositoryPaths = 4096;
+
+	Git m_git;
+	std::unordered_map<std::string, std::string> m_repositoryPaths;
+	uint64_t m_repositoryPathsVersion = 0;
+	std::shared_mutex m_repositoryPathsMutex;
+
+	std::shared_ptr<Cache> m_cache;
+	CacheInvalidator m_cacheInvalidator;
+
+	std::filesystem::path m_snapshotPath;
+	UniqueHandle m_stopSnapshotThread;
+	std::thread m_snapshotThread;
+
+	/**
+	* Loads statuses from the snapshot and resumes monitoring their repositories.
+	* Statuses for repositories that changed since the snapshot was written are refreshed.
+	* Others are served as is and verified in the background.
+	*/
+	void LoadSnapshot();
+
+	/**
+	* Writes statuses for all monitored repositories to the snapshot.
+	*/
+	void SaveSnapshot();
+
+	/**
+	* Reserves thread for periodically writing the snapshot until cache shuts down.
+	*/
+	void WaitForSnapshotTimerExpiration();
+
+public:
+	StatusCache(const Options& options);
+	StatusCache(const StatusCache&) = delete;
+	~StatusCache();
+
+	/**
+	* Searches for repository containing provided path. Successful searches are remembered
+	* until a repository is created or removed under a monitored directory.
+	*/
+	std::tuple<bool, std::string> DiscoverRepository(const std::string& path);
+
+	/**
+	* Retrieves current git status for repository at provided path.
+	* Returns from cache if present, otherwise queries git and adds to cache.
+	* Stale statuses returned from the cache are refreshed in the background.
+	* Only provided parts of the status, with up to provided number of paths in each path
+	* list, are guaranteed to be computed.
+	*/
+	CachedStatus GetStatus(
+		const std::string& repositoryPath,
+		uint32_t parts = Git::StatusParts::All,
+		size_t maxPaths = Git::UnlimitedPaths);
+
+	/**
+	* Returns information about cache's performance.
+	*/
+	CacheStatistics GetCacheStatistics();
 };
\ No newline at end of file
@@ -1,231 +1,466 @@
-#include "stdafx.h"
-#include "StatusController.h"
-
-#include <cstring>
-
-constexpr uint32_t VERSION = 1;
-
-StatusController::StatusController()
-	: m_requestShutdown(MakeUniqueHandle(INVALID_HANDLE_VALUE))
-{
-	auto requestShutdown = ::CreateEvent(
-		nullptr /*lpEventAttributes*/,
-		true    /*manualReset*/,
-		false   /*bInitialState*/,
-		nullptr /*lpName*/);
-	if (requestShutdown == nullptr)
-	{
-		//Log("StatusController.Constructor.CreateEventFailed", Severity::Error)
-		//	<< "Failed to create event to signal shutdown request.";
-		throw std::runtime_error("CreateEvent failed unexpectedly.");
-	}
-	m_requestShutdown = MakeUniqueHandle(requestShutdown);
-}
-
-StatusController::~StatusController()
-{
-	// signal m_requestShutdown just in case
-	Shutdown();
-}
-
-/*static*/ std::string StatusController::CreateErrorResponse(const std::string& request, std::string&& error, std::exception *e)
-{
-	//Log("StatusController.FailedRequest", Severity::Warning)
-	//	<< R"(Failed to service request. { "error": ")" << error << R"(", "request": ")" << request << R"(" })";
-	nlohmann::json document {
-		{ "Version", VERSION },
-		{ "Error", error }
-	};
-
-	if (e != nullptr)
-	{
-		document["Exception"] = e->what();
-	}
-
-	return document.dump();
-}
-
-void StatusController::RecordGetStatusTime(uint64_t nanosecondsInGetStatus)
-{
-	WriteLock writeLock{m_getStatusStatisticsMutex};
-	++m_totalGetStatusCalls;
-	m_totalNanosecondsInGetStatus += nanosecondsInGetStatus;
-	m_minNanosecondsInGetStatus = (std::min)(nanosecondsInGetStatus, m_minNanosecondsInGetStatus);
-	m_maxNanosecondsInGetStatus = (std::max)(nanosecondsInGetStatus, m_maxNanosecondsInGetStatus);
-}
-
-std::string StatusController::GetStatus(const nlohmann::json& document, const std::string& request)
-{
-	if (!document["Path"].is_string())
-	{
-		return CreateErrorResponse(request, "'Path' must be specified.");
-	}
-	auto path = document["Path"].get<std::string>();
-
-	auto repositoryPath = m_git.DiscoverRepository(path);
-	if (!std::get<0>(repositoryPath))
-	{
-		return CreateErrorResponse(request, "Requested 'Path' is not part of a git repository.");
-	}
-
-	auto status = m_cache.GetStatus(std::get<1>(repositoryPath));
-	if (!std::get<0>(status))
-	{
-		return CreateErrorResponse(request, "Failed to retrieve status of git repository at provided 'Path'.");
-	}
-
-	auto& statusToReport = std::get<1>(status);
-
-	nlohmann::json response{
-		{ "Version", VERSION },
-		{ "Path", path },
-		{ "RepoPath", statusToReport.RepositoryPath },
-		{ "WorkingDir", statusToReport.WorkingDirectory },
-		{ "State", statusToReport.State },
-		{ "Branch", statusToReport.Branch },
-		{ "Upstream", statusToReport.Upstream },
-		{ "UpstreamGone", statusToReport.UpstreamGone },
-		{ "AheadBy", statusToReport.AheadBy },
-		{ "BehindBy", statusToReport.BehindBy },
-		{ "IndexAdded", statusToReport.IndexAdded },
-		{ "IndexModified", statusToReport.IndexModified },
-		{ "IndexDeleted", statusToReport.IndexDeleted },
-		{ "IndexTypeChange", statusToReport.IndexTypeChange },
-		{ "IndexRenamed", nlohmann::json::array() },
-		{ "WorkingAdded", statusToReport.WorkingAdded },
-		{ "WorkingModified", statusToReport.WorkingModified },
-		{ "WorkingDeleted", statusToReport.WorkingDeleted },
-		{ "WorkingTypeChange", statusToReport.WorkingTypeChange },
-		{ "WorkingRenamed", nlohmann::json::array() },
-		{ "WorkingUnreadable", statusToReport.WorkingUnreadable },
-		{ "Ignored", statusToReport.Ignored },
-		{ "Conflicted", statusToReport.Conflicted },
-		{ "Stashes", nlohmann::json::array() }
-	};
-
-	for (const auto& value : statusToReport.IndexRenamed)
-	{
-		response["IndexRenamed"].push_back({
-			{ "Old", value.first },
-			{ "New", value.second }
-		});
-	}
-
-	for (const auto& value : statusToReport.WorkingRenamed)
-	{
-		response["WorkingRenamed"].push_back({
-			{ "Old", value.first },
-			{ "New", value.second }
-		});
-	}
-
-	for (const auto& value : statusToReport.Stashes)
-	{
-		response["Stashes"].push_back({
-			{ "Name", "stash@{" + std::to_string(value.Index) + "}" },
-			{ "Sha1Id", value.Sha1Id },
-			{ "Message", value.Message }
-		});
-	}
-
-	return response.dump();
-}
-
-std::string StatusController::GetCacheStatistics()
-{
-	auto statistics = m_cache.GetCacheStatistics();
-
-	static const int nanosecondsPerMillisecond = 1000000;
-	uint64_t totalGetStatusCalls;
-	uint64_t totalNanosecondsInGetStatus;
-	uint64_t minNanosecondsInGetStatus;
-	uint64_t maxNanosecondsInGetStatus;
-	{
-		ReadLock readLock{m_getStatusStatisticsMutex};
-		totalGetStatusCalls = m_totalGetStatusCalls;
-		totalNanosecondsInGetStatus = m_totalNanosecondsInGetStatus;
-		minNanosecondsInGetStatus = m_minNanosecondsInGetStatus;
-		maxNanosecondsInGetStatus = m_maxNanosecondsInGetStatus;
-	}
-	
-	auto averageNanosecondsInGetStatus = totalGetStatusCalls != 0 ? totalNanosecondsInGetStatus / totalGetStatusCalls : 0;
-	auto averageMillisecondsInGetStatus = static_cast<double>(averageNanosecondsInGetStatus) / nanosecondsPerMillisecond;
-	auto minMillisecondsInGetStatus = static_cast<double>(minNanosecondsInGetStatus) / nanosecondsPerMillisecond;
-	auto maxMillisecondsInGetStatus = static_cast<double>(maxNanosecondsInGetStatus) / nanosecondsPerMillisecond;
-
-	nlohmann::json response {
-		{ "Version", VERSION },
-		{ "TotalGetStatusRequests", totalGetStatusCalls },
-		{ "AverageMillisecondsInGetStatus", averageMillisecondsInGetStatus },
-		{ "MinimumMillisecondsInGetStatus", minMillisecondsInGetStatus },
-		{ "MaximumMillisecondsInGetStatus", maxMillisecondsInGetStatus },
-		{ "CacheHits",  statistics.CacheHits },
-		{ "CacheMisses", statistics.CacheMisses },
-		{ "EffectiveCachePrimes", statistics.CacheEffectivePrimeRequests },
-		{ "TotalCachePrimes", statistics.CacheTotalPrimeRequests },
-		{ "EffectiveCacheInvalidations", statistics.CacheEffectiveInvalidationRequests },
-		{ "TotalCacheInvalidations", statistics.CacheTotalInvalidationRequests },
-		{ "FullCacheInvalidations", statistics.CacheInvalidateAllRequests }
-	};
-
-	return response.dump();
-}
-
-void StatusController::Shutdown()
-{
-	//Log("StatusController.Shutdown", Severity::Info) << R"(Shutting down due to client request.")";
-	::SetEvent(m_requestShutdown);
-}
-
-std::string StatusController::HandleRequest(const std::string& request)
-{
-	nlohmann::json document;
-	try
-	{
-		document = nlohmann::json::parse(request);
-	}
-	catch (nlohmann::json::parse_error &e)
-	{
-		return CreateErrorResponse(request, "Request must be valid JSON.", &e);
-	}
-
-	if (!document["Version"].is_number())
-		return CreateErrorResponse(request, "'Version' must be specified.");
-
-	if (document["Version"] != 1)
-		return CreateErrorResponse(request, "Requested 'Version' unknown.");
-
-	if (!document["Action"].is_string())
-		return CreateErrorResponse(request, "'Action' must be specified.");
-	auto action = document["Action"].get<std::string>();
-
-	if (_strcmpi(action.c_str(), "GetStatus") == 0)
-	{
-		auto start = std::chrono::steady_clock::now();
-		auto result = GetStatus(document, request);
-		RecordGetStatusTime((start - std::chrono::steady_clock::now()).count());
-		return result;
-	}
-
-	if (_strcmpi(action.c_str(), "GetCacheStatistics") == 0)
-		return GetCacheStatistics();
-
-	if (_strcmpi(action.c_str(), "Shutdown") == 0)
-	{
-		Shutdown();
-		nlohmann::json response{
-			{ "Version", VERSION },
-			{ "Result", "Shutting down." }
-		};
-
-		return response.dump();
-	}
-		
-
-	return CreateErrorResponse(request, "'Action' unrecognized.");
-}
-
-void StatusController::WaitForShutdownRequest()
-{
-	::WaitForSingleObject(m_requestShutdown, INFINITE);
+#include "stdafx.h"
+#include "StatusController.h"
+
+#include <cstring>
+
+constexpr uint32_t VERSION = 1;
+
+namespace
+{
+	/**
+	* Name of a GetStatus response field and the status parts needed to fill it.
+	*/
+	struct StatusFieldDefinition
+	{
+		const char* Name;
+		uint32_t Field;
+		uint32_t Parts;
+	};
+
+	/**
+	* Serialized statuses aren't pruned until there are at least this many.
+	*/
+	const size_t MinSerializedStatusesToPrune = 64;
+}
+
+StatusController::StatusController(const Options& options)
+	: m_serializedStatusesToPrune(MinSerializedStatusesToPrune)
+	, m_cache(options)
+	, m_requestShutdown(MakeUniqueHandle(INVALID_HANDLE_VALUE))
+{
+	auto requestShutdown = ::CreateEvent(
+		nullptr /*lpEventAttributes*/,
+		true    /*manualReset*/,
+		false   /*bInitialState*/,
+		nullptr /*lpName*/);
+	if (requestShutdown == nullptr)
+	{
+		//Log("StatusController.Constructor.CreateEventFailed", Severity::Error)
+		//	<< "Failed to create event to signal shutdown request.";
+		throw std::runtime_error("CreateEvent failed unexpectedly.");
+	}
+	m_requestShutdown = MakeUniqueHandle(requestShutdown);
+}
+
+StatusController::~StatusController()
+{
+	// signal m_requestShutdown just in case
+	Shutdown();
+}
+
+/*static*/ std::string StatusController::CreateErrorResponse(const std::string& request, std::string&& error, std::exception *e)
+{
+	//Log("StatusController.FailedRequest", Severity::Warning)
+	//	<< R"(Failed to service request. { "error": ")" << error << R"(", "request": ")" << request << R"(" })";
+	nlohmann::json document {
+		{ "Version", VERSION },
+		{ "Error", error }
+	};
+
+	if (e != nullptr)
+	{
+		document["Exception"] = e->what();
+	}
+
+	return document.dump();
+}
+
+void StatusController::RecordGetStatusTime(uint64_t nanosecondsInGetStatus)
+{
+	WriteLock writeLock{m_getStatusStatisticsMutex};
+	++m_totalGetStatusCalls;
+	m_totalNanosecondsInGetStatus += nanosecondsInGetStatus;
+	m_minNanosecondsInGetStatus = (std::min)(nanosecondsInGetStatus, m_minNanosecondsInGetStatus);
+	m_maxNanosecondsInGetStatus = (std::max)(nanosecondsInGetStatus, m_maxNanosecondsInGetStatus);
+}
+
+/*static*/ bool StatusController::ParseStatusFields(const nlohmann::json& document, uint32_t& fields, uint32_t& parts)
+{
+	using StatusParts = Git::StatusParts;
+	static const StatusFieldDefinition fieldDefinitions[] = {
+		{ "RepoPath", 0, StatusParts::None },
+		{ "WorkingDir", 0, StatusParts::None },
+		{ "State", StatusFields::State, StatusParts::State },
+		{ "Branch", StatusFields::Branch, StatusParts::Branch },
+		{ "Upstream", StatusFields::Upstream, StatusParts::Branch },
+		{ "UpstreamGone", StatusFields::UpstreamGone, StatusParts::Branch },
+		{ "AheadBy", StatusFields::AheadBy, StatusParts::AheadBehind },
+		{ "BehindBy", StatusFields::BehindBy, StatusParts::AheadBehind },
+		{ "IndexAdded", StatusFields::IndexAdded, StatusParts::Index },
+		{ "IndexModified", StatusFields::IndexModified, StatusParts::Index },
+		{ "IndexDeleted", StatusFields::IndexDeleted, StatusParts::Index },
+		{ "IndexTypeChange", StatusFields::IndexTypeChange, StatusParts::Index },
+		{ "IndexRenamed", StatusFields::IndexRenamed, StatusParts::Index },
+		{ "WorkingAdded", StatusFields::WorkingAdded, StatusParts::WorkingTree },
+		{ "WorkingModified", StatusFields::WorkingModified, StatusParts::WorkingTree },
+		{ "WorkingDeleted", StatusFields::WorkingDeleted, StatusParts::WorkingTree },
+		{ "WorkingTypeChange", StatusFields::WorkingTypeChange, StatusParts::WorkingTree },
+		{ "WorkingRenamed", StatusFields::WorkingRenamed, StatusParts::WorkingTree },
+		{ "WorkingUnreadable", StatusFields::WorkingUnreadable, StatusParts::WorkingTree },
+		{ "Ignored", StatusFields::Ignored, StatusParts::WorkingTree },
+		// Conflicts are reported by both the index and working tree comparisons.
+		{ "Conflicted", StatusFields::Conflicted, StatusParts::Index | StatusParts::WorkingTree },
+		{ "Stashes", StatusFields::Stashes, StatusParts::Stashes }
+	};
+
+	fields = StatusFields::All;
+	parts = StatusParts::All;
+	auto requestedFields = document.find("Fields");
+	if (requestedFields == document.end())
+		return true;
+
+	if (!requestedFields->is_array())
+		return false;
+
+	fields = 0;
+	parts = StatusParts::None;
+	for (const auto& requestedField : *requestedFields)
+	{
+		if (!requestedField.is_string())
+			return false;
+
+		auto name = requestedField.get<std::string>();
+		auto fieldDefinition = std::find_if(
+			std::begin(fieldDefinitions),
+			std::end(fieldDefinitions),
+			[&name](const StatusFieldDefinition& definition) { return name == definition.Name; });
+		if (fieldDefinition == std::end(fieldDefinitions))
+			return false;
+
+		fields |= fieldDefinition->Field;
+		parts |= fieldDefinition->Parts;
+	}
+
+	return true;
+}
+
+/*static*/ bool StatusController::ParseStatusDetail(const nlohmann::json& document, StatusDetail& detail)
+{
+	detail = StatusDetail();
+	auto requestedDetail = document.find("Detail");
+	if (requestedDetail == document.end())
+		return true;
+
+	if (!requestedDetail->is_string())
+		return false;
+
+	auto name = requestedDetail->get<std::string>();
+	if (_strcmpi(name.c_str(), "Full") == 0)
+		return true;
+
+	if (_strcmpi(name.c_str(), "Counts") == 0)
+	{
+		detail.IncludePaths = false;
+		detail.IncludeCounts = true;
+		detail.MaxPaths = 0;
+		return true;
+	}
+
+	if (_strcmpi(name.c_str(), "Capped") == 0)
+	{
+		auto maxPaths = document.find("MaxPaths");
+		if (maxPaths == document.end() || !maxPaths->is_number_unsigned())
+			return false;
+
+		detail.IncludeCounts = true;
+		detail.MaxPaths = maxPaths->get<size_t>();
+		return true;
+	}
+
+	return false;
+}
+
+/*static*/ std::string StatusController::SerializeStatus(const Git::Status& status, uint32_t fields, const StatusDetail& detail)
+{
+	nlohmann::json response{
+		{ "Version", VERSION },
+		{ "RepoPath", status.RepositoryPath },
+		{ "WorkingDir", status.WorkingDirectory }
+	};
+
+	auto isRequested = [fields](uint32_t field) { return (fields & field) != 0; };
+	auto serializePaths = [&response, &detail, &status](const std::string& name, uint8_t category)
+	{
+		if (detail.IncludePaths)
+		{
+			auto values = nlohmann::json::array();
+			if (StatusPaths::IsRenamedCategory(category))
+			{
+				status.Paths.ForEachRenamed(category, detail.MaxPaths, [&values](std::string_view oldPath, std::string_view newPath)
+				{
+					values.push_back({
+						{ "Old", std::string(oldPath) },
+						{ "New", std::string(newPath) }
+					});
+				});
+			}
+			else
+			{
+				status.Paths.ForEach(category, detail.MaxPaths, [&values](std::string_view path) { values.push_back(std::string(path)); });
+			}
+			response[name] = std::move(values);
+		}
+		if (detail.IncludeCounts)
+			response[name + "Count"] = status.PathCounts[category];
+	};
+
+	if (isRequested(StatusFields::State))
+		response["State"] = status.State;
+	if (isRequested(StatusFields::Branch))
+		response["Branch"] = status.Branch;
+	if (isRequested(StatusFields::Upstream))
+		response["Upstream"] = status.Upstream;
+	if (isRequested(StatusFields::UpstreamGone))
+		response["UpstreamGone"] = status.UpstreamGone;
+	if (isRequested(StatusFields::AheadBy))
+		response["AheadBy"] = status.AheadBy;
+	if (isRequested(StatusFields::BehindBy))
+		response["BehindBy"] = status.BehindBy;
+	if (isRequested(StatusFields::IndexAdded))
+		serializePaths("IndexAdded", StatusPaths::Category::IndexAdded);
+	if (isRequested(StatusFields::IndexModified))
+		serializePaths("IndexModified", StatusPaths::Category::IndexModified);
+	if (isRequested(StatusFields::IndexDeleted))
+		serializePaths("IndexDeleted", StatusPaths::Category::IndexDeleted);
+	if (isRequested(StatusFields::IndexTypeChange))
+		serializePaths("IndexTypeChange", StatusPaths::Category::IndexTypeChange);
+	if (isRequested(StatusFields::IndexRenamed))
+		serializePaths("IndexRenamed", StatusPaths::Category::IndexRenamed);
+	if (isRequested(StatusFields::WorkingAdded))
+		serializePaths("WorkingAdded", StatusPaths::Category::WorkingAdded);
+	if (isRequested(StatusFields::WorkingModified))
+		serializePaths("WorkingModified", StatusPaths::Category::WorkingModified);
+	if (isRequested(StatusFields::WorkingDeleted))
+		serializePaths("WorkingDeleted", StatusPaths::Category::WorkingDeleted);
+	if (isRequested(StatusFields::WorkingTypeChange))
+		serializePaths("WorkingTypeChange", StatusPaths::Category::WorkingTypeChange);
+	if (isRequested(StatusFields::WorkingRenamed))
+		serializePaths("WorkingRenamed", StatusPaths::Category::WorkingRenamed);
+	if (isRequested(StatusFields::WorkingUnreadable))
+		serializePaths("WorkingUnreadable", StatusPaths::Category::WorkingUnreadable);
+	if (isRequested(StatusFields::Ignored))
+		serializePaths("Ignored", StatusPaths::Category::Ignored);
+	if (isRequested(StatusFields::Conflicted))
+		serializePaths("Conflicted", StatusPaths::Category::Conflicted);
+
+	if (isRequested(StatusFields::Stashes))
+	{
+		response["Stashes"] = nlohmann::json::array();
+		for (const auto& value : status.Stashes)
+		{
+			response["Stashes"].push_back({
+				{ "Name", "stash@{" + std::to_string(value.Index) + "}" },
+				{ "Sha1Id", value.Sha1Id },
+				{ "Message", value.Message }
+			});
+		}
+	}
+
+	return response.dump();
+}
+
+std::shared_ptr<const std::string> StatusController::GetSerializedStatus(
+	const std::string& repositoryPath,
+	const CachedStatus& status,
+	uint32_t fields,
+	const StatusDetail& detail)
+{
+	{
+		ReadLock readLock{m_serializedStatusesMutex};
+		auto serializedStatus = m_serializedStatuses.find(repositoryPath);
+		if (serializedStatus != m_serializedStatuses.end()
+			&& serializedStatus->second.Fields == fields
+			&& serializedStatus->second.Detail.IncludePaths == detail.IncludePaths
+			&& serializedStatus->second.Detail.IncludeCounts == detail.IncludeCounts
+			&& serializedStatus->second.Detail.MaxPaths == detail.MaxPaths
+			&& serializedStatus->second.Generation == status.Generation
+			&& serializedStatus->second.Status.lock() == status.Status)
+		{
+			return serializedStatus->second.Body;
+		}
+	}
+
+	auto body = std::make_shared<const std::string>(SerializeStatus(*status.Status, fields, detail));
+
+	{
+		WriteLock writeLock{m_serializedStatusesMutex};
+
+		// Pruning whenever the number of entries doubles keeps its cost constant per insertion.
+		if (m_serializedStatuses.size() >= m_serializedStatusesToPrune)
+		{
+			for (auto iterator = m_serializedStatuses.begin(); iterator != m_serializedStatuses.end();)
+			{
+				if (iterator->second.Status.expired())
+					iterator = m_serializedStatuses.erase(iterator);
+				else
+					++iterator;
+			}
+			m_serializedStatusesToPrune = (std::max)(MinSerializedStatusesToPrune, 2 * m_serializedStatuses.size());
+		}
+
+		auto& serializedStatus = m_serializedStatuses[repositoryPath];
+		serializedStatus.Fields = fields;
+		serializedStatus.Detail = detail;
+		serializedStatus.Generation = status.Generation;
+		serializedStatus.Status = status.Status;
+		serializedStatus.Body = body;
+	}
+
+	return body;
+}
+
+std::string StatusController::GetStatus(const nlohmann::json& document, const std::string& request)
+{
+	if (!document["Path"].is_string())
+	{
+		return CreateErrorResponse(request, "'Path' must be specified.");
+	}
+	auto path = document["Path"].get<std::string>();
+
+	uint32_t fields;
+	uint32_t parts;
+	if (!ParseStatusFields(document, fields, parts))
+	{
+		return CreateErrorResponse(request, "'Fields' must be an array of status field names.");
+	}
+
+	StatusDetail detail;
+	if (!ParseStatusDetail(document, detail))
+	{
+		return CreateErrorResponse(request, "'Detail' must be 'Full', 'Counts' or 'Capped' with a non-negative integer 'MaxPaths'.");
+	}
+
+	auto repositoryPath = m_cache.DiscoverRepository(path);
+	if (!std::get<0>(repositoryPath))
+	{
+		return CreateErrorResponse(request, "Requested 'Path' is not part of a git repository.");
+	}
+
+	auto status = m_cache.GetStatus(std::get<1>(repositoryPath), parts, detail.MaxPaths);
+	if (!status.Success)
+	{
+		return CreateErrorResponse(request, "Failed to retrieve status of git repository at provided 'Path'.");
+	}
+
+	auto body = GetSerializedStatus(std::get<1>(repositoryPath), status, fields, detail);
+
+	// Splice request specific fields into the front of the cached JSON object.
+	std::string response = R"({"Path":)";
+	response += nlohmann::json(path).dump();
+	response += ",";
+	if (status.IsStale)
+	{
+		auto age = std::chrono::steady_clock::now() - status.ComputedAt;
+		response += R"("Stale":true,"StatusAgeMilliseconds":)";
+		response += std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(age).count());
+		response += ",";
+	}
+	response.append(*body, 1, std::string::npos);
+
+	return response;
+}
+
+std::string StatusController::GetCacheStatistics()
+{
+	auto statistics = m_cache.GetCacheStatistics();
+
+	static const int nanosecondsPerMillisecond = 1000000;
+	uint64_t totalGetStatusCalls;
+	uint64_t totalNanosecondsInGetStatus;
+	uint64_t minNanosecondsInGetStatus;
+	uint64_t maxNanosecondsInGetStatus;
+	{
+		ReadLock readLock{m_getStatusStatisticsMutex};
+		totalGetStatusCalls = m_totalGetStatusCalls;
+		totalNanosecondsInGetStatus = m_totalNanosecondsInGetStatus;
+		minNanosecondsInGetStatus = m_minNanosecondsInGetStatus;
+		maxNanosecondsInGetStatus = m_maxNanosecondsInGetStatus;
+	}
+	
+	auto averageNanosecondsInGetStatus = totalGetStatusCalls != 0 ? totalNanosecondsInGetStatus / totalGetStatusCalls : 0;
+	auto averageMillisecondsInGetStatus = static_cast<double>(averageNanosecondsInGetStatus) / nanosecondsPerMillisecond;
+	auto minMillisecondsInGetStatus = static_cast<double>(minNanosecondsInGetStatus) / nanosecondsPerMillisecond;
+	auto maxMillisecondsInGetStatus = static_cast<double>(maxNanosecondsInGetStatus) / nanosecondsPerMillisecond;
+
+	nlohmann::json response {
+		{ "Version", VERSION },
+		{ "TotalGetStatusRequests", totalGetStatusCalls },
+		{ "AverageMillisecondsInGetStatus", averageMillisecondsInGetStatus },
+		{ "MinimumMillisecondsInGetStatus", minMillisecondsInGetStatus },
+		{ "MaximumMillisecondsInGetStatus", maxMillisecondsInGetStatus },
+		{ "CacheHits",  statistics.CacheHits },
+		{ "StaleCacheHits", statistics.CacheStaleHits },
+		{ "CacheMisses", statistics.CacheMisses },
+		{ "CoalescedCacheMisses", statistics.CacheCoalescedRequests },
+		{ "IncrementalRecomputations", statistics.CacheIncrementalRecomputations },
+		{ "EffectiveCachePrimes", statistics.CacheEffectivePrimeRequests },
+		{ "TotalCachePrimes", statistics.CacheTotalPrimeRequests },
+		{ "EffectiveCacheInvalidations", statistics.CacheEffectiveInvalidationRequests },
+		{ "TotalCacheInvalidations", statistics.CacheTotalInvalidationRequests },
+		{ "FullCacheInvalidations", statistics.CacheInvalidateAllRequests },
+		{ "ResidentBytes", statistics.CacheResidentBytes },
+		{ "FrontCodingSavedBytes", statistics.CacheFrontCodingSavedBytes },
+		{ "Evictions", statistics.CacheEvictions }
+	};
+
+	return response.dump();
+}
+
+void StatusController::Shutdown()
+{
+	//Log("StatusController.Shutdown", Severity::Info) << R"(Shutting down due to client request.")";
+	::SetEvent(m_requestShutdown);
+}
+
+std::string StatusController::HandleRequest(const std::string& request)
+{
+	nlohmann::json document;
+	try
+	{
+		document = nlohmann::json::parse(request);
+	}
+	catch (nlohmann::json::parse_error &e)
+	{
+		return CreateErrorResponse(request, "Request must be valid JSON.", &e);
+	}
+
+	if (!document["Version"].is_number())
+		return CreateErrorResponse(request, "'Version' must be specified.");
+
+	if (document["Version"] != 1)
+		return CreateErrorResponse(request, "Requested 'Version' unknown.");
+
+	if (!document["Action"].is_string())
+		return CreateErrorResponse(request, "'Action' must be specified.");
+	auto action = document["Action"].get<std::string>();
+
+	if (_strcmpi(action.c_str(), "GetStatus") == 0)
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto result = GetStatus(document, request);
+		RecordGetStatusTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		return result;
+	}
+
+	if (_strcmpi(action.c_str(), "GetCacheStatistics") == 0)
+		return GetCacheStatistics();
+
+	if (_strcmpi(action.c_str(), "Shutdown") == 0)
+	{
+		Shutdown();
+		nlohmann::json response{
+			{ "Version", VERSION },
+			{ "Result", "Shutting down." }
+		};
+
+		return response.dump();
+	}
+		
+
+	return CreateErrorResponse(request, "'Action' unrecognized.");
+}
+
+void StatusController::WaitForShutdownRequest()
+{
+	::WaitForSingleObject(m_requestShutdown, INFINITE);
 }
\ No newline at end of file
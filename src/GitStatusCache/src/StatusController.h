@@ -1,74 +1,170 @@
-#pragma once
-
-#include "Git.h"
-#include "DirectoryMonitor.h"
-#include "StatusCache.h"
-
-#include <chrono>
-#include <shared_mutex>
-
-// ignore warnings from nlohmann headers
-#pragma warning(push, 0)
-#pragma warning (disable : ALL_CODE_ANALYSIS_WARNINGS)
-#include <nlohmann/json.hpp>
-#pragma warning(pop)
-
-/**
- * Services requests for git status information.
- */
-class StatusController
-{
-private:
-	using ReadLock = std::shared_lock<std::shared_mutex>;
-	using WriteLock = std::unique_lock<std::shared_mutex>;
-
-	uint64_t m_totalNanosecondsInGetStatus = 0;
-	uint64_t m_minNanosecondsInGetStatus = UINT64_MAX;
-	uint64_t m_maxNanosecondsInGetStatus = 0;
-	uint64_t m_totalGetStatusCalls = 0;
-	std::shared_mutex m_getStatusStatisticsMutex;
-
-	Git m_git;
-	StatusCache m_cache;
-	UniqueHandle m_requestShutdown;
-
-	/**
-	 * Creates JSON response for errors.
-	 */
-	static std::string CreateErrorResponse(const std::string& request, std::string&& error, std::exception *e = nullptr);
-
-	/**
-	 * Records timing datapoint for GetStatus.
-	 */
-	void RecordGetStatusTime(uint64_t nanosecondsInGetStatus);
-
-	/**
-	* Retrieves current git status.
-	*/
-	std::string GetStatus(const nlohmann::json& document, const std::string& request);
-
-	/**
-	* Retrieves information about cache's performance.
-	*/
-	std::string GetCacheStatistics();
-
-public:
-	StatusController();
-	StatusController(const StatusController&) = delete;
-	~StatusController();
-
-	/**
-	* Deserializes request and returns serialized response.
-	*/
-	std::string StatusController::HandleRequest(const std::string& request);
-
-	/**
-	 * Shuts down the service.
-	 */
-	void StatusController::Shutdown();
-
-	/**
-	 * Blocks until shutdown request received.
-	 */
-	void WaitForShutdownRequest();
+#pragma once
+
+#include "Git.h"
+#include "DirectoryMonitor.h"
+#include "Options.h"
+#include "StatusCache.h"
+
+#include <chrono>
+#include <shared_mutex>
+
+// ignore warnings from nlohmann headers
+#pragma warning(push, 0)
+#pragma warning (disable : ALL_CODE_ANALYSIS_WARNINGS)
+#include <nlohmann/json.hpp>
+#pragma warning(pop)
+
+/**
+ * Services requests for git status information.
+ */
+class StatusController
+{
+private:
+	using ReadLock = std::shared_lock<std::shared_mutex>;
+	using WriteLock = std::unique_lock<std::shared_mutex>;
+
+	uint64_t m_totalNanosecondsInGetStatus = 0;
+	uint64_t m_minNanosecondsInGetStatus = UINT64_MAX;
+	uint64_t m_maxNanosecondsInGetStatus = 0;
+	uint64_t m_totalGetStatusCalls = 0;
+	std::shared_mutex m_getStatusStatisticsMutex;
+
+	/**
+	* Optional fields of a GetStatus response. Combined as a bitmask.
+	*/
+	struct StatusFields
+	{
+		static constexpr uint32_t State = 1 << 0;
+		static constexpr uint32_t Branch = 1 << 1;
+		static constexpr uint32_t Upstream = 1 << 2;
+		static constexpr uint32_t UpstreamGone = 1 << 3;
+		static constexpr uint32_t AheadBy = 1 << 4;
+		static constexpr uint32_t BehindBy = 1 << 5;
+		static constexpr uint32_t IndexAdded = 1 << 6;
+		static constexpr uint32_t IndexModified = 1 << 7;
+		static constexpr uint32_t IndexDeleted = 1 << 8;
+		static constexpr uint32_t IndexTypeChange = 1 << 9;
+		static constexpr uint32_t IndexRenamed = 1 << 10;
+		static constexpr uint32_t WorkingAdded = 1 << 11;
+		static constexpr uint32_t WorkingModified = 1 << 12;
+		static constexpr uint32_t WorkingDeleted = 1 << 13;
+		static constexpr uint32_t WorkingTypeChange = 1 << 14;
+		static constexpr uint32_t WorkingRenamed = 1 << 15;
+		static constexpr uint32_t WorkingUnreadable = 1 << 16;
+		static constexpr uint32_t Ignored = 1 << 17;
+		static constexpr uint32_t Conflicted = 1 << 18;
+		static constexpr uint32_t Stashes = 1 << 19;
+		static constexpr uint32_t All = (1 << 20) - 1;
+	};
+
+	/**
+	* Detail of path lists in a GetStatus response.
+	*/
+	struct StatusDetail
+	{
+		/**
+		* True if path lists are included. False if only their counts are.
+		*/
+		bool IncludePaths = true;
+
+		/**
+		* True if the length of each path list is included alongside it.
+		*/
+		bool IncludeCounts = false;
+
+		/**
+		* Maximum number of paths included in each path list.
+		*/
+		size_t MaxPaths = Git::UnlimitedPaths;
+	};
+
+	/**
+	* Serialized status response for a repository, minus request specific fields.
+	*/
+	struct SerializedStatus
+	{
+		uint32_t Fields = 0;
+		StatusDetail Detail;
+		uint64_t Generation = 0;
+		std::weak_ptr<const Git::Status> Status;
+		std::shared_ptr<const std::string> Body;
+	};
+
+	// Serialized statuses by repository path. Only the most recently requested fields and detail
+	// are kept for each repository, since path limits are chosen by clients. Entries whose status
+	// left the cache are pruned whenever their number doubles.
+	std::unordered_map<std::string, SerializedStatus> m_serializedStatuses;
+	size_t m_serializedStatusesToPrune;
+	std::shared_mutex m_serializedStatusesMutex;
+
+	StatusCache m_cache;
+	UniqueHandle m_requestShutdown;
+
+	/**
+	 * Creates JSON response for errors.
+	 */
+	static std::string CreateErrorResponse(const std::string& request, std::string&& error, std::exception *e = nullptr);
+
+	/**
+	 * Records timing datapoint for GetStatus.
+	 */
+	void RecordGetStatusTime(uint64_t nanosecondsInGetStatus);
+
+	/**
+	* Parses the optional 'Fields' list of a GetStatus request into fields and the status parts
+	* needed to fill them. Fails if the list is malformed or names an unknown field.
+	*/
+	static bool ParseStatusFields(const nlohmann::json& document, uint32_t& fields, uint32_t& parts);
+
+	/**
+	* Parses the optional 'Detail' and 'MaxPaths' of a GetStatus request. Fails if the detail
+	* is unknown or a capped detail lacks a valid path limit.
+	*/
+	static bool ParseStatusDetail(const nlohmann::json& document, StatusDetail& detail);
+
+	/**
+	* Serializes provided fields of status to JSON with provided detail. Excludes request
+	* specific fields.
+	*/
+	static std::string SerializeStatus(const Git::Status& status, uint32_t fields, const StatusDetail& detail);
+
+	/**
+	* Returns serialized status, reusing the repository's previous serialization if it has the
+	* same fields and detail and the repository's status snapshot hasn't changed since.
+	*/
+	std::shared_ptr<const std::string> GetSerializedStatus(
+		const std::string& repositoryPath,
+		const CachedStatus& status,
+		uint32_t fields,
+		const StatusDetail& detail);
+
+	/**
+	* Retrieves current git status.
+	*/
+	std::string GetStatus(const nlohmann::json& document, const std::string& request);
+
+	/**
+	* Retrieves information about cache's performance.
+	*/
+	std::string GetCacheStatistics();
+
+public:
+	StatusController(const Options& options);
+	StatusController(const StatusController&) = delete;
+	~StatusController();
+
+	/**
+	* Deserializes request and returns serialized response.
+	*/
+	std::string StatusController::HandleRequest(const std::string& request);
+
+	/**
+	 * Shuts down the service.
+	 */
+	void StatusController::Shutdown();
+
+	/**
+	 * Blocks until shutdown request received.
+	 */
+	void WaitForShutdownRequest();
 };
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "StatusPaths.h"
+
+/*static*/ bool StatusPaths::IsRenamedCategory(uint8_t category)
+{
+	return category == Category::IndexRenamed || category == Category::WorkingRenamed;
+}
+
+std::string_view StatusPaths::GetPath(size_t entry) const
+{
+	const auto& pathEntry = m_entries[entry];
+	return std::string_view(m_arena.data() + pathEntry.Offset, pathEntry.Length);
+}
+
+std::string_view StatusPaths::DecodePath(size_t entry, std::string& path) const
+{
+	auto suffix = GetPath(entry);
+	if (!m_isFrontCoded)
+		return suffix;
+
+	path.resize(m_entries[entry].Flags >> EntryFlags::PrefixShift);
+	path.append(suffix.data(), suffix.size());
+	return path;
+}
+
+void StatusPaths::Builder::AddEntry(uint8_t category, std::string_view path, uint32_t flags)
+{
+	m_entries.push_back({ static_cast<uint32_t>(m_arena.size()), static_cast<uint32_t>(path.size()), category | flags });
+	m_arena.append(path.data(), path.size());
+}
+
+void StatusPaths::Builder::Add(uint8_t category, std::string_view path)
+{
+	AddEntry(category, path, 0);
+	++m_sizes[category];
+}
+
+void StatusPaths::Builder::AddRenamed(uint8_t category, std::string_view oldPath, std::string_view newPath)
+{
+	AddEntry(category, oldPath, EntryFlags::RenamedFrom);
+	AddEntry(category, newPath, 0);
+	++m_sizes[category];
+}
+
+void StatusPaths::Builder::Append(uint8_t category, const StatusPaths& paths, size_t maxPaths)
+{
+	if (IsRenamedCategory(category))
+	{
+		auto renamedPaths = paths.GetRenamed(category);
+		for (size_t i = 0; i < renamedPaths.size() && i < maxPaths; ++i)
+			AddRenamed(category, renamedPaths[i].first, renamedPaths[i].second);
+	}
+	else
+	{
+		auto categoryPaths = paths.Get(category);
+		for (size_t i = 0; i < categoryPaths.size() && i < maxPaths; ++i)
+			Add(category, categoryPaths[i]);
+	}
+}
+
+size_t StatusPaths::Builder::Size(uint8_t category) const
+{
+	return m_sizes[category];
+}
+
+StatusPaths StatusPaths::Builder::Build()
+{
+	StatusPaths paths;
+
+	// Entries are placed by counting sort, which keeps the order of each category's paths.
+	std::array<size_t, Category::Count + 1> entryCounts = {};
+	for (const auto& entry : m_entries)
+		++entryCounts[(entry.Flags & EntryFlags::CategoryMask) + 1];
+	for (size_t category = 0; category < Category::Count; ++category)
+		entryCounts[category + 1] += entryCounts[category];
+	paths.m_categoryBegin = entryCounts;
+
+	// Paths are copied in category order, so that each view reads a contiguous run of the arena.
+	paths.m_entries.resize(m_entries.size());
+	for (const auto& entry : m_entries)
+		paths.m_entries[entryCounts[entry.Flags & EntryFlags::CategoryMask]++] = entry;
+
+	paths.m_arena.reserve(m_arena.size());
+	for (auto& entry : paths.m_entries)
+	{
+		auto offset = static_cast<uint32_t>(paths.m_arena.size());
+		paths.m_arena.append(m_arena, entry.Offset, entry.Length);
+		entry.Offset = offset;
+	}
+
+	m_arena.clear();
+	m_entries.clear();
+	m_sizes = {};
+	return paths;
+}
+
+StatusPaths::PathView StatusPaths::Get(uint8_t category) const
+{
+	return PathView(this, m_categoryBegin[category], m_categoryBegin[category + 1]);
+}
+
+StatusPaths::RenamedPathView StatusPaths::GetRenamed(uint8_t category) const
+{
+	return RenamedPathView(this, m_categoryBegin[category], m_categoryBegin[category + 1]);
+}
+
+size_t StatusPaths::Size(uint8_t category) const
+{
+	auto entryCount = m_categoryBegin[category + 1] - m_categoryBegin[category];
+	return IsRenamedCategory(category) ? entryCount / 2 : entryCount;
+}
+
+StatusPaths::Counts StatusPaths::GetSizes() const
+{
+	Counts sizes;
+	for (uint8_t category = 0; category < Category::Count; ++category)
+		sizes[category] = Size(category);
+	return sizes;
+}
+
+bool StatusPaths::IsFrontCoded() const
+{
+	return m_isFrontCoded;
+}
+
+StatusPaths StatusPaths::FrontCode() const
+{
+	if (m_isFrontCoded)
+		return *this;
+
+	StatusPaths paths;
+	paths.m_categoryBegin = m_categoryBegin;
+	paths.m_isFrontCoded = true;
+	paths.m_entries.reserve(m_entries.size());
+
+	// Paths are sorted within each category, so neighbours share their leading directories.
+	// Renames are coded in sequence as well, since old and new paths usually share a directory.
+	std::string_view previousPath;
+	for (uint8_t category = 0; category < Category::Count; ++category)
+	{
+		previousPath = std::string_view();
+		for (auto entry = m_categoryBegin[category]; entry < m_categoryBegin[category + 1]; ++entry)
+		{
+			auto path = GetPath(entry);
+			auto mismatch = std::mismatch(path.begin(), path.end(), previousPath.begin(), previousPath.end());
+			auto prefix = (std::min)(static_cast<size_t>(mismatch.first - path.begin()), static_cast<size_t>(EntryFlags::MaxPrefix));
+
+			auto offset = static_cast<uint32_t>(paths.m_arena.size());
+			auto flags = (m_entries[entry].Flags & ~(EntryFlags::MaxPrefix << EntryFlags::PrefixShift))
+				| static_cast<uint32_t>(prefix << EntryFlags::PrefixShift);
+			paths.m_entries.push_back({ offset, static_cast<uint32_t>(path.size() - prefix), flags });
+			paths.m_arena.append(path.data() + prefix, path.size() - prefix);
+			paths.m_frontCodingSavedBytes += prefix;
+			previousPath = path;
+		}
+	}
+
+	paths.m_arena.shrink_to_fit();
+	return paths;
+}
+
+StatusPaths StatusPaths::Decode() const
+{
+	if (!m_isFrontCoded)
+		return *this;
+
+	StatusPaths paths;
+	paths.m_categoryBegin = m_categoryBegin;
+	paths.m_entries.reserve(m_entries.size());
+	paths.m_arena.reserve(m_arena.size() + m_frontCodingSavedBytes);
+
+	std::string path;
+	for (uint8_t category = 0; category < Category::Count; ++category)
+	{
+		for (auto entry = m_categoryBegin[category]; entry < m_categoryBegin[category + 1]; ++entry)
+		{
+			auto decodedPath = DecodePath(entry, path);
+			auto flags = m_entries[entry].Flags & ~(EntryFlags::MaxPrefix << EntryFlags::PrefixShift);
+			paths.m_entries.push_back({ static_cast<uint32_t>(paths.m_arena.size()), static_cast<uint32_t>(decodedPath.size()), flags });
+			paths.m_arena.append(decodedPath.data(), decodedPath.size());
+		}
+	}
+
+	return paths;
+}
+
+size_t StatusPaths::GetFrontCodingSavedBytes() const
+{
+	return m_frontCodingSavedBytes;
+}
+
+size_t StatusPaths::GetResidentBytes() const
+{
+	return m_arena.capacity() + m_entries.capacity() * sizeof(Entry);
+}
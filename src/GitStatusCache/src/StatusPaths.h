@@ -0,0 +1,284 @@
+#pragma once
+
+#include <array>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+* Path lists of a status. Paths are stored in one contiguous arena of characters and
+* referenced by a flat array of entries, each tagged with the path list it belongs to.
+* Entries are grouped by path list, in the order each list's paths were added. Paths
+* are added through a Builder and read through views of each path list.
+*
+* Path lists may be front coded, in which case each entry only stores the part of its
+* path that differs from the previous path in the list. Front coded paths can only be
+* read sequentially, through ForEach and ForEachRenamed.
+*/
+class StatusPaths
+{
+public:
+	/**
+	* Path lists of a status. Used as indices.
+	*/
+	struct Category
+	{
+		static constexpr uint8_t IndexAdded = 0;
+		static constexpr uint8_t IndexModified = 1;
+		static constexpr uint8_t IndexDeleted = 2;
+		static constexpr uint8_t IndexTypeChange = 3;
+		static constexpr uint8_t IndexRenamed = 4;
+		static constexpr uint8_t WorkingAdded = 5;
+		static constexpr uint8_t WorkingModified = 6;
+		static constexpr uint8_t WorkingDeleted = 7;
+		static constexpr uint8_t WorkingTypeChange = 8;
+		static constexpr uint8_t WorkingUnreadable = 9;
+		static constexpr uint8_t WorkingRenamed = 10;
+		static constexpr uint8_t Ignored = 11;
+		static constexpr uint8_t Conflicted = 12;
+		static constexpr uint8_t Count = 13;
+	};
+
+	/**
+	* Counts of paths, indexed by category.
+	*/
+	using Counts = std::array<size_t, Category::Count>;
+
+	/**
+	* Checks if paths of provided category are stored as old and new path pairs.
+	*/
+	static bool IsRenamedCategory(uint8_t category);
+
+private:
+	/**
+	* Entry flags. The low byte holds the entry's category.
+	*/
+	struct EntryFlags
+	{
+		static constexpr uint32_t CategoryMask = 0xFF;
+
+		/**
+		* Entry is the old path of a rename. The new path is the following entry.
+		*/
+		static constexpr uint32_t RenamedFrom = 1 << 8;
+
+		/**
+		* Front coded entries store the length of the prefix shared with the previous
+		* entry of their category in the remaining bits.
+		*/
+		static constexpr uint32_t PrefixShift = 9;
+		static constexpr uint32_t MaxPrefix = (1u << (32 - PrefixShift)) - 1;
+	};
+
+	struct Entry
+	{
+		uint32_t Offset;
+		uint32_t Length;
+		uint32_t Flags;
+	};
+
+	std::string m_arena;
+	std::vector<Entry> m_entries;
+
+	// Index of the first entry of each category, followed by the number of entries.
+	std::array<size_t, Category::Count + 1> m_categoryBegin = {};
+
+	bool m_isFrontCoded = false;
+	size_t m_frontCodingSavedBytes = 0;
+
+	/**
+	* Retrieves the characters stored for an entry. Only the entry's suffix if front coded.
+	*/
+	std::string_view GetPath(size_t entry) const;
+
+	/**
+	* Retrieves the path of an entry. Front coded entries are decoded into provided path,
+	* which must hold the path of the previous entry of the same category.
+	*/
+	std::string_view DecodePath(size_t entry, std::string& path) const;
+
+public:
+	/**
+	* Read only view of the paths of one category.
+	*/
+	class PathView
+	{
+	private:
+		const StatusPaths* m_paths;
+		size_t m_begin;
+		size_t m_end;
+
+	public:
+		class Iterator
+		{
+		private:
+			const StatusPaths* m_paths;
+			size_t m_entry;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const std::string_view*;
+			using reference = std::string_view;
+
+			Iterator(const StatusPaths* paths, size_t entry) : m_paths(paths), m_entry(entry) { }
+			std::string_view operator*() const { return m_paths->GetPath(m_entry); }
+			Iterator& operator++() { ++m_entry; return *this; }
+			bool operator==(const Iterator& other) const { return m_entry == other.m_entry; }
+			bool operator!=(const Iterator& other) const { return m_entry != other.m_entry; }
+		};
+
+		PathView(const StatusPaths* paths, size_t begin, size_t end) : m_paths(paths), m_begin(begin), m_end(end) { }
+
+		size_t size() const { return m_end - m_begin; }
+		bool empty() const { return m_end == m_begin; }
+		std::string_view operator[](size_t index) const { return m_paths->GetPath(m_begin + index); }
+		Iterator begin() const { return Iterator(m_paths, m_begin); }
+		Iterator end() const { return Iterator(m_paths, m_end); }
+	};
+
+	/**
+	* Read only view of the old and new path pairs of one renamed category.
+	*/
+	class RenamedPathView
+	{
+	private:
+		const StatusPaths* m_paths;
+		size_t m_begin;
+		size_t m_end;
+
+	public:
+		RenamedPathView(const StatusPaths* paths, size_t begin, size_t end) : m_paths(paths), m_begin(begin), m_end(end) { }
+
+		size_t size() const { return (m_end - m_begin) / 2; }
+		bool empty() const { return m_end == m_begin; }
+		std::pair<std::string_view, std::string_view> operator[](size_t index) const
+		{
+			auto entry = m_begin + index * 2;
+			return { m_paths->GetPath(entry), m_paths->GetPath(entry + 1) };
+		}
+	};
+
+	/**
+	* Accumulates paths in any category order, then groups them into StatusPaths.
+	*/
+	class Builder
+	{
+	private:
+		std::string m_arena;
+		std::vector<Entry> m_entries;
+		Counts m_sizes = {};
+
+		void AddEntry(uint8_t category, std::string_view path, uint32_t flags);
+
+	public:
+		/**
+		* Adds path to provided category.
+		*/
+		void Add(uint8_t category, std::string_view path);
+
+		/**
+		* Adds old and new path of a rename to provided renamed category.
+		*/
+		void AddRenamed(uint8_t category, std::string_view oldPath, std::string_view newPath);
+
+		/**
+		* Adds up to provided number of paths of provided category from existing paths.
+		*/
+		void Append(uint8_t category, const StatusPaths& paths, size_t maxPaths = SIZE_MAX);
+
+		/**
+		* Retrieves number of paths added to provided category.
+		*/
+		size_t Size(uint8_t category) const;
+
+		/**
+		* Groups added paths by category into a compact StatusPaths. Leaves the builder empty.
+		*/
+		StatusPaths Build();
+	};
+
+	/**
+	* Retrieves paths of provided category. Paths must not be front coded.
+	*/
+	PathView Get(uint8_t category) const;
+
+	/**
+	* Retrieves path pairs of provided renamed category. Paths must not be front coded.
+	*/
+	RenamedPathView GetRenamed(uint8_t category) const;
+
+	/**
+	* Calls provided callback with up to provided number of paths of provided category, in
+	* order. Front coded paths are decoded as they're visited, and are only valid during
+	* the call.
+	*/
+	template <typename Callback>
+	void ForEach(uint8_t category, size_t maxPaths, Callback callback) const
+	{
+		std::string path;
+		auto end = m_categoryBegin[category + 1];
+		for (auto entry = m_categoryBegin[category]; entry < end && maxPaths != 0; ++entry, --maxPaths)
+			callback(DecodePath(entry, path));
+	}
+
+	/**
+	* Calls provided callback with up to provided number of old and new path pairs of provided
+	* renamed category, in order. Front coded paths are decoded as they're visited, and are
+	* only valid during the call.
+	*/
+	template <typename Callback>
+	void ForEachRenamed(uint8_t category, size_t maxPaths, Callback callback) const
+	{
+		std::string path;
+		std::string oldPath;
+		auto end = m_categoryBegin[category + 1];
+		for (auto entry = m_categoryBegin[category]; entry + 1 < end && maxPaths != 0; entry += 2, --maxPaths)
+		{
+			auto oldPathView = DecodePath(entry, path);
+			if (m_isFrontCoded)
+			{
+				oldPath.assign(oldPathView.data(), oldPathView.size());
+				oldPathView = oldPath;
+			}
+			callback(oldPathView, DecodePath(entry + 1, path));
+		}
+	}
+
+	/**
+	* Checks if paths are front coded.
+	*/
+	bool IsFrontCoded() const;
+
+	/**
+	* Returns a front coded copy of the paths.
+	*/
+	StatusPaths FrontCode() const;
+
+	/**
+	* Returns a copy of the paths that isn't front coded.
+	*/
+	StatusPaths Decode() const;
+
+	/**
+	* Retrieves number of path characters front coding avoided storing.
+	*/
+	size_t GetFrontCodingSavedBytes() const;
+
+	/**
+	* Retrieves number of paths, or path pairs, in provided category.
+	*/
+	size_t Size(uint8_t category) const;
+
+	/**
+	* Retrieves number of paths in each category.
+	*/
+	Counts GetSizes() const;
+
+	/**
+	* Estimates the number of bytes of memory held.
+	*/
+	size_t GetResidentBytes() const;
+};
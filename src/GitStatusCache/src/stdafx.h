@@ -1,41 +1,46 @@
-// stdafx.h : include file for standard system include files,
-// or project specific include files that are used frequently, but
-// are changed infrequently
-//
-
-#pragma once
-
-#include "targetver.h"
-
-#define WIN32_LEAN_AND_MEAN
-
-#include <stdio.h>
-#include <tchar.h>
-#include <windows.h>
-#include <shellapi.h>
-#include <atlstr.h>
-
-#include <algorithm>
-#include <atomic>
-#include <codecvt>
-#include <locale>
-#include <limits>
-#include <memory>
-#include <mutex>
-#include <string>
-#include <thread>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-
-#ifndef noexcept
-#define noexcept throw()
-#include <scope_guard.h>
-#include <unique_resource.h>
-#undef noexcept
-#else
-#include <scope_guard.h>
-#include <unique_resource.h>
-#endif
-
-#include "SmartPointers.h"
\ No newline at end of file
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#ifdef _WIN32
+#include "targetver.h"
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <stdio.h>
+#include <tchar.h>
+#include <windows.h>
+#include <shellapi.h>
+#include <atlstr.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <codecvt>
+#include <locale>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef noexcept
+#define noexcept throw()
+#include <scope_guard.h>
+#include <unique_resource.h>
+#undef noexcept
+#else
+#include <scope_guard.h>
+#include <unique_resource.h>
+#endif
+
+// Components that don't use libgit2, such as the Linux directory monitor, build without it.
+#if __has_include(<git2.h>)
+#include "SmartPointers.h"
+#endif
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "Cache.h"
+#include "TestRepository.h"
+
+#include <iomanip>
+#include <iostream>
+
+// Measures cache hit throughput against the number of threads reading the cache. Threads
+// either spread their reads over many repositories, which land on different shards, or
+// all read the same repository. Also checks that every read is served from the cache.
+namespace
+{
+	struct Workload
+	{
+		const char* Name;
+		bool SameRepository;
+	};
+
+	/**
+	* Repositories with a committed file each, warmed in a cache.
+	*/
+	class WarmCache
+	{
+	private:
+		std::vector<std::unique_ptr<TestRepository>> m_repositories;
+
+	public:
+		Cache WarmedCache;
+		std::vector<std::string> RepositoryPaths;
+		std::vector<const Git::Status*> Statuses;
+
+		explicit WarmCache(size_t repositoryCount)
+			: WarmedCache(Options())
+		{
+			Git git;
+			for (size_t i = 0; i < repositoryCount; ++i)
+			{
+				m_repositories.push_back(std::make_unique<TestRepository>("CacheContentionTest"));
+				auto& repository = *m_repositories.back();
+				repository.WriteFile("file", "content\n");
+				repository.Stage("file", repository.WriteBlob("content\n"));
+				repository.WriteIndex();
+				repository.CommitIndex();
+
+				auto repositoryPath = git.DiscoverRepository(repository.GetWorkingDirectory());
+				Check(std::get<0>(repositoryPath), "Failed to discover repository.");
+				RepositoryPaths.push_back(std::get<1>(repositoryPath));
+
+				auto status = WarmedCache.GetStatus(RepositoryPaths.back());
+				Check(status.Success, "Failed to retrieve status.");
+				Statuses.push_back(status.Status.get());
+			}
+		}
+	};
+
+	/**
+	* Reads the cache from provided number of threads for provided duration. Returns reads
+	* per second. Each read must return the status cached while warming.
+	*/
+	double MeasureHitThroughput(WarmCache& warmCache, const Workload& workload, unsigned threadCount, std::chrono::milliseconds duration)
+	{
+		std::atomic<bool> start = false;
+		std::atomic<bool> stop = false;
+		std::atomic<uint64_t> totalReads = 0;
+		std::atomic<uint64_t> mismatchedReads = 0;
+
+		std::vector<std::thread> threads;
+		for (unsigned thread = 0; thread < threadCount; ++thread)
+		{
+			threads.emplace_back([&, thread]()
+			{
+				while (!start)
+					std::this_thread::yield();
+
+				uint64_t reads = 0;
+				uint64_t mismatches = 0;
+				auto repositoryCount = warmCache.RepositoryPaths.size();
+				auto repository = workload.SameRepository ? 0 : (thread * 7919) % repositoryCount;
+				while (!stop)
+				{
+					auto status = warmCache.WarmedCache.GetStatus(warmCache.RepositoryPaths[repository]);
+					if (!status.Success || status.IsStale || status.Status.get() != warmCache.Statuses[repository])
+						++mismatches;
+					++reads;
+					if (!workload.SameRepository && ++repository == repositoryCount)
+						repository = 0;
+				}
+				totalReads += reads;
+				mismatchedReads += mismatches;
+			});
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		start = true;
+		std::this_thread::sleep_for(duration);
+		stop = true;
+		for (auto& thread : threads)
+			thread.join();
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		Check(mismatchedReads == 0, std::to_string(mismatchedReads) + " reads didn't return the cached status.");
+		return totalReads / seconds;
+	}
+
+	void Run(size_t repositoryCount, const std::vector<unsigned>& threadCounts, std::chrono::milliseconds duration)
+	{
+		WarmCache warmCache(repositoryCount);
+		auto statisticsBefore = warmCache.WarmedCache.GetCacheStatistics();
+
+		const Workload workloads[] = { { "different repositories", false }, { "same repository", true } };
+		for (const auto& workload : workloads)
+		{
+			double singleThreadThroughput = 0;
+			for (auto threadCount : threadCounts)
+			{
+				auto throughput = MeasureHitThroughput(warmCache, workload, threadCount, duration);
+				if (singleThreadThroughput == 0)
+					singleThreadThroughput = throughput;
+				std::cout << "Hits, " << workload.Name << ", " << std::setw(3) << threadCount << " threads: "
+					<< std::fixed << std::setprecision(0) << std::setw(12) << throughput << " per second, "
+					<< std::setprecision(2) << throughput / singleThreadThroughput << "x" << std::endl;
+			}
+		}
+
+		auto statistics = warmCache.WarmedCache.GetCacheStatistics();
+		Check(statistics.CacheMisses == statisticsBefore.CacheMisses, "Reads of warm repositories missed the cache.");
+		Check(statistics.CacheStaleHits == statisticsBefore.CacheStaleHits, "Reads of warm repositories were stale.");
+		Check(statistics.CacheHits > statisticsBefore.CacheHits, "Reads weren't counted as hits.");
+	}
+
+	std::vector<unsigned> GetThreadCounts(unsigned maxThreads)
+	{
+		std::vector<unsigned> threadCounts;
+		for (unsigned threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+			threadCounts.push_back(threadCount);
+		threadCounts.push_back(maxThreads);
+		return threadCounts;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	git_libgit2_init();
+	auto shutdown = std::experimental::scope_guard([] { git_libgit2_shutdown(); });
+
+	try
+	{
+		auto cores = (std::max)(std::thread::hardware_concurrency(), 1u);
+		if (IsBenchmark(argc, argv))
+			Run(256, GetThreadCounts(cores * 2), std::chrono::milliseconds(1000));
+		else
+			Run(16, GetThreadCounts(4), std::chrono::milliseconds(100));
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "FAILED: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
@@ -0,0 +1,244 @@
+#include "stdafx.h"
+#include "CommitGraph.h"
+#include "TestRepository.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+// Checks that ahead/behind counts from the commit-graph file match git_graph_ahead_behind on
+// a random history with merges, octopus merges and commits newer than the commit-graph file.
+// The benchmark compares both on a 100k commit history where the two sides diverge widely.
+// Commit-graph files are written by the git command line, as they are in real repositories.
+namespace
+{
+	/**
+	* Writes a commit-graph file holding the history reachable from provided commits.
+	*/
+	void WriteCommitGraph(TestRepository& repository, const std::vector<git_oid>& tips)
+	{
+		auto tipsPath = std::filesystem::path(git_repository_path(repository.Get())) / "commit-graph-tips";
+		{
+			std::ofstream tipsFile(tipsPath);
+			for (const auto& tip : tips)
+			{
+				char sha1[GIT_OID_HEXSZ + 1];
+				tipsFile << git_oid_tostr(sha1, sizeof(sha1), &tip) << "\n";
+			}
+		}
+
+		auto command = "git -C \"" + repository.GetWorkingDirectory() + "\" commit-graph write --stdin-commits < \"" + tipsPath.string() + "\"";
+		Check(std::system(command.c_str()) == 0, "Failed to write commit-graph file.");
+	}
+
+	/**
+	* Random history of branches that fork, extend, merge and merge several at once.
+	*/
+	class RandomHistory
+	{
+	private:
+		TestRepository& m_repository;
+		git_oid m_tree;
+		std::mt19937 m_random;
+
+		git_oid& PickTip()
+		{
+			return Tips[m_random() % Tips.size()];
+		}
+
+	public:
+		std::vector<git_oid> Commits;
+		std::vector<git_oid> Tips;
+
+		RandomHistory(TestRepository& repository, uint32_t seed)
+			: m_repository(repository)
+			, m_tree(repository.WriteTree())
+			, m_random(seed)
+		{
+			Commits.push_back(m_repository.CommitTree(m_tree, {}));
+			Tips.push_back(Commits.back());
+		}
+
+		void Grow(size_t commitCount)
+		{
+			for (size_t i = 0; i < commitCount; ++i)
+			{
+				auto kind = m_random() % 10;
+				if (kind == 0 || Tips.size() < 2)
+				{
+					// Fork a branch from any earlier commit.
+					Commits.push_back(m_repository.CommitTree(m_tree, { Commits[m_random() % Commits.size()] }));
+					Tips.push_back(Commits.back());
+				}
+				else if (kind <= 2 || (kind == 3 && Tips.size() < 3))
+				{
+					auto& tip = PickTip();
+					auto other = PickTip();
+					if (git_oid_equal(&tip, &other))
+						continue;
+					Commits.push_back(m_repository.CommitTree(m_tree, { tip, other }));
+					tip = Commits.back();
+				}
+				else if (kind == 3)
+				{
+					std::vector<git_oid> parents;
+					auto parentCount = 3 + m_random() % 3;
+					for (size_t parent = 0; parent < parentCount; ++parent)
+					{
+						auto candidate = PickTip();
+						auto isDuplicate = std::any_of(parents.begin(), parents.end(),
+							[&candidate](const git_oid& existing) { return git_oid_equal(&existing, &candidate) != 0; });
+						if (!isDuplicate)
+							parents.push_back(candidate);
+					}
+					if (parents.size() < 3)
+						continue;
+					Commits.push_back(m_repository.CommitTree(m_tree, parents));
+					Tips.push_back(Commits.back());
+				}
+				else
+				{
+					auto& tip = PickTip();
+					Commits.push_back(m_repository.CommitTree(m_tree, { tip }));
+					tip = Commits.back();
+				}
+
+				// Retire old branches, so that merges keep joining recent work.
+				if (Tips.size() > 12)
+					Tips.erase(Tips.begin() + m_random() % Tips.size());
+			}
+		}
+
+		const git_oid& PickCommit()
+		{
+			return Commits[m_random() % Commits.size()];
+		}
+	};
+
+	std::string Describe(const git_oid& local, const git_oid& upstream)
+	{
+		char localSha1[GIT_OID_HEXSZ + 1];
+		char upstreamSha1[GIT_OID_HEXSZ + 1];
+		return std::string(git_oid_tostr(localSha1, sizeof(localSha1), &local)) + "..."
+			+ git_oid_tostr(upstreamSha1, sizeof(upstreamSha1), &upstream);
+	}
+
+	void CheckAheadBehind(TestRepository& repository, CommitGraph& commitGraph, const git_oid& local, const git_oid& upstream)
+	{
+		size_t expectedAhead = 0;
+		size_t expectedBehind = 0;
+		Check(git_graph_ahead_behind(&expectedAhead, &expectedBehind, repository.Get(), &local, &upstream) == GIT_OK,
+			"git_graph_ahead_behind failed for " + Describe(local, upstream) + ".");
+
+		size_t aheadBy = 0;
+		size_t behindBy = 0;
+		Check(commitGraph.AheadBehind(local, upstream, aheadBy, behindBy), "AheadBehind failed for " + Describe(local, upstream) + ".");
+		Check(aheadBy == expectedAhead && behindBy == expectedBehind, Describe(local, upstream) + " counted "
+			+ std::to_string(aheadBy) + " ahead and " + std::to_string(behindBy) + " behind, expected "
+			+ std::to_string(expectedAhead) + " ahead and " + std::to_string(expectedBehind) + " behind.");
+	}
+
+	/**
+	* Compares random commit pairs, some written after the commit-graph file, through one
+	* commit-graph that accumulates the newer commits it resolves and through fresh ones.
+	*/
+	void TestMatchesLibgit2()
+	{
+		TestRepository repository("CommitGraphTest");
+		RandomHistory history(repository, 20240601);
+		history.Grow(3000);
+		WriteCommitGraph(repository, history.Tips);
+		history.Grow(300);
+
+		CommitGraph reusedCommitGraph;
+		Check(reusedCommitGraph.Open(repository.Get()), "Failed to open commit-graph file.");
+		for (int pair = 0; pair < 400; ++pair)
+		{
+			auto local = history.PickCommit();
+			auto upstream = pair % 10 == 0 ? history.Tips[pair / 10 % history.Tips.size()] : history.PickCommit();
+			CheckAheadBehind(repository, reusedCommitGraph, local, upstream);
+
+			CommitGraph commitGraph;
+			Check(commitGraph.Open(repository.Get()), "Failed to open commit-graph file.");
+			CheckAheadBehind(repository, commitGraph, local, upstream);
+		}
+
+		for (const auto& tip : history.Tips)
+			CheckAheadBehind(repository, reusedCommitGraph, tip, tip);
+	}
+
+	/**
+	* Commits provided number of commits on top of base, spread over lanes that are joined by
+	* an octopus merge every thousand commits. Returns the final merge.
+	*/
+	git_oid CommitSide(TestRepository& repository, const git_oid& tree, const git_oid& base, size_t commitCount)
+	{
+		const size_t laneCount = 16;
+		std::vector<git_oid> lanes(laneCount, base);
+		for (size_t i = 1; i <= commitCount; ++i)
+		{
+			if (i % 1000 == 0 || i == commitCount)
+				lanes.assign(laneCount, repository.CommitTree(tree, lanes));
+			else
+				lanes[i % laneCount] = repository.CommitTree(tree, { lanes[i % laneCount] });
+		}
+		return lanes.front();
+	}
+
+	void RunBenchmark()
+	{
+		TestRepository repository("CommitGraphBenchmark");
+		auto tree = repository.WriteTree();
+		auto base = repository.CommitTree(tree, {});
+		for (int i = 0; i < 1000; ++i)
+			base = repository.CommitTree(tree, { base });
+		auto local = CommitSide(repository, tree, base, 49500);
+		auto upstream = CommitSide(repository, tree, base, 49500);
+		WriteCommitGraph(repository, { local, upstream });
+
+		// Warm the object database cache, which libgit2's walk reads through.
+		size_t aheadBy = 0;
+		size_t behindBy = 0;
+		git_graph_ahead_behind(&aheadBy, &behindBy, repository.Get(), &local, &upstream);
+
+		auto libgit2Milliseconds = MeasureMilliseconds([&]()
+		{
+			git_graph_ahead_behind(&aheadBy, &behindBy, repository.Get(), &local, &upstream);
+		});
+		std::cout << "git_graph_ahead_behind, " << aheadBy << " ahead, " << behindBy << " behind: " << libgit2Milliseconds << " ms" << std::endl;
+
+		auto commitGraphMilliseconds = MeasureMilliseconds([&]()
+		{
+			CommitGraph commitGraph;
+			Check(commitGraph.Open(repository.Get()) && commitGraph.AheadBehind(local, upstream, aheadBy, behindBy),
+				"Failed to count commits from commit-graph file.");
+		});
+		std::cout << "CommitGraph::AheadBehind, " << aheadBy << " ahead, " << behindBy << " behind: " << commitGraphMilliseconds << " ms" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	git_libgit2_init();
+	auto shutdown = std::experimental::scope_guard([] { git_libgit2_shutdown(); });
+
+	try
+	{
+		if (IsBenchmark(argc, argv))
+		{
+			RunBenchmark();
+			return 0;
+		}
+
+		TestMatchesLibgit2();
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "FAILED: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
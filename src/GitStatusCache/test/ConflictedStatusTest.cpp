@@ -0,0 +1,213 @@
+#include "stdafx.h"
+#include "Git.h"
+#include "TestRepository.h"
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+
+// Checks that conflicted and ignored paths are deduplicated in linear time. Runs a conflict
+// heavy synthetic merge through Git::GetStatus, and feeds duplicate status entries straight
+// into Git::CollectFileStatus, since libgit2 only reports duplicates for some conflicts.
+namespace
+{
+	using Category = StatusPaths::Category;
+
+	/**
+	* Status entries for paths that are each reported twice, once with only head_to_index and
+	* once with only index_to_workdir, as libgit2 reports some conflicts.
+	*/
+	class DuplicateEntries
+	{
+	private:
+		std::vector<std::string> m_paths;
+		std::deque<git_diff_delta> m_deltas;
+		std::deque<git_status_entry> m_entries;
+
+	public:
+		std::vector<const git_status_entry*> Entries;
+
+		DuplicateEntries(size_t pathCount, git_status_t flag)
+		{
+			m_paths.reserve(pathCount);
+			for (size_t i = 0; i < pathCount; ++i)
+				m_paths.push_back("directory" + std::to_string(i / 100) + "/file" + std::to_string(i));
+
+			for (const auto& path : m_paths)
+			{
+				for (auto workingTreeSide : { false, true })
+				{
+					git_diff_delta delta;
+					std::memset(&delta, 0, sizeof(delta));
+					delta.old_file.path = path.c_str();
+					delta.new_file.path = path.c_str();
+					m_deltas.push_back(delta);
+
+					git_status_entry entry;
+					std::memset(&entry, 0, sizeof(entry));
+					entry.status = flag;
+					(workingTreeSide ? entry.index_to_workdir : entry.head_to_index) = &m_deltas.back();
+					m_entries.push_back(entry);
+					Entries.push_back(&m_entries.back());
+				}
+			}
+		}
+	};
+
+	void CheckUniquePaths(const Git::Status& status, uint8_t category, size_t expectedCount, size_t expectedSize)
+	{
+		Check(status.PathCounts[category] == expectedCount, "Expected " + std::to_string(expectedCount)
+			+ " paths, counted " + std::to_string(status.PathCounts[category]) + ".");
+		Check(status.Paths.Size(category) == expectedSize, "Expected " + std::to_string(expectedSize)
+			+ " paths kept, found " + std::to_string(status.Paths.Size(category)) + ".");
+
+		std::unordered_set<std::string_view> paths;
+		for (auto path : status.Paths.Get(category))
+			Check(paths.insert(path).second, "Path " + std::string(path) + " was reported twice.");
+	}
+
+	/**
+	* Feeds each path of provided category through Git::CollectFileStatus twice, with and
+	* without a path limit.
+	*/
+	void TestDuplicateEntries(size_t pathCount, git_status_t flag, uint8_t category)
+	{
+		DuplicateEntries duplicates(pathCount, flag);
+
+		Git::Status status;
+		Git::CollectFileStatus(status, duplicates.Entries);
+		CheckUniquePaths(status, category, pathCount, pathCount);
+
+		// Paths beyond the limit must be remembered too, so that their duplicates aren't counted.
+		Git::Status limitedStatus;
+		limitedStatus.MaxPaths = 100;
+		Git::CollectFileStatus(limitedStatus, duplicates.Entries);
+		CheckUniquePaths(limitedStatus, category, pathCount, limitedStatus.MaxPaths);
+	}
+
+	double MeasureDuplicateEntries(size_t pathCount)
+	{
+		DuplicateEntries duplicates(pathCount, GIT_STATUS_CONFLICTED);
+		double fastest = 0;
+		for (int run = 0; run < 3; ++run)
+		{
+			Git::Status status;
+			auto milliseconds = MeasureMilliseconds([&]() { Git::CollectFileStatus(status, duplicates.Entries); });
+			fastest = run == 0 ? milliseconds : (std::min)(fastest, milliseconds);
+		}
+		return fastest;
+	}
+
+	/**
+	* Checks that collecting eight times as many duplicate entries takes nowhere near the
+	* sixty-four times as long a quadratic pass would.
+	*/
+	void TestDuplicateEntriesScaleLinearly()
+	{
+		const size_t pathCount = 5000;
+		auto smallMilliseconds = MeasureDuplicateEntries(pathCount);
+		auto largeMilliseconds = MeasureDuplicateEntries(pathCount * 8);
+		Check(largeMilliseconds < (std::max)(smallMilliseconds, 1.0) * 24,
+			"Collecting " + std::to_string(pathCount * 8) + " duplicate entries took " + std::to_string(largeMilliseconds)
+			+ " ms, against " + std::to_string(smallMilliseconds) + " ms for " + std::to_string(pathCount) + ".");
+	}
+
+	/**
+	* Builds a repository in the middle of a merge that conflicts on provided number of files.
+	* Conflicts cycle through content, delete/modify and add/add conflicts.
+	*/
+	void CreateConflictedMerge(TestRepository& repository, size_t conflictCount)
+	{
+		auto base = repository.WriteBlob("base\n");
+		auto ours = repository.WriteBlob("ours\n");
+		auto theirs = repository.WriteBlob("theirs\n");
+
+		auto getPath = [](size_t conflict) { return "directory" + std::to_string(conflict / 100) + "/file" + std::to_string(conflict); };
+		for (size_t i = 0; i < conflictCount; ++i)
+		{
+			if (i % 3 != 2)
+				repository.Stage(getPath(i), base);
+		}
+		repository.WriteIndex();
+		auto head = repository.CommitIndex();
+
+		for (size_t i = 0; i < conflictCount; ++i)
+		{
+			auto path = getPath(i);
+			if (i % 3 == 0)
+				repository.AddConflict(path, &base, &ours, &theirs);
+			else if (i % 3 == 1)
+				repository.AddConflict(path, &base, nullptr, &theirs);
+			else
+				repository.AddConflict(path, nullptr, &ours, &theirs);
+			repository.WriteFile(path, "<<<<<<< ours\nours\n=======\ntheirs\n>>>>>>> theirs\n");
+		}
+		repository.WriteIndex();
+
+		char mergeHead[GIT_OID_HEXSZ + 1];
+		git_oid_tostr(mergeHead, sizeof(mergeHead), &head);
+		std::ofstream(std::filesystem::path(git_repository_path(repository.Get())) / "MERGE_HEAD") << mergeHead << "\n";
+	}
+
+	void TestConflictedMerge(size_t conflictCount)
+	{
+		TestRepository repository("ConflictedStatusTest");
+		CreateConflictedMerge(repository, conflictCount);
+
+		Git git;
+		auto status = git.GetStatus(repository.GetWorkingDirectory());
+		Check(std::get<0>(status), "Failed to retrieve status.");
+		Check(std::get<1>(status).State == "MERGING", "Expected a merge in progress.");
+		CheckUniquePaths(std::get<1>(status), Category::Conflicted, conflictCount, conflictCount);
+	}
+
+	void RunBenchmark()
+	{
+		for (auto pathCount : { 10000, 100000, 1000000 })
+		{
+			auto milliseconds = MeasureDuplicateEntries(pathCount);
+			std::cout << "CollectFileStatus, " << pathCount << " duplicated conflicts: " << milliseconds << " ms, "
+				<< milliseconds * 1000000 / pathCount << " ns per path" << std::endl;
+		}
+
+		for (auto conflictCount : { 1000, 10000, 50000 })
+		{
+			TestRepository repository("ConflictedStatusBenchmark");
+			CreateConflictedMerge(repository, conflictCount);
+
+			Git git;
+			git.GetStatus(repository.GetWorkingDirectory());
+			auto milliseconds = MeasureMilliseconds([&]() { git.GetStatus(repository.GetWorkingDirectory()); });
+			std::cout << "GetStatus, merge with " << conflictCount << " conflicts: " << milliseconds << " ms" << std::endl;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	git_libgit2_init();
+	auto shutdown = std::experimental::scope_guard([] { git_libgit2_shutdown(); });
+
+	try
+	{
+		if (IsBenchmark(argc, argv))
+		{
+			RunBenchmark();
+			return 0;
+		}
+
+		TestDuplicateEntries(20000, GIT_STATUS_CONFLICTED, Category::Conflicted);
+		TestDuplicateEntries(20000, GIT_STATUS_IGNORED, Category::Ignored);
+		TestDuplicateEntriesScaleLinearly();
+		TestConflictedMerge(3000);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "FAILED: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
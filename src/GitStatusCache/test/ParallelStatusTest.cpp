@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "Git.h"
+#include "TestRepository.h"
+
+#include <iostream>
+
+// Checks that scanning the working tree on several threads reports exactly what a single
+// scan does, on a generated tree with untracked directories, deleted top-level entries and
+// staged renames. The benchmark compares both scans on larger generated trees.
+namespace
+{
+	using Category = StatusPaths::Category;
+
+	const uint32_t ParallelScanThreads = 4;
+
+	/**
+	* Commits a tree of provided number of files. Files are spread over top-level directories
+	* of up to 500 files, each split into subdirectories of 50.
+	*/
+	void CreateTree(TestRepository& repository, size_t fileCount)
+	{
+		for (size_t i = 0; i < fileCount; ++i)
+		{
+			auto path = "d" + std::to_string(i / 500) + "/s" + std::to_string(i % 500 / 50) + "/f" + std::to_string(i % 50);
+			repository.WriteFile(path, "content\n");
+			repository.StageFile(path);
+		}
+		repository.WriteIndex();
+		repository.CommitIndex();
+	}
+
+	/**
+	* Makes working tree and index changes of every kind a partitioned scan must merge.
+	*/
+	void ChangeTree(TestRepository& repository)
+	{
+		// Unique content, so that renames are detected unambiguously.
+		auto renameContent = [](const std::string& path) { return std::string(200, 'x') + "\nrenamed " + path + "\n"; };
+		const std::pair<std::string, std::string> renames[] = {
+			{ "d1/s0/renamed", "d1/s1/renamed" },
+			{ "d2/s0/renamed", "d7/s0/renamed" },
+			{ "d3/s0/renamed", "renamed-top/renamed" },
+			{ "top-renamed", "d4/top-renamed" },
+		};
+		for (const auto& rename : renames)
+		{
+			repository.WriteFile(rename.first, renameContent(rename.first));
+			repository.StageFile(rename.first);
+		}
+		repository.WriteFile("top-deleted", "content\n");
+		repository.StageFile("top-deleted");
+		repository.WriteIndex();
+		repository.CommitIndex();
+
+		// Staged renames within and across top-level entries.
+		for (const auto& rename : renames)
+		{
+			repository.RemoveFile(rename.first);
+			repository.Unstage(rename.first);
+			repository.WriteFile(rename.second, renameContent(rename.first));
+			repository.StageFile(rename.second);
+		}
+
+		// Staged addition, deletion and modification.
+		repository.WriteFile("d4/s0/staged-new", "new\n");
+		repository.StageFile("d4/s0/staged-new");
+		repository.RemoveFile("d6/s0/f1");
+		repository.Unstage("d6/s0/f1");
+		repository.WriteFile("d6/s1/f1", "staged change\n");
+		repository.StageFile("d6/s1/f1");
+		repository.WriteIndex();
+
+		// Working tree changes, including deleted top-level entries and untracked directories.
+		repository.WriteFile("d8/s1/f2", "working change\n");
+		repository.RemoveFile("d5");
+		repository.RemoveFile("top-deleted");
+		repository.WriteFile("untracked-top/a", "untracked\n");
+		repository.WriteFile("untracked-top/nested/b", "untracked\n");
+		repository.WriteFile("d9/untracked-nested/c", "untracked\n");
+		repository.WriteFile("d9/s0/untracked", "untracked\n");
+		repository.WriteFile("untracked-file", "untracked\n");
+	}
+
+	void CheckEqual(const Git::Status& serial, const Git::Status& parallel)
+	{
+		for (uint8_t category = 0; category < Category::Count; ++category)
+		{
+			auto name = "category " + std::to_string(category);
+			Check(serial.PathCounts[category] == parallel.PathCounts[category], "Path counts of " + name + " differ.");
+			Check(serial.Paths.Size(category) == parallel.Paths.Size(category), "Paths of " + name + " differ in number.");
+
+			if (StatusPaths::IsRenamedCategory(category))
+			{
+				auto serialPaths = serial.Paths.GetRenamed(category);
+				auto parallelPaths = parallel.Paths.GetRenamed(category);
+				for (size_t i = 0; i < serialPaths.size(); ++i)
+				{
+					Check(serialPaths[i] == parallelPaths[i], "Rename " + std::string(serialPaths[i].first) + " -> "
+						+ std::string(serialPaths[i].second) + " differs in " + name + ".");
+				}
+				continue;
+			}
+
+			auto serialPaths = serial.Paths.Get(category);
+			auto parallelPaths = parallel.Paths.Get(category);
+			for (size_t i = 0; i < serialPaths.size(); ++i)
+				Check(serialPaths[i] == parallelPaths[i], "Path " + std::string(serialPaths[i]) + " differs in " + name + ".");
+		}
+	}
+
+	bool Contains(const Git::Status& status, uint8_t category, std::string_view path)
+	{
+		auto paths = status.Paths.Get(category);
+		return std::find(paths.begin(), paths.end(), path) != paths.end();
+	}
+
+	void TestParallelMatchesSerial()
+	{
+		TestRepository repository("ParallelStatusTest");
+		CreateTree(repository, 12000);
+		ChangeTree(repository);
+
+		Git serialGit(1);
+		Git parallelGit(ParallelScanThreads);
+		for (auto maxPaths : { Git::UnlimitedPaths, static_cast<size_t>(2) })
+		{
+			auto serial = serialGit.GetStatus(repository.GetWorkingDirectory(), Git::StatusParts::All, maxPaths);
+			auto parallel = parallelGit.GetStatus(repository.GetWorkingDirectory(), Git::StatusParts::All, maxPaths);
+			Check(std::get<0>(serial) && std::get<0>(parallel), "Failed to retrieve status.");
+			CheckEqual(std::get<1>(serial), std::get<1>(parallel));
+		}
+
+		// The generated changes must actually show up, or the comparison proves little.
+		auto status = std::get<1>(serialGit.GetStatus(repository.GetWorkingDirectory()));
+		Check(status.PathCounts[Category::IndexRenamed] == 4, "Expected four staged renames.");
+		Check(status.PathCounts[Category::WorkingDeleted] == 501, "Expected a deleted top-level directory and file.");
+		Check(Contains(status, Category::WorkingAdded, "untracked-top/"), "Expected a top-level untracked directory.");
+		Check(Contains(status, Category::WorkingAdded, "d9/untracked-nested/"), "Expected a nested untracked directory.");
+		Check(Contains(status, Category::IndexDeleted, "d6/s0/f1"), "Expected a staged deletion.");
+		Check(Contains(status, Category::WorkingModified, "d8/s1/f2"), "Expected a working tree modification.");
+	}
+
+	void RunBenchmark()
+	{
+		auto scanThreads = (std::max)(std::thread::hardware_concurrency(), ParallelScanThreads);
+		for (auto fileCount : { 10000, 100000, 1000000 })
+		{
+			TestRepository repository("ParallelStatusBenchmark");
+			CreateTree(repository, fileCount);
+			ChangeTree(repository);
+
+			Git serialGit(1);
+			Git parallelGit(scanThreads);
+			serialGit.GetStatus(repository.GetWorkingDirectory());
+			parallelGit.GetStatus(repository.GetWorkingDirectory());
+
+			auto serialMilliseconds = MeasureMilliseconds([&]() { serialGit.GetStatus(repository.GetWorkingDirectory()); });
+			auto parallelMilliseconds = MeasureMilliseconds([&]() { parallelGit.GetStatus(repository.GetWorkingDirectory()); });
+			std::cout << "GetStatus, " << fileCount << " files: " << serialMilliseconds << " ms serial, "
+				<< parallelMilliseconds << " ms on " << scanThreads << " threads" << std::endl;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	git_libgit2_init();
+	auto shutdown = std::experimental::scope_guard([] { git_libgit2_shutdown(); });
+
+	try
+	{
+		if (IsBenchmark(argc, argv))
+		{
+			RunBenchmark();
+			return 0;
+		}
+
+		TestParallelMatchesSerial();
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "FAILED: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "Cache.h"
+#include "TestRepository.h"
+
+#include <iostream>
+
+// Checks that statuses restored from a snapshot are served without recomputation, and that
+// priming then verifies them, picking up working tree edits made while nothing was watching.
+namespace
+{
+	using Category = StatusPaths::Category;
+
+	bool Contains(const Git::Status& status, uint8_t category, std::string_view path)
+	{
+		auto paths = status.Paths.Get(category);
+		return std::find(paths.begin(), paths.end(), path) != paths.end();
+	}
+
+	void TestRestoredStatusIsVerified()
+	{
+		TestRepository repository("RestoredStatusTest");
+		repository.WriteFile("file", "content\n");
+		repository.StageFile("file");
+		repository.WriteIndex();
+		repository.CommitIndex();
+
+		Git git;
+		auto snapshotStatus = git.GetStatus(repository.GetWorkingDirectory());
+		Check(std::get<0>(snapshotStatus), "Failed to retrieve status.");
+		auto repositoryPath = std::get<1>(snapshotStatus).RepositoryPath;
+
+		// Edited after the snapshot was written.
+		repository.WriteFile("untracked", "content\n");
+
+		Cache cache{ Options() };
+		cache.RestoreCacheEntry(std::make_shared<const Git::Status>(std::get<1>(snapshotStatus)), false /*isStale*/);
+
+		auto restored = cache.GetStatus(repositoryPath);
+		Check(restored.Success && !restored.IsStale, "Restored status wasn't served as valid.");
+		Check(!Contains(*restored.Status, Category::WorkingAdded, "untracked"), "Restored status was recomputed when read.");
+		Check(cache.GetCacheStatistics().CacheMisses == 0, "Reading restored status missed the cache.");
+
+		cache.PrimeCacheEntry(repositoryPath);
+		auto verified = cache.GetStatus(repositoryPath);
+		Check(verified.Success && !verified.IsStale, "Verified status wasn't valid.");
+		Check(Contains(*verified.Status, Category::WorkingAdded, "untracked"), "Priming didn't verify restored status.");
+
+		// Verified entries are up to date, so priming them again does nothing.
+		cache.PrimeCacheEntry(repositoryPath);
+		auto statistics = cache.GetCacheStatistics();
+		Check(statistics.CacheEffectivePrimeRequests == 1, "Expected one effective prime request, counted "
+			+ std::to_string(statistics.CacheEffectivePrimeRequests) + ".");
+		Check(statistics.CacheMisses == 0, "Reading verified status missed the cache.");
+	}
+}
+
+int main()
+{
+	git_libgit2_init();
+	auto shutdown = std::experimental::scope_guard([] { git_libgit2_shutdown(); });
+
+	try
+	{
+		TestRestoredStatusIsVerified();
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "FAILED: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
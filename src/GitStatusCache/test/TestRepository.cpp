@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "TestRepository.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+void Check(bool condition, const std::string& message)
+{
+	if (!condition)
+		throw std::runtime_error(message);
+}
+
+bool IsBenchmark(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+			return true;
+	}
+	return false;
+}
+
+/*static*/ void TestRepository::CheckResult(int result, const char* operation)
+{
+	if (result == GIT_OK)
+		return;
+
+	auto lastError = giterr_last();
+	throw std::runtime_error(std::string(operation) + " failed: " + (lastError == nullptr ? "unknown error" : lastError->message));
+}
+
+TestRepository::TestRepository(const std::string& name)
+	: m_repository(MakeUniqueGitRepository(nullptr))
+	, m_index(MakeUniqueGitIndex(nullptr))
+{
+	std::random_device random;
+	m_workingDirectory = std::filesystem::temp_directory_path() / (name + "-" + std::to_string(random()));
+	std::filesystem::create_directories(m_workingDirectory);
+
+	CheckResult(git_repository_init(&m_repository.get(), m_workingDirectory.c_str(), false /*is_bare*/), "git_repository_init");
+	CheckResult(git_repository_index(&m_index.get(), m_repository.get()), "git_repository_index");
+	m_workingDirectoryPath = git_repository_workdir(m_repository.get());
+}
+
+TestRepository::~TestRepository()
+{
+	m_index.reset(nullptr);
+	m_repository.reset(nullptr);
+
+	std::error_code error;
+	std::filesystem::remove_all(m_workingDirectory, error);
+	if (error)
+		std::cerr << "Failed to remove " << m_workingDirectory << ": " << error.message() << std::endl;
+}
+
+std::string TestRepository::GetWorkingDirectory() const
+{
+	return m_workingDirectoryPath;
+}
+
+git_repository* TestRepository::Get()
+{
+	return m_repository.get();
+}
+
+git_oid TestRepository::WriteBlob(const std::string& content)
+{
+	git_oid blob;
+	CheckResult(git_blob_create_from_buffer(&blob, m_repository.get(), content.data(), content.size()), "git_blob_create_from_buffer");
+	return blob;
+}
+
+void TestRepository::WriteFile(const std::string& path, const std::string& content)
+{
+	auto filePath = m_workingDirectory / path;
+	std::filesystem::create_directories(filePath.parent_path());
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	file << content;
+	file.close();
+	Check(file.good(), "Failed to write " + filePath.string());
+
+	std::filesystem::last_write_time(filePath, std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+}
+
+void TestRepository::RemoveFile(const std::string& path)
+{
+	std::filesystem::remove_all(m_workingDirectory / path);
+}
+
+void TestRepository::Stage(const std::string& path, const git_oid& blob, int stage)
+{
+	git_index_entry entry;
+	std::memset(&entry, 0, sizeof(entry));
+	entry.mode = GIT_FILEMODE_BLOB;
+	entry.id = blob;
+	entry.path = path.c_str();
+	// Stage occupies bits 12 and 13 of the entry flags.
+	entry.flags = static_cast<uint16_t>(stage << 12);
+	CheckResult(git_index_add(m_index.get(), &entry), "git_index_add");
+}
+
+void TestRepository::StageFile(const std::string& path)
+{
+	CheckResult(git_index_add_bypath(m_index.get(), path.c_str()), "git_index_add_bypath");
+}
+
+void TestRepository::Unstage(const std::string& path)
+{
+	CheckResult(git_index_remove_bypath(m_index.get(), path.c_str()), "git_index_remove_bypath");
+}
+
+void TestRepository::AddConflict(const std::string& path, const git_oid* ancestor, const git_oid* ours, const git_oid* theirs)
+{
+	git_index_entry entries[3];
+	const git_oid* sides[3] = { ancestor, ours, theirs };
+	for (size_t i = 0; i < 3; ++i)
+	{
+		std::memset(&entries[i], 0, sizeof(entries[i]));
+		entries[i].mode = GIT_FILEMODE_BLOB;
+		entries[i].path = path.c_str();
+		if (sides[i] != nullptr)
+			entries[i].id = *sides[i];
+	}
+
+	CheckResult(
+		git_index_conflict_add(
+			m_index.get(),
+			ancestor != nullptr ? &entries[0] : nullptr,
+			ours != nullptr ? &entries[1] : nullptr,
+			theirs != nullptr ? &entries[2] : nullptr),
+		"git_index_conflict_add");
+}
+
+void TestRepository::WriteIndex()
+{
+	CheckResult(git_index_write(m_index.get()), "git_index_write");
+}
+
+git_oid TestRepository::WriteTree()
+{
+	git_oid tree;
+	CheckResult(git_index_write_tree(&tree, m_index.get()), "git_index_write_tree");
+	return tree;
+}
+
+git_oid TestRepository::CommitTree(const git_oid& tree, const std::vector<git_oid>& parents, const char* referenceName)
+{
+	static git_time_t commitTime = 1500000000;
+	git_signature* signature = nullptr;
+	CheckResult(git_signature_new(&signature, "Test", "test@example.com", ++commitTime, 0), "git_signature_new");
+	auto freeSignature = std::experimental::scope_guard([signature] { git_signature_free(signature); });
+
+	git_tree* treeObject = nullptr;
+	CheckResult(git_tree_lookup(&treeObject, m_repository.get(), &tree), "git_tree_lookup");
+	auto freeTree = std::experimental::scope_guard([treeObject] { git_tree_free(treeObject); });
+
+	std::vector<UniqueGitCommit> parentCommits;
+	std::vector<const git_commit*> parentPointers;
+	for (const auto& parent : parents)
+	{
+		parentCommits.push_back(MakeUniqueGitCommit(nullptr));
+		CheckResult(git_commit_lookup(&parentCommits.back().get(), m_repository.get(), &parent), "git_commit_lookup");
+		parentPointers.push_back(parentCommits.back().get());
+	}
+
+	git_oid commit;
+	CheckResult(
+		git_commit_create(
+			&commit,
+			m_repository.get(),
+			referenceName,
+			signature,
+			signature,
+			nullptr /*message_encoding*/,
+			"Test commit",
+			treeObject,
+			parentPointers.size(),
+			parentPointers.data()),
+		"git_commit_create");
+	return commit;
+}
+
+git_oid TestRepository::CommitIndex()
+{
+	auto tree = WriteTree();
+
+	std::vector<git_oid> parents;
+	auto head = MakeUniqueGitReference(nullptr);
+	if (git_repository_head(&head.get(), m_repository.get()) == GIT_OK)
+		parents.push_back(*git_reference_target(head.get()));
+
+	return CommitTree(tree, parents, "HEAD");
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "stdafx.h"
+
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+* Throws with provided message if condition doesn't hold. Tests report failures by throwing.
+*/
+void Check(bool condition, const std::string& message);
+
+/**
+* Checks if the program was asked to run its benchmark rather than its quick check.
+*/
+bool IsBenchmark(int argc, char* argv[]);
+
+/**
+* Measures the milliseconds provided function takes to run.
+*/
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+* Repository created in a new temporary directory, and removed with it when destroyed.
+* Objects, index entries and commits are written directly through libgit2, so that large
+* synthetic repositories are quick to build. Failures throw std::runtime_error.
+*/
+class TestRepository
+{
+private:
+	std::filesystem::path m_workingDirectory;
+	std::string m_workingDirectoryPath;
+	UniqueGitRepository m_repository;
+	UniqueGitIndex m_index;
+
+	/**
+	* Throws with libgit2's last error if result isn't GIT_OK.
+	*/
+	static void CheckResult(int result, const char* operation);
+
+public:
+	explicit TestRepository(const std::string& name);
+	TestRepository(const TestRepository&) = delete;
+	~TestRepository();
+
+	/**
+	* Retrieves the working directory, with a trailing slash.
+	*/
+	std::string GetWorkingDirectory() const;
+
+	git_repository* Get();
+
+	/**
+	* Writes a blob with provided content to the object database.
+	*/
+	git_oid WriteBlob(const std::string& content);
+
+	/**
+	* Writes a file in the working tree, creating its directories. Path is relative to the
+	* working directory. Files are dated an hour back, so that the index doesn't treat
+	* entries staged from them as racily clean and rehash them on every status.
+	*/
+	void WriteFile(const std::string& path, const std::string& content);
+
+	/**
+	* Removes a file or directory from the working tree.
+	*/
+	void RemoveFile(const std::string& path);
+
+	/**
+	* Adds an entry for blob to the index at provided stage. Stages 1 to 3 record the
+	* ancestor, ours and theirs side of a conflict. Changes are written by WriteIndex.
+	*/
+	void Stage(const std::string& path, const git_oid& blob, int stage = 0);
+
+	/**
+	* Adds an entry for a working tree file to the index, including its file system metadata.
+	*/
+	void StageFile(const std::string& path);
+
+	/**
+	* Removes a path from the index at every stage.
+	*/
+	void Unstage(const std::string& path);
+
+	/**
+	* Records a conflict in the index, replacing any stage 0 entry. Sides given as nullptr
+	* are absent, as when one side deleted the file.
+	*/
+	void AddConflict(const std::string& path, const git_oid* ancestor, const git_oid* ours, const git_oid* theirs);
+
+	/**
+	* Writes pending index changes to disk.
+	*/
+	void WriteIndex();
+
+	/**
+	* Writes the index as a tree to the object database.
+	*/
+	git_oid WriteTree();
+
+	/**
+	* Commits provided tree with provided parents. Updates provided reference if given.
+	* Commit times increase with every commit, so that histories have a defined order.
+	*/
+	git_oid CommitTree(const git_oid& tree, const std::vector<git_oid>& parents, const char* referenceName = nullptr);
+
+	/**
+	* Commits the index on top of HEAD, if HEAD has a commit, and advances HEAD's branch.
+	*/
+	git_oid CommitIndex();
+};